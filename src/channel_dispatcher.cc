@@ -0,0 +1,311 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+
+#include "channel_dispatcher.h"
+#include "debug.h"
+
+namespace flutter {
+
+static void UpdateMax(std::atomic<uint64_t> &max, const uint64_t value) {
+  uint64_t current = max.load(std::memory_order_relaxed);
+  while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+  }
+}
+
+ChannelDispatcher::Responder::Responder(FlutterEngine engine, const FlutterPlatformMessageResponseHandle *handle, std::shared_ptr<ChannelStats> stats)
+    : engine_(engine)
+    , handle_(handle)
+    , stats_(std::move(stats))
+    , received_ns_(FlutterEngineGetCurrentTime()) {
+}
+
+ChannelDispatcher::Responder::Responder(Responder &&other) noexcept {
+  *this = std::move(other);
+}
+
+ChannelDispatcher::Responder &ChannelDispatcher::Responder::operator=(Responder &&other) noexcept {
+  if (this != &other) {
+    if (handle_ != nullptr) {
+      Send(nullptr, 0);
+    }
+
+    engine_       = other.engine_;
+    handle_       = other.handle_;
+    stats_        = std::move(other.stats_);
+    received_ns_  = other.received_ns_;
+    other.handle_ = nullptr;
+  }
+
+  return *this;
+}
+
+ChannelDispatcher::Responder::~Responder() {
+  if (handle_ != nullptr) {
+    Send(nullptr, 0);
+  }
+}
+
+bool ChannelDispatcher::Responder::Send(const uint8_t *data, size_t size) {
+  if (handle_ == nullptr) {
+    dbgE("Platform message already replied to\n");
+    return false;
+  }
+
+  const auto result = FlutterEngineSendPlatformMessageResponse(engine_, handle_, data, size);
+  handle_           = nullptr;
+
+  if (stats_) {
+    const uint64_t latency_ns = FlutterEngineGetCurrentTime() - received_ns_;
+
+    stats_->replies++;
+    stats_->bytes_out += size;
+    stats_->latency_ns += latency_ns;
+    UpdateMax(stats_->latency_max_ns, latency_ns);
+  }
+
+  if (result != kSuccess) {
+    dbgE("Could not send a platform message response\n");
+    return false;
+  }
+
+  return true;
+}
+
+ChannelDispatcher::ChannelDispatcher(FlutterEngine engine, size_t workers, size_t max_queued)
+    : engine_(engine)
+    , max_queued_(max_queued) {
+  for (size_t i = 0; i < workers; i++) {
+    workers_.emplace_back(&ChannelDispatcher::WorkerMain, this);
+  }
+}
+
+ChannelDispatcher::~ChannelDispatcher() {
+  Shutdown();
+  LogStats();
+}
+
+void ChannelDispatcher::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stopping_ = true;
+  }
+
+  queue_cv_.notify_all();
+
+  for (auto &worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+std::shared_ptr<ChannelDispatcher::ChannelStats> ChannelDispatcher::StatsFor(const std::string &channel) {
+  auto &stats = stats_[channel];
+
+  if (!stats) {
+    stats = std::make_shared<ChannelStats>();
+  }
+
+  return stats;
+}
+
+void ChannelDispatcher::SetHandler(const std::string &channel, Handler handler, ThreadPolicy policy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (policy == ThreadPolicy::kWorker && workers_.empty()) {
+    dbgW("No channel workers, %s handled on the platform thread\n", channel.c_str());
+    policy = ThreadPolicy::kPlatform;
+  }
+
+  channels_[channel] = Channel{std::move(handler), policy, StatsFor(channel)};
+}
+
+void ChannelDispatcher::RemoveHandler(const std::string &channel) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  channels_.erase(channel);
+}
+
+void ChannelDispatcher::OnPlatformMessage(const FlutterPlatformMessage *message) {
+  Channel channel;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto it = channels_.find(message->channel);
+
+    if (it != channels_.end()) {
+      channel = it->second;
+    } else {
+      channel.stats = StatsFor(message->channel);
+    }
+  }
+
+  channel.stats->messages++;
+  channel.stats->bytes_in += message->message_size;
+
+  Responder responder(engine_, message->response_handle, channel.stats);
+
+  if (!channel.handler) {
+    dbgT("Unhandled platform message on channel: %s\n", message->channel);
+    channel.stats->rejected++;
+    return; // replies with an empty message
+  }
+
+  if (channel.policy == ThreadPolicy::kPlatform) {
+    channel.handler(message->message, message->message_size, std::move(responder));
+    return;
+  }
+
+  // The message buffer is only valid for the duration of this callback.
+  // std::function must be copyable, hence the responder is shared.
+  auto job = [handler = std::move(channel.handler), data = std::vector<uint8_t>(message->message, message->message + message->message_size), responder = std::make_shared<Responder>(std::move(responder))]() {
+    handler(data.data(), data.size(), std::move(*responder));
+  };
+
+  if (!Enqueue(std::move(job))) {
+    dbgW("Channel workers full or shut down, rejecting message on channel: %s\n", message->channel);
+    channel.stats->rejected++;
+  }
+}
+
+bool ChannelDispatcher::Enqueue(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+
+    if (stopping_ || queue_.size() >= max_queued_) {
+      return false; // job (and the responder it owns) is destroyed by the caller
+    }
+
+    queue_.push_back(std::move(job));
+  }
+
+  queue_cv_.notify_one();
+
+  return true;
+}
+
+void ChannelDispatcher::WorkerMain() {
+  while (true) {
+    std::function<void()> job;
+
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+
+      if (queue_.empty()) {
+        return;
+      }
+
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    job();
+  }
+}
+
+ChannelDispatcher::PendingRequest *ChannelDispatcher::AcquireRequest() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (free_requests_.empty()) {
+    requests_.push_back(std::make_unique<PendingRequest>());
+    requests_.back()->dispatcher = this;
+    return requests_.back().get();
+  }
+
+  PendingRequest *const request = free_requests_.back();
+  free_requests_.pop_back();
+
+  return request;
+}
+
+void ChannelDispatcher::RecycleRequest(PendingRequest *request) {
+  request->reply = nullptr;
+  request->stats.reset();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_requests_.push_back(request);
+}
+
+bool ChannelDispatcher::Send(const char *channel, const uint8_t *data, size_t size, ReplyCallback reply) {
+  std::shared_ptr<ChannelStats> stats;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats = StatsFor(channel);
+  }
+
+  stats->sent++;
+  stats->bytes_out += size;
+
+  FlutterPlatformMessageResponseHandle *response_handle = nullptr;
+  PendingRequest *request                               = nullptr;
+
+  if (reply) {
+    request          = AcquireRequest();
+    request->reply   = std::move(reply);
+    request->stats   = stats;
+    request->sent_ns = FlutterEngineGetCurrentTime();
+
+    const auto on_reply = [](const uint8_t *data, size_t size, void *user_data) {
+      auto *const request       = static_cast<PendingRequest *>(user_data);
+      const uint64_t latency_ns = FlutterEngineGetCurrentTime() - request->sent_ns;
+
+      request->stats->replies++;
+      request->stats->bytes_in += size;
+      request->stats->latency_ns += latency_ns;
+      UpdateMax(request->stats->latency_max_ns, latency_ns);
+
+      request->reply(data, size);
+      request->dispatcher->RecycleRequest(request);
+    };
+
+    if (FlutterPlatformMessageCreateResponseHandle(engine_, on_reply, request, &response_handle) != kSuccess) {
+      dbgE("Could not create a response handle for channel: %s\n", channel);
+      RecycleRequest(request);
+      return false;
+    }
+  }
+
+  FlutterPlatformMessage platform_message = {
+      .struct_size     = sizeof(FlutterPlatformMessage),
+      .channel         = channel,
+      .message         = data,
+      .message_size    = size,
+      .response_handle = response_handle,
+  };
+
+  const auto result = FlutterEngineSendPlatformMessage(engine_, &platform_message);
+
+  // The engine holds its own reference for as long as the reply is pending.
+  if (response_handle != nullptr) {
+    FlutterPlatformMessageReleaseResponseHandle(engine_, response_handle);
+  }
+
+  if (result != kSuccess) {
+    if (request != nullptr) {
+      RecycleRequest(request);
+    }
+    return false;
+  }
+
+  return true;
+}
+
+void ChannelDispatcher::LogStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (const auto &it : stats_) {
+    const auto &s = *it.second;
+
+    const uint64_t replies = s.replies;
+
+    dbgI("channel %s: received: %ju rejected: %ju sent: %ju in: %ju B out: %ju B latency avg: %.3f ms max: %.3f ms\n", it.first.c_str(), static_cast<uintmax_t>(s.messages.load()), static_cast<uintmax_t>(s.rejected.load()),
+         static_cast<uintmax_t>(s.sent.load()), static_cast<uintmax_t>(s.bytes_in.load()), static_cast<uintmax_t>(s.bytes_out.load()), replies ? s.latency_ns / 1e6 / replies : 0.0, s.latency_max_ns / 1e6);
+  }
+}
+
+} // namespace flutter
@@ -0,0 +1,141 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Routes platform messages sent from Dart to the native handlers registered per channel name
+// and sends messages (optionally awaiting a reply) the other way.
+//
+// Handlers either run inline on the platform thread, which suits cheap ones, or on a bounded pool
+// of worker threads, so that blocking ones (storage, IPC) do not stall the platform task runner.
+// Every message gets exactly one reply: unhandled messages and messages rejected because the
+// worker queue is full are answered with an empty one (MissingPluginException on the Dart side).
+class ChannelDispatcher {
+public:
+  struct ChannelStats;
+
+  // Sends the reply to a single incoming message, can be moved to and used on any thread.
+  // Destroying it without calling Send() replies with an empty message.
+  class Responder {
+  public:
+    Responder() = default;
+    Responder(Responder &&other) noexcept;
+    Responder &operator=(Responder &&other) noexcept;
+    ~Responder();
+
+    bool Send(const uint8_t *data, size_t size);
+
+  private:
+    friend class ChannelDispatcher;
+
+    Responder(FlutterEngine engine, const FlutterPlatformMessageResponseHandle *handle, std::shared_ptr<ChannelStats> stats);
+
+    FlutterEngine engine_                               = nullptr;
+    const FlutterPlatformMessageResponseHandle *handle_ = nullptr;
+    std::shared_ptr<ChannelStats> stats_;
+    uint64_t received_ns_ = 0;
+  };
+
+  enum class ThreadPolicy {
+    kPlatform, // inline, in the platform_message_callback
+    kWorker,   // on the worker pool, the message is copied
+  };
+
+  using Handler       = std::function<void(const uint8_t *data, size_t size, Responder responder)>;
+  using ReplyCallback = std::function<void(const uint8_t *data, size_t size)>;
+
+  struct ChannelStats {
+    std::atomic<uint64_t> messages       = 0; // received from Dart
+    std::atomic<uint64_t> rejected       = 0; // unhandled or worker queue full
+    std::atomic<uint64_t> sent           = 0; // sent to Dart
+    std::atomic<uint64_t> replies        = 0; // in both directions
+    std::atomic<uint64_t> bytes_in       = 0;
+    std::atomic<uint64_t> bytes_out      = 0;
+    std::atomic<uint64_t> latency_ns     = 0; // message to reply, total
+    std::atomic<uint64_t> latency_max_ns = 0;
+  };
+
+  ChannelDispatcher(FlutterEngine engine, size_t workers, size_t max_queued);
+
+  // Shuts down, see Shutdown().
+  ~ChannelDispatcher();
+
+  // Runs the already queued jobs and joins the workers, so the engine must be still running. Later
+  // messages for the worker handlers are rejected. Call it before destroying what these handlers use.
+  void Shutdown();
+
+  // Replaces the previous handler of the channel, if any.
+  void SetHandler(const std::string &channel, Handler handler, ThreadPolicy policy = ThreadPolicy::kPlatform);
+
+  void RemoveHandler(const std::string &channel);
+
+  // platform_message_callback
+  void OnPlatformMessage(const FlutterPlatformMessage *message);
+
+  // reply, if set, is called on the platform thread.
+  bool Send(const char *channel, const uint8_t *data, size_t size, ReplyCallback reply = nullptr);
+
+  void LogStats();
+
+private:
+  struct Channel {
+    Handler handler;
+    ThreadPolicy policy = ThreadPolicy::kPlatform;
+    std::shared_ptr<ChannelStats> stats;
+  };
+
+  // Context of an outgoing message awaiting the reply, recycled through free_requests_.
+  struct PendingRequest {
+    ChannelDispatcher *dispatcher = nullptr;
+    ReplyCallback reply;
+    std::shared_ptr<ChannelStats> stats;
+    uint64_t sent_ns = 0;
+  };
+
+  std::shared_ptr<ChannelStats> StatsFor(const std::string &channel);
+
+  PendingRequest *AcquireRequest();
+
+  void RecycleRequest(PendingRequest *request);
+
+  bool Enqueue(std::function<void()> job);
+
+  void WorkerMain();
+
+  const FlutterEngine engine_;
+  const size_t max_queued_;
+
+  std::mutex mutex_;
+  std::map<std::string, Channel, std::less<>> channels_;
+  std::map<std::string, std::shared_ptr<ChannelStats>, std::less<>> stats_;
+  std::vector<std::unique_ptr<PendingRequest>> requests_;
+  std::vector<PendingRequest *> free_requests_;
+
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<std::function<void()>> queue_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ChannelDispatcher)
+};
+
+} // namespace flutter
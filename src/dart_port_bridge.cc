@@ -0,0 +1,263 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "channel_dispatcher.h"
+#include "dart_port_bridge.h"
+#include "debug.h"
+
+namespace flutter {
+
+DartPortBridge::DartPortBridge(FlutterEngine engine, ChannelDispatcher &channels, bool batching, int notify_fd)
+    : engine_(engine)
+    , channels_(channels)
+    , batching_(batching)
+    , notify_fd_(notify_fd) {
+  // Inline, so that topics_ is only ever modified on the platform thread (see Flush()).
+  channels_.SetHandler(
+      kChannel,
+      [this](const uint8_t *data, size_t size, ChannelDispatcher::Responder responder) {
+        StandardMessageWriter reply;
+        HandleMethodCall(data, size, reply);
+        responder.Send(reply.data(), reply.size());
+      },
+      ChannelDispatcher::ThreadPolicy::kPlatform);
+}
+
+DartPortBridge::~DartPortBridge() {
+  channels_.RemoveHandler(kChannel);
+
+  dbgI("dart ports: events: %ju posts: %ju dropped: %ju failed: %ju\n", static_cast<uintmax_t>(stats_.events.load()), static_cast<uintmax_t>(stats_.posts.load()), static_cast<uintmax_t>(stats_.dropped.load()),
+       static_cast<uintmax_t>(stats_.failed.load()));
+}
+
+void DartPortBridge::HandleMethodCall(const uint8_t *data, size_t size, StandardMessageWriter &reply) {
+  StandardMessageReader reader(data, size);
+  std::string_view method;
+  StandardValue arguments;
+
+  if (!StandardMethodCodec::DecodeMethodCall(reader, &method, &arguments)) {
+    StandardMethodCodec::EncodeErrorEnvelope(reply, "malformed", "Could not decode the method call", StandardValue());
+    return;
+  }
+
+  const auto *topic = arguments.Find("topic");
+
+  if (topic == nullptr || topic->Get<std::string_view>() == nullptr) {
+    StandardMethodCodec::EncodeErrorEnvelope(reply, "bad-arguments", "Missing topic", StandardValue());
+    return;
+  }
+
+  const std::string name(*topic->Get<std::string_view>());
+
+  if (method == "register") {
+    int64_t port;
+    const auto *port_value = arguments.Find("port");
+
+    if (port_value == nullptr || !port_value->GetInt(&port)) {
+      StandardMethodCodec::EncodeErrorEnvelope(reply, "bad-arguments", "Missing port", StandardValue());
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    topics_[name].port = port;
+    dbgI("dart ports: %s -> %jd\n", name.c_str(), static_cast<intmax_t>(port));
+  } else if (method == "unregister") {
+    std::lock_guard<std::mutex> lock(mutex_);
+    topics_.erase(name);
+  } else {
+    reply.Reset(); // empty reply: not implemented
+    return;
+  }
+
+  StandardMethodCodec::EncodeSuccessEnvelope(reply, StandardValue());
+}
+
+bool DartPortBridge::PostObject(FlutterEngineDartPort port, const FlutterEngineDartObject &object) {
+  if (FlutterEnginePostDartObject(engine_, port, &object) != kSuccess) {
+    stats_.failed++;
+    return false;
+  }
+
+  stats_.posts++;
+
+  return true;
+}
+
+bool DartPortBridge::PostBuffer(FlutterEngineDartPort port, const uint8_t *data, size_t size) {
+  // Without a collect callback the engine copies the buffer, so it can be reused right away.
+  const FlutterEngineDartBuffer buffer = {
+      .struct_size             = sizeof(FlutterEngineDartBuffer),
+      .user_data               = nullptr,
+      .buffer_collect_callback = nullptr,
+      .buffer                  = const_cast<uint8_t *>(data),
+      .buffer_size             = size,
+  };
+
+  FlutterEngineDartObject object = {};
+  object.type                    = kFlutterEngineDartObjectTypeBuffer;
+  object.buffer_value            = &buffer;
+
+  return PostObject(port, object);
+}
+
+bool DartPortBridge::FindPort(const std::string &topic, FlutterEngineDartPort *port) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto it = topics_.find(topic);
+
+  if (it == topics_.end()) {
+    stats_.dropped++;
+    return false;
+  }
+
+  stats_.events++;
+  *port = it->second.port;
+
+  return true;
+}
+
+template <typename Encode> bool DartPortBridge::Append(const std::string &topic, Encode encode) {
+  bool notify;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto it = topics_.find(topic);
+
+    if (it == topics_.end()) {
+      stats_.dropped++;
+      return false;
+    }
+
+    stats_.events++;
+
+    Topic &t = it->second;
+    encode(t.batch);
+
+    if (t.first_event_ns == 0) {
+      t.first_event_ns = FlutterEngineGetCurrentTime();
+    }
+
+    notify = oldest_event_ns_ == 0;
+
+    if (notify) {
+      oldest_event_ns_ = t.first_event_ns;
+    }
+  }
+
+  // Let the platform thread arm the flush deadline.
+  if (notify && notify_fd_ != -1) {
+    const uint64_t value = 1;
+    if (write(notify_fd_, &value, sizeof(value)) != sizeof(value)) {
+      dbgW("Could not wake up the platform thread (errno: %d)\n", errno);
+    }
+  }
+
+  return true;
+}
+
+bool DartPortBridge::Post(const std::string &topic, int64_t value) {
+  if (batching_) {
+    return Append(topic, [value](StandardMessageWriter &w) { w.WriteInt(value); });
+  }
+
+  FlutterEngineDartPort port;
+
+  if (!FindPort(topic, &port)) {
+    return false;
+  }
+
+  FlutterEngineDartObject object = {};
+  object.type                    = kFlutterEngineDartObjectTypeInt64;
+  object.int64_value             = value;
+
+  return PostObject(port, object);
+}
+
+bool DartPortBridge::Post(const std::string &topic, double value) {
+  if (batching_) {
+    return Append(topic, [value](StandardMessageWriter &w) { w.WriteDouble(value); });
+  }
+
+  FlutterEngineDartPort port;
+
+  if (!FindPort(topic, &port)) {
+    return false;
+  }
+
+  FlutterEngineDartObject object = {};
+  object.type                    = kFlutterEngineDartObjectTypeDouble;
+  object.double_value            = value;
+
+  return PostObject(port, object);
+}
+
+bool DartPortBridge::Post(const std::string &topic, std::span<const uint8_t> value) {
+  if (batching_) {
+    return Append(topic, [value](StandardMessageWriter &w) { w.WriteUint8List(value); });
+  }
+
+  FlutterEngineDartPort port;
+
+  if (!FindPort(topic, &port)) {
+    return false;
+  }
+
+  return PostBuffer(port, value.data(), value.size());
+}
+
+void DartPortBridge::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (oldest_event_ns_ == 0) {
+    return;
+  }
+
+  oldest_event_ns_ = 0;
+
+  // Posting is done unlocked, producers only append to the batches in the meantime.
+  for (auto &it : topics_) {
+    Topic &t = it.second;
+
+    if (t.first_event_ns == 0) {
+      continue;
+    }
+
+    t.first_event_ns = 0;
+    t.batch.Swap(flushing_);
+
+    const FlutterEngineDartPort port = t.port;
+
+    lock.unlock();
+    PostBuffer(port, flushing_.data(), flushing_.size());
+    flushing_.Reset();
+    lock.lock();
+  }
+}
+
+uint64_t DartPortBridge::FlushIfDue(uint64_t max_delay_ns) {
+  uint64_t oldest_event_ns;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    oldest_event_ns = oldest_event_ns_;
+  }
+
+  if (oldest_event_ns == 0) {
+    return 0;
+  }
+
+  if (FlutterEngineGetCurrentTime() - oldest_event_ns < max_delay_ns) {
+    return oldest_event_ns + max_delay_ns;
+  }
+
+  Flush();
+
+  return 0;
+}
+
+} // namespace flutter
@@ -0,0 +1,94 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+
+#include "macros.h"
+#include "standard_codec.h"
+
+namespace flutter {
+
+class ChannelDispatcher;
+
+// Fast path for high-rate native events (remote control, sensors, playback position) which
+// bypasses platform messages: the events are posted straight to Dart ReceivePorts with
+// FlutterEnginePostDartObject.
+//
+// Dart registers a port per topic through the "flutter_wayland/dart_ports" channel
+// (StandardMethodCodec, register: {"topic": String, "port": int}, unregister: {"topic": String}).
+// Native code posts events to a topic from any thread. With batching enabled, the events of
+// a topic are accumulated and posted once per frame, right before the vsync is delivered to the
+// engine, or at the latest one frame after the first of them when no frame is being produced.
+// A batch arrives in Dart as a Uint8List holding StandardMessageCodec values back to back
+// (read them with StandardMessageCodec.readValue() until the ReadBuffer is exhausted).
+// Without batching every event is posted as a plain int or double, or as a Uint8List.
+class DartPortBridge {
+public:
+  static constexpr const char *kChannel = "flutter_wayland/dart_ports";
+
+  DartPortBridge(FlutterEngine engine, ChannelDispatcher &channels, bool batching, int notify_fd);
+
+  ~DartPortBridge();
+
+  // Any thread, returns false if no port is registered for the topic.
+  bool Post(const std::string &topic, int64_t value);
+  bool Post(const std::string &topic, double value);
+  bool Post(const std::string &topic, std::span<const uint8_t> value);
+
+  // Platform thread, posts all the pending batches.
+  void Flush();
+
+  // Platform thread, flushes if the oldest pending event has waited for max_delay_ns,
+  // returns when it should be called again (0 if nothing is pending).
+  uint64_t FlushIfDue(uint64_t max_delay_ns);
+
+private:
+  struct Topic {
+    FlutterEngineDartPort port = 0;
+    StandardMessageWriter batch;
+    uint64_t first_event_ns = 0; // of the pending batch, 0 if empty
+  };
+
+  void HandleMethodCall(const uint8_t *data, size_t size, StandardMessageWriter &reply);
+
+  // Appends an event with the mutex held, encode writes it into the batch.
+  template <typename Encode> bool Append(const std::string &topic, Encode encode);
+
+  bool FindPort(const std::string &topic, FlutterEngineDartPort *port);
+
+  bool PostObject(FlutterEngineDartPort port, const FlutterEngineDartObject &object);
+
+  bool PostBuffer(FlutterEngineDartPort port, const uint8_t *data, size_t size);
+
+  const FlutterEngine engine_;
+  ChannelDispatcher &channels_;
+  const bool batching_;
+  const int notify_fd_;
+
+  std::mutex mutex_;
+  std::map<std::string, Topic, std::less<>> topics_;
+  uint64_t oldest_event_ns_ = 0; // across all the topics, 0 if none pending
+
+  StandardMessageWriter flushing_; // platform thread only
+
+  struct {
+    std::atomic<uint64_t> events  = 0;
+    std::atomic<uint64_t> posts   = 0;
+    std::atomic<uint64_t> dropped = 0; // no port registered
+    std::atomic<uint64_t> failed  = 0;
+  } stats_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(DartPortBridge)
+};
+
+} // namespace flutter
@@ -34,6 +34,7 @@
 
 #include "utils.h"
 #include "debug.h"
+#include "metrics.h"
 
 namespace flutter {
 
@@ -83,13 +84,14 @@ static void vdbg(const int priority, const char *format, va_list args1) {
 
   if (rv < 0) {
     va_end(args2);
+    Metrics::Instance().log_drops.Add();
     return;
   }
 
   if (static_cast<std::size_t>(rv) < std::size(buf)) {
     va_end(args2);
 
-    printf("%s%s", priority2prefix(priority), buf);
+    rv = printf("%s%s", priority2prefix(priority), buf);
     fflush(stdout);
   } else {
     const size_t len = rv + 1;
@@ -97,9 +99,15 @@ static void vdbg(const int priority, const char *format, va_list args1) {
     std::vsnprintf(str.data(), len, format, args2);
     va_end(args2);
 
-    printf("%s%s", priority2prefix(priority), str.data());
+    rv = printf("%s%s", priority2prefix(priority), str.data());
     fflush(stdout);
   }
+
+  if (rv < 0) {
+    Metrics::Instance().log_drops.Add();
+  } else {
+    Metrics::Instance().log_messages.Add();
+  }
 }
 
 // clang-format off
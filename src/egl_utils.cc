@@ -3,6 +3,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <dlfcn.h>
+#include <strings.h>
+
+#include <cstring>
+
+#include <limits>
+#include <vector>
+
 #include <wayland-egl.h>
 #include <EGL/egl.h>
 #include "egl_utils.h"
@@ -42,4 +50,158 @@ void LogLastEGLError() {
   dbgE("Unknown EGL Error (%d)\n", last_error);
 }
 
+bool HasEGLExtension(EGLDisplay display, const char *name) {
+  const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+
+  if (extensions == nullptr) {
+    return false;
+  }
+
+  const size_t len = strlen(name);
+
+  for (const char *p = extensions; (p = strstr(p, name)) != nullptr; p += len) {
+    if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0')) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void *ResolveGLProc(const char *name) {
+  auto address = eglGetProcAddress(name);
+
+  if (address != nullptr) {
+    return reinterpret_cast<void *>(address);
+  }
+
+  dbgW("Using dlsym fallback to resolve: %s\n.", name ? name : "");
+
+  address = reinterpret_cast<void (*)()>(dlsym(RTLD_DEFAULT, name));
+
+  if (address != nullptr) {
+    return reinterpret_cast<void *>(address);
+  }
+
+  dbgW("Tried unsuccessfully to resolve: %s\n.", name ? name : "");
+  return nullptr;
+}
+
+static const struct {
+  EGLConfigPolicy::Format format;
+  const char *name;
+  EGLint red, green, blue, alpha;
+} kFormats[] = {
+    {EGLConfigPolicy::Format::kARGB8888, "argb8888", 8, 8, 8, 8},
+    {EGLConfigPolicy::Format::kXRGB8888, "xrgb8888", 8, 8, 8, 0},
+    {EGLConfigPolicy::Format::kRGB565, "rgb565", 5, 6, 5, 0},
+};
+
+bool ParseEGLConfigFormat(const std::string &name, EGLConfigPolicy::Format *format) {
+  for (const auto &f : kFormats) {
+    if (strcasecmp(name.c_str(), f.name) == 0) {
+      *format = f.format;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char *EGLConfigFormatName(EGLConfigPolicy::Format format) {
+  for (const auto &f : kFormats) {
+    if (f.format == format) {
+      return f.name;
+    }
+  }
+
+  return "unknown";
+}
+
+static EGLint get_config_attrib(EGLDisplay display, EGLConfig config, EGLint attribute) {
+  EGLint value = 0;
+
+  if (eglGetConfigAttrib(display, config, attribute, &value) != EGL_TRUE) {
+    return 0;
+  }
+
+  return value;
+}
+
+// Lower is better, negative means the config is not acceptable at all.
+static long rank_config(EGLDisplay display, EGLConfig config, const EGLConfigPolicy &policy) {
+  const auto &f = kFormats[static_cast<size_t>(policy.format)];
+
+  const EGLint red     = get_config_attrib(display, config, EGL_RED_SIZE);
+  const EGLint green   = get_config_attrib(display, config, EGL_GREEN_SIZE);
+  const EGLint blue    = get_config_attrib(display, config, EGL_BLUE_SIZE);
+  const EGLint alpha   = get_config_attrib(display, config, EGL_ALPHA_SIZE);
+  const EGLint depth   = get_config_attrib(display, config, EGL_DEPTH_SIZE);
+  const EGLint stencil = get_config_attrib(display, config, EGL_STENCIL_SIZE);
+  const EGLint samples = get_config_attrib(display, config, EGL_SAMPLES);
+
+  if (red < f.red || green < f.green || blue < f.blue || alpha < f.alpha || stencil < policy.stencil_size || samples < policy.samples) {
+    return -1;
+  }
+
+  // Every extra bit of a pixel costs memory bandwidth, color mismatches matter the most.
+  long penalty = 0;
+  penalty += 1000 * ((red - f.red) + (green - f.green) + (blue - f.blue));
+  penalty += 100 * (alpha - f.alpha);
+  penalty += 10 * (depth + (stencil - policy.stencil_size));
+  penalty += samples - policy.samples;
+
+  return penalty;
+}
+
+EGLConfig ChooseEGLConfig(EGLDisplay display, const EGLConfigPolicy &policy) {
+  const EGLint attribs[] = {
+      // clang-format off
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_SURFACE_TYPE,    policy.surface_type,
+    EGL_NONE,            // termination sentinel
+      // clang-format on
+  };
+
+  EGLint config_count = 0;
+
+  if (eglChooseConfig(display, attribs, nullptr, 0, &config_count) != EGL_TRUE || config_count == 0) {
+    LogLastEGLError();
+    return nullptr;
+  }
+
+  std::vector<EGLConfig> configs(config_count);
+
+  if (eglChooseConfig(display, attribs, configs.data(), config_count, &config_count) != EGL_TRUE) {
+    LogLastEGLError();
+    return nullptr;
+  }
+
+  EGLConfig best   = nullptr;
+  long best_rank   = std::numeric_limits<long>::max();
+
+  for (EGLint i = 0; i < config_count; i++) {
+    const long rank = rank_config(display, configs[i], policy);
+
+    dbgT("EGL config: id: %d rank: %ld\n", get_config_attrib(display, configs[i], EGL_CONFIG_ID), rank);
+
+    if (rank >= 0 && rank < best_rank) {
+      best      = configs[i];
+      best_rank = rank;
+    }
+  }
+
+  if (best == nullptr) {
+    dbgE("No EGL config matching: format: %s stencil: %d samples: %d (out of %d configs)\n", EGLConfigFormatName(policy.format), policy.stencil_size, policy.samples, config_count);
+  }
+
+  return best;
+}
+
+void LogEGLConfig(EGLDisplay display, EGLConfig config) {
+  dbgI("EGL config: id: %d r:%d g:%d b:%d a:%d depth:%d stencil:%d samples:%d\n", get_config_attrib(display, config, EGL_CONFIG_ID), get_config_attrib(display, config, EGL_RED_SIZE), get_config_attrib(display, config, EGL_GREEN_SIZE),
+       get_config_attrib(display, config, EGL_BLUE_SIZE), get_config_attrib(display, config, EGL_ALPHA_SIZE), get_config_attrib(display, config, EGL_DEPTH_SIZE), get_config_attrib(display, config, EGL_STENCIL_SIZE),
+       get_config_attrib(display, config, EGL_SAMPLES));
+}
+
 } // namespace flutter
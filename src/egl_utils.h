@@ -5,10 +5,42 @@
 
 #pragma once
 
+#include <EGL/egl.h>
+#include <string>
+
 #include "macros.h"
 
 namespace flutter {
 
 void LogLastEGLError();
 
+// Checks the display extension string for an exact match of the extension name.
+bool HasEGLExtension(EGLDisplay display, const char *name);
+
+// Resolves a GL/EGL entry point using eglGetProcAddress(), falling back to dlsym().
+void *ResolveGLProc(const char *name);
+
+// Requested window surface format, see ChooseEGLConfig().
+struct EGLConfigPolicy {
+  enum class Format { kARGB8888, kXRGB8888, kRGB565 };
+
+  Format format       = Format::kARGB8888;
+  EGLint stencil_size = 0; // minimum
+  EGLint samples      = 0; // minimum, 0 disables MSAA
+  EGLint surface_type = EGL_WINDOW_BIT;
+};
+
+// Parses "argb8888", "xrgb8888" or "rgb565" (case insensitive).
+bool ParseEGLConfigFormat(const std::string &name, EGLConfigPolicy::Format *format);
+
+const char *EGLConfigFormatName(EGLConfigPolicy::Format format);
+
+// Enumerates all ES2 configs of the policy's surface type and returns the one closest to the policy: exact color
+// channel sizes are preferred, as few unrequested bits (alpha, depth, extra stencil/samples)
+// as possible, hard requirements are the minimum stencil size and number of samples.
+// Returns nullptr if no config satisfies them.
+EGLConfig ChooseEGLConfig(EGLDisplay display, const EGLConfigPolicy &policy);
+
+void LogEGLConfig(EGLDisplay display, EGLConfig config);
+
 } // namespace flutter
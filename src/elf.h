@@ -20,6 +20,10 @@
 //    distribution.
 //
 
+#pragma once
+
+#include <cstdint>
+
 namespace flutter {
 
 typedef struct {
@@ -2,17 +2,16 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-#include "event_loop.h"
-#include <atomic>
-#include <utility>
-#include <climits>
-
 #include "event_loop.h"
 
 #include <atomic>
+#include <cmath>
 #include <utility>
 #include <unistd.h>
 
+#include "debug.h"
+#include "metrics.h"
+
 namespace flutter {
 
 PlatformEventLoop::PlatformEventLoop(std::thread::id main_thread_id, const TaskExpiredCallback &on_task_expired, int notify_fd)
@@ -27,44 +26,74 @@ bool PlatformEventLoop::RunsTasksOnCurrentThread() const {
   return std::this_thread::get_id() == main_thread_id_;
 }
 
-uint64_t PlatformEventLoop::ProcessEvents() {
-  std::vector<FlutterTask> expired_tasks;
+uint64_t PlatformEventLoop::ProcessEvents(uint64_t budget_ns, const std::function<bool()> &should_yield) {
+  const uint64_t start_processing_time = FlutterEngineGetCurrentTime();
 
-  // Process expired tasks.
   {
     std::lock_guard<std::mutex> lock(task_queue_mutex_);
-    const uint64_t start_processing_time = FlutterEngineGetCurrentTime();
-    while (!task_queue_.empty()) {
-      const auto &top = task_queue_.top();
-      // If this task (and all tasks after this) has not yet expired, there is
-      // nothing more to do. Quit iterating.
-      if (top.fire_time > start_processing_time) {
+    Metrics::Instance().platform_task_queue_depth.Set(task_queue_.size());
+  }
+
+  const auto out_of_budget = [&]() {
+    return budget_ns != 0 && (FlutterEngineGetCurrentTime() - start_processing_time >= budget_ns || (should_yield && should_yield()));
+  };
+
+  bool yielded = false;
+
+  // Fire the tasks expired before this call one by one, without holding onto the task queue mutex,
+  // so that the budget can be checked in between. The tasks posted meanwhile wait for the next call.
+  while (!yielded) {
+    FlutterTask task;
+    uint64_t fire_time;
+    {
+      std::lock_guard<std::mutex> lock(task_queue_mutex_);
+      if (task_queue_.empty() || task_queue_.top().fire_time > start_processing_time) {
         break;
       }
 
-      // Make a record of the expired task. Do NOT service the task here
-      // because we are still holding onto the task queue mutex. We don't want
-      // other threads to block on posting tasks onto this thread till we are
-      // done processing expired tasks.
-      expired_tasks.push_back(task_queue_.top().task);
-
-      // Remove the tasks from the delayed tasks queue.
+      task      = task_queue_.top().task;
+      fire_time = task_queue_.top().fire_time;
       task_queue_.pop();
     }
+
+    const uint64_t task_start = FlutterEngineGetCurrentTime();
+    on_task_expired_(&task);
+    const uint64_t task_duration = FlutterEngineGetCurrentTime() - task_start;
+
+    Metrics::Instance().platform_task_lateness.Observe(task_start - fire_time);
+    Metrics::Instance().platform_task_duration.Observe(task_duration);
+
+    if (slow_task_threshold_ns_ != 0 && task_duration > slow_task_threshold_ns_) {
+      Metrics::Instance().platform_tasks_slow.Add();
+      dbgW("slow platform task: %.3f ms (late by %.3f ms)\n", task_duration / 1e6, (task_start - fire_time) / 1e6);
+    }
+
+    yielded = out_of_budget();
   }
 
-  // Fire expired tasks.
-  {
-    // Flushing tasks here without holing onto the task queue mutex.
-    for (const auto &task : expired_tasks) {
-      on_task_expired_(&task);
+  // Background tasks only get what is left of the budget.
+  while (!yielded) {
+    std::function<void()> task;
+    {
+      std::lock_guard<std::mutex> lock(task_queue_mutex_);
+      if (background_tasks_.empty()) {
+        break;
+      }
+
+      task = std::move(background_tasks_.front());
+      background_tasks_.pop_front();
     }
+
+    task();
+    yielded = out_of_budget();
   }
 
-  // return timestamp of next event or 0 if none
+  // return timestamp of next event or 0 if none, the expired tasks left over are already due
   {
     std::lock_guard<std::mutex> lock(task_queue_mutex_);
-    if (task_queue_.empty()) {
+    if (!background_tasks_.empty()) {
+      return start_processing_time;
+    } else if (task_queue_.empty()) {
       return 0;
     } else {
       return task_queue_.top().fire_time;
@@ -83,6 +112,7 @@ void PlatformEventLoop::PostTask(FlutterTask flutter_task, uint64_t flutter_targ
   {
     std::lock_guard<std::mutex> lock(task_queue_mutex_);
     task_queue_.push(task);
+    Metrics::Instance().platform_task_post_depth.Observe(task_queue_.size());
 
     // Make sure the queue mutex is unlocked before waking up the loop. In case
     // the wake causes this thread to be descheduled for the primary thread to
@@ -92,6 +122,35 @@ void PlatformEventLoop::PostTask(FlutterTask flutter_task, uint64_t flutter_targ
   Wake();
 }
 
+void PlatformEventLoop::PostBackgroundTask(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(task_queue_mutex_);
+    background_tasks_.push_back(std::move(task));
+  }
+  Wake();
+}
+
+void PlatformEventLoop::LogStats() const {
+  const Metrics &m = Metrics::Instance();
+
+  const auto quantile_ms = [](const MetricsHistogram &histogram, double q) {
+    const uint64_t ns = histogram.QuantileNs(q);
+    return ns == UINT64_MAX ? INFINITY : ns / 1e6;
+  };
+
+  const uint64_t tasks = m.platform_task_duration.CumulativeCount(MetricsHistogram::kBoundsNs.size());
+
+  if (tasks == 0) {
+    return;
+  }
+
+  const uint64_t posted = m.platform_task_post_depth.CumulativeCount(MetricsSizeHistogram::kBounds.size());
+
+  dbgI("platform tasks: %ju run, %ju slow, mean queue depth at post: %.1f\n", static_cast<uintmax_t>(tasks), static_cast<uintmax_t>(m.platform_tasks_slow.Value()), posted ? static_cast<double>(m.platform_task_post_depth.Sum()) / posted : 0.);
+  dbgI("platform tasks: lateness p50 <= %g ms, p99 <= %g ms; duration p50 <= %g ms, p99 <= %g ms, mean: %.3f ms\n", quantile_ms(m.platform_task_lateness, 0.50), quantile_ms(m.platform_task_lateness, 0.99), quantile_ms(m.platform_task_duration, 0.50), quantile_ms(m.platform_task_duration, 0.99),
+       m.platform_task_duration.SumNs() / 1e6 / tasks);
+}
+
 void PlatformEventLoop::Wake() {
   ssize_t ret  = 0;
   uint64_t val = 1;
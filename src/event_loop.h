@@ -18,6 +18,9 @@ namespace flutter {
 
 // platform event loop, to handle flutter platform events
 // adapted from flutter engine glfw embedder (flutter/shell/platform/glfw/flutter_glfw.cc)
+//
+// The work of the platform thread is served in lanes: the I/O (vsync, input) handled by the caller
+// between ProcessEvents() calls, the engine tasks, then the background (housekeeping) tasks.
 class PlatformEventLoop {
 public:
   using TaskExpiredCallback = std::function<void(const FlutterTask *)>;
@@ -36,11 +39,24 @@ public:
   bool RunsTasksOnCurrentThread() const;
 
   // processes expired events, and returns next wake up point or 0 if there are no events
-  uint64_t ProcessEvents();
+  // With a non-zero budget_ns, it stops once the budget is used up or should_yield() returns true
+  // (e.g. I/O is pending), the remaining expired events are then due at the returned wake up point.
+  uint64_t ProcessEvents(uint64_t budget_ns = 0, const std::function<bool()> &should_yield = nullptr);
 
   // Posts a Flutter engine task to the event loop for delayed execution.
   void PostTask(FlutterTask flutter_task, uint64_t flutter_target_time_nanos);
 
+  // Posts housekeeping work, run once there are no expired engine tasks left.
+  void PostBackgroundTask(std::function<void()> task);
+
+  // Engine tasks running longer than this are logged, 0 disables the log.
+  void SetSlowTaskThreshold(uint64_t threshold_ns) {
+    slow_task_threshold_ns_ = threshold_ns;
+  }
+
+  // Logs the lateness and duration percentiles and the post time queue depth of the engine tasks.
+  void LogStats() const;
+
 protected:
 
   // Wakes the main thread
@@ -64,7 +80,9 @@ protected:
   TaskExpiredCallback on_task_expired_;
   std::mutex task_queue_mutex_;
   std::priority_queue<Task, std::deque<Task>, Task::Comparer> task_queue_;
+  std::deque<std::function<void()>> background_tasks_;
   int notify_fd_;
+  uint64_t slow_task_threshold_ns_ = 0;
 };
 
 } // namespace flutter
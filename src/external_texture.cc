@@ -0,0 +1,480 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sys/mman.h>
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <algorithm>
+
+#include "debug.h"
+#include "egl_utils.h"
+#include "external_texture.h"
+
+namespace flutter {
+
+// GLES is not linked directly, the entry points are resolved the same way the engine does it.
+static struct {
+  bool resolved = false;
+  PFNGLEGLIMAGETARGETTEXTURE2DOESPROC EGLImageTargetTexture2DOES;
+  void(GL_APIENTRYP GenTextures)(GLsizei, GLuint *);
+  void(GL_APIENTRYP DeleteTextures)(GLsizei, const GLuint *);
+  void(GL_APIENTRYP BindTexture)(GLenum, GLuint);
+  void(GL_APIENTRYP TexParameteri)(GLenum, GLenum, GLint);
+  void(GL_APIENTRYP PixelStorei)(GLenum, GLint);
+  void(GL_APIENTRYP TexImage2D)(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void *);
+  void(GL_APIENTRYP TexSubImage2D)(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void *);
+} gl;
+
+static bool ResolveGL() {
+  if (!gl.resolved) {
+    gl.EGLImageTargetTexture2DOES = reinterpret_cast<decltype(gl.EGLImageTargetTexture2DOES)>(eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+    gl.GenTextures                = reinterpret_cast<decltype(gl.GenTextures)>(ResolveGLProc("glGenTextures"));
+    gl.DeleteTextures             = reinterpret_cast<decltype(gl.DeleteTextures)>(ResolveGLProc("glDeleteTextures"));
+    gl.BindTexture                = reinterpret_cast<decltype(gl.BindTexture)>(ResolveGLProc("glBindTexture"));
+    gl.TexParameteri              = reinterpret_cast<decltype(gl.TexParameteri)>(ResolveGLProc("glTexParameteri"));
+    gl.PixelStorei                = reinterpret_cast<decltype(gl.PixelStorei)>(ResolveGLProc("glPixelStorei"));
+    gl.TexImage2D                 = reinterpret_cast<decltype(gl.TexImage2D)>(ResolveGLProc("glTexImage2D"));
+    gl.TexSubImage2D              = reinterpret_cast<decltype(gl.TexSubImage2D)>(ResolveGLProc("glTexSubImage2D"));
+    gl.resolved                   = true;
+  }
+
+  return gl.GenTextures && gl.DeleteTextures && gl.BindTexture && gl.TexParameteri && gl.PixelStorei && gl.TexImage2D && gl.TexSubImage2D;
+}
+
+static bool AllocateBuffer(ExternalTextureRegistry::Buffer &buffer, size_t width, size_t height) {
+  buffer.width  = width;
+  buffer.height = height;
+  buffer.stride = width * 4;
+  buffer.size   = buffer.stride * height;
+  buffer.fd     = memfd_create("flutter-external-texture", MFD_CLOEXEC);
+
+  if (buffer.fd == -1) {
+    dbgE("memfd_create() failed (errno: %d)\n", errno);
+    return false;
+  }
+
+  if (ftruncate(buffer.fd, buffer.size) == -1) {
+    dbgE("ftruncate() failed (errno: %d)\n", errno);
+    return false;
+  }
+
+  void *const data = mmap(nullptr, buffer.size, PROT_READ | PROT_WRITE, MAP_SHARED, buffer.fd, 0);
+
+  if (data == MAP_FAILED) {
+    dbgE("mmap() failed (errno: %d)\n", errno);
+    return false;
+  }
+
+  buffer.data = static_cast<uint8_t *>(data);
+
+  return true;
+}
+
+static void FreeBuffer(ExternalTextureRegistry::Buffer &buffer) {
+  if (buffer.data != nullptr) {
+    munmap(buffer.data, buffer.size);
+    buffer.data = nullptr;
+  }
+
+  if (buffer.fd != -1) {
+    close(buffer.fd);
+    buffer.fd = -1;
+  }
+}
+
+struct ExternalTextureRegistry::Texture {
+  enum class State { kFree, kProducing, kQueued, kUploading };
+
+  struct Slot {
+    Buffer buffer;
+    State state = State::kFree;
+  };
+
+  struct Image {
+    EGLImage image = EGL_NO_IMAGE;
+    size_t width   = 0;
+    size_t height  = 0;
+    ReleaseCallback release;
+
+    void Release() {
+      if (release) {
+        release();
+      }
+      *this = Image();
+    }
+  };
+
+  explicit Texture(ExternalTextureRegistry *registry)
+      : registry(registry) {
+  }
+
+  // The last reference may be dropped on any thread, also in the middle of an upload on the raster thread.
+  ~Texture() {
+    // Queued or bound after Retire(), by a SubmitEGLImage() or Populate() racing with UnregisterTexture().
+    queued_image.Release();
+    bound_image.Release();
+
+    for (auto &slot : slots) {
+      FreeBuffer(slot.buffer);
+    }
+
+    if (name != 0) {
+      std::lock_guard<std::mutex> lock(registry->mutex_);
+      registry->orphaned_names_.push_back(name);
+    }
+  }
+
+  ExternalTextureRegistry *const registry;
+  int64_t id = 0;
+  std::mutex mutex;
+  std::vector<Slot> slots;
+  Slot *queued = nullptr;
+  Image queued_image;
+  Image bound_image;
+  uint64_t queued_ns = 0;
+
+  // Raster thread only.
+  GLuint name          = 0;
+  size_t width         = 0; // of the current GL storage
+  size_t height        = 0;
+  bool storage_is_shm_ = false;
+
+  struct {
+    uint64_t submitted      = 0;
+    uint64_t shown          = 0;
+    uint64_t dropped        = 0;
+    uint64_t copied_bytes   = 0;
+    uint64_t latency_ns     = 0; // submit to populate, total
+    uint64_t latency_max_ns = 0;
+  } stats;
+
+  Slot *FindSlot(const Buffer *buffer) {
+    for (auto &slot : slots) {
+      if (&slot.buffer == buffer) {
+        return &slot;
+      }
+    }
+    return nullptr;
+  }
+
+  // Called with the mutex held, drops the previously queued frame if not consumed yet.
+  void Queued(const uint64_t now_ns) {
+    if (queued != nullptr) {
+      queued->state = State::kFree;
+      queued        = nullptr;
+      stats.dropped++;
+    }
+
+    if (queued_image.image != EGL_NO_IMAGE) {
+      queued_image.Release();
+      stats.dropped++;
+    }
+
+    queued_ns = now_ns;
+    stats.submitted++;
+  }
+
+  // Gives all the images back to the producer and logs the statistics.
+  void Retire() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    queued_image.Release();
+    bound_image.Release();
+
+    dbgI("external texture %jd: submitted: %ju shown: %ju dropped: %ju copied: %.1f MiB latency avg: %.3f ms max: %.3f ms\n", static_cast<intmax_t>(id), static_cast<uintmax_t>(stats.submitted), static_cast<uintmax_t>(stats.shown),
+         static_cast<uintmax_t>(stats.dropped), stats.copied_bytes / (1024.0 * 1024.0), stats.shown ? stats.latency_ns / 1e6 / stats.shown : 0.0, stats.latency_max_ns / 1e6);
+  }
+};
+
+ExternalTextureRegistry::ExternalTextureRegistry(FlutterEngine engine)
+    : engine_(engine) {
+}
+
+ExternalTextureRegistry::~ExternalTextureRegistry() {
+  // The engine is gone already, GL textures are destroyed together with the context.
+  for (auto &it : textures_) {
+    it.second->Retire();
+  }
+
+  textures_.clear();
+}
+
+std::shared_ptr<ExternalTextureRegistry::Texture> ExternalTextureRegistry::Find(int64_t texture_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto it = textures_.find(texture_id);
+
+  return it != textures_.end() ? it->second : nullptr;
+}
+
+int64_t ExternalTextureRegistry::RegisterTexture(size_t width, size_t height, size_t pool_size) {
+  auto texture = std::make_shared<Texture>(this);
+
+  texture->slots.resize(pool_size);
+
+  for (auto &slot : texture->slots) {
+    if (!AllocateBuffer(slot.buffer, width, height)) {
+      return -1;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    texture->id = next_id_++;
+    textures_.emplace(texture->id, texture);
+  }
+
+  if (FlutterEngineRegisterExternalTexture(engine_, texture->id) != kSuccess) {
+    dbgE("Could not register external texture %jd\n", static_cast<intmax_t>(texture->id));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    textures_.erase(texture->id);
+    texture->Retire();
+    return -1;
+  }
+
+  dbgI("external texture %jd: %zux%zu, %zu buffer(s)\n", static_cast<intmax_t>(texture->id), width, height, pool_size);
+
+  return texture->id;
+}
+
+void ExternalTextureRegistry::UnregisterTexture(int64_t texture_id) {
+  std::shared_ptr<Texture> texture;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto it = textures_.find(texture_id);
+
+    if (it == textures_.end()) {
+      return;
+    }
+
+    texture = it->second;
+    textures_.erase(it);
+  }
+
+  if (FlutterEngineUnregisterExternalTexture(engine_, texture_id) != kSuccess) {
+    dbgW("Could not unregister external texture %jd\n", static_cast<intmax_t>(texture_id));
+  }
+
+  texture->Retire();
+}
+
+ExternalTextureRegistry::Buffer *ExternalTextureRegistry::AcquireBuffer(int64_t texture_id) {
+  const auto texture = Find(texture_id);
+
+  if (!texture) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(texture->mutex);
+
+  for (auto &slot : texture->slots) {
+    if (slot.state == Texture::State::kFree) {
+      slot.state = Texture::State::kProducing;
+      return &slot.buffer;
+    }
+  }
+
+  return nullptr;
+}
+
+bool ExternalTextureRegistry::SubmitBuffer(int64_t texture_id, Buffer *buffer) {
+  const auto texture = Find(texture_id);
+
+  if (!texture) {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(texture->mutex);
+
+    auto *const slot = texture->FindSlot(buffer);
+
+    if (slot == nullptr || slot->state != Texture::State::kProducing) {
+      dbgE("external texture %jd: buffer not acquired\n", static_cast<intmax_t>(texture_id));
+      return false;
+    }
+
+    texture->Queued(FlutterEngineGetCurrentTime());
+    slot->state     = Texture::State::kQueued;
+    texture->queued = slot;
+  }
+
+  return FlutterEngineMarkExternalTextureFrameAvailable(engine_, texture_id) == kSuccess;
+}
+
+void ExternalTextureRegistry::CancelBuffer(int64_t texture_id, Buffer *buffer) {
+  const auto texture = Find(texture_id);
+
+  if (!texture) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(texture->mutex);
+
+  auto *const slot = texture->FindSlot(buffer);
+
+  if (slot != nullptr && slot->state == Texture::State::kProducing) {
+    slot->state = Texture::State::kFree;
+  }
+}
+
+bool ExternalTextureRegistry::SubmitEGLImage(int64_t texture_id, EGLImage image, size_t width, size_t height, ReleaseCallback release) {
+  const auto texture = Find(texture_id);
+
+  if (!texture) {
+    if (release) {
+      release();
+    }
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(texture->mutex);
+
+    texture->Queued(FlutterEngineGetCurrentTime());
+    texture->queued_image = {image, width, height, std::move(release)};
+  }
+
+  return FlutterEngineMarkExternalTextureFrameAvailable(engine_, texture_id) == kSuccess;
+}
+
+bool ExternalTextureRegistry::Upload(Texture &texture, Buffer *buffer) {
+  gl.BindTexture(GL_TEXTURE_2D, texture.name);
+  gl.PixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  // Reuse the storage unless an EGLImage has been bound to it in the meantime.
+  if (texture.storage_is_shm_ && texture.width == buffer->width && texture.height == buffer->height) {
+    gl.TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, buffer->width, buffer->height, GL_RGBA, GL_UNSIGNED_BYTE, buffer->data);
+  } else {
+    gl.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, buffer->width, buffer->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer->data);
+    texture.width           = buffer->width;
+    texture.height          = buffer->height;
+    texture.storage_is_shm_ = true;
+  }
+
+  return true;
+}
+
+bool ExternalTextureRegistry::Populate(int64_t texture_id, size_t width, size_t height, FlutterOpenGLTexture *out) {
+  if (!ResolveGL()) {
+    dbgE("Could not resolve GL entry points for external textures\n");
+    return false;
+  }
+
+  {
+    std::vector<uint32_t> names;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      names.swap(orphaned_names_);
+    }
+
+    if (!names.empty()) {
+      gl.DeleteTextures(names.size(), names.data());
+    }
+  }
+
+  const auto texture = Find(texture_id);
+
+  if (!texture) {
+    return false;
+  }
+
+  // Keeps the buffers alive even if the texture gets unregistered in the meantime.
+  Texture::Slot *slot = nullptr;
+  Texture::Image image;
+  uint64_t queued_ns = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(texture->mutex);
+
+    if (texture->queued != nullptr) {
+      slot            = texture->queued;
+      slot->state     = Texture::State::kUploading;
+      texture->queued = nullptr;
+      queued_ns       = texture->queued_ns;
+    } else if (texture->queued_image.image != EGL_NO_IMAGE) {
+      image                 = std::move(texture->queued_image);
+      texture->queued_image = Texture::Image();
+      queued_ns             = texture->queued_ns;
+    }
+  }
+
+  if (texture->name == 0) {
+    if (slot == nullptr && image.image == EGL_NO_IMAGE) {
+      return false; // nothing to show yet
+    }
+
+    gl.GenTextures(1, &texture->name);
+    gl.BindTexture(GL_TEXTURE_2D, texture->name);
+    gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+
+  Texture::Image previous_image;
+
+  if (slot != nullptr) {
+    Upload(*texture, &slot->buffer);
+  } else if (image.image != EGL_NO_IMAGE) {
+    if (gl.EGLImageTargetTexture2DOES == nullptr) {
+      dbgE("glEGLImageTargetTexture2DOES is not available\n");
+      image.Release();
+      return false;
+    }
+
+    gl.BindTexture(GL_TEXTURE_2D, texture->name);
+    gl.EGLImageTargetTexture2DOES(GL_TEXTURE_2D, static_cast<GLeglImageOES>(image.image));
+    texture->width           = image.width;
+    texture->height          = image.height;
+    texture->storage_is_shm_ = false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(texture->mutex);
+
+    if (slot != nullptr) {
+      slot->state = Texture::State::kFree;
+      texture->stats.copied_bytes += slot->buffer.size;
+
+      // Uploading replaced whatever image was bound before.
+      previous_image       = std::move(texture->bound_image);
+      texture->bound_image = Texture::Image();
+    } else if (image.image != EGL_NO_IMAGE) {
+      previous_image       = std::move(texture->bound_image);
+      texture->bound_image = std::move(image);
+    }
+
+    if (queued_ns != 0) {
+      const uint64_t latency_ns = FlutterEngineGetCurrentTime() - queued_ns;
+
+      texture->stats.shown++;
+      texture->stats.latency_ns += latency_ns;
+      texture->stats.latency_max_ns = std::max(texture->stats.latency_max_ns, latency_ns);
+    }
+  }
+
+  previous_image.Release();
+
+  out->target               = GL_TEXTURE_2D;
+  out->name                 = texture->name;
+  out->format               = GL_RGBA8_OES;
+  out->user_data            = nullptr;
+  out->destruction_callback = nullptr; // the texture is reused for the next frames
+  out->width                = texture->width;
+  out->height               = texture->height;
+
+  return true;
+}
+
+} // namespace flutter
@@ -0,0 +1,86 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <flutter_embedder.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Textures filled by native producers (video decoders, cameras) and composited by the engine
+// (Texture widget) without going through platform channels.
+//
+// A producer registers a texture and then either:
+//  - fills CPU buffers from the per-texture pool (AcquireBuffer/SubmitBuffer), which are
+//    memfd-backed so that a decoder in another process can write them directly; the frame
+//    is copied to the GPU only once, on the raster thread, or
+//  - submits EGLImages (e.g. imported dmabufs), which are bound to the texture without any copy.
+//
+// Only the most recent frame is ever shown, older ones submitted in between are dropped.
+// All the producer methods are thread-safe, Populate() is called by the engine on the raster thread.
+class ExternalTextureRegistry {
+public:
+  // Tightly packed RGBA8888 pixels.
+  struct Buffer {
+    int fd        = -1;
+    uint8_t *data = nullptr;
+    size_t size   = 0;
+    size_t width  = 0;
+    size_t height = 0;
+    size_t stride = 0;
+  };
+
+  using ReleaseCallback = std::function<void()>;
+
+  explicit ExternalTextureRegistry(FlutterEngine engine);
+
+  ~ExternalTextureRegistry();
+
+  // Returns the texture id to be passed to the Texture widget or -1 on error.
+  int64_t RegisterTexture(size_t width, size_t height, size_t pool_size = 3);
+
+  void UnregisterTexture(int64_t texture_id);
+
+  // Returns nullptr if all the buffers are still in use (the producer is ahead of the raster thread).
+  Buffer *AcquireBuffer(int64_t texture_id);
+
+  // Queues the filled buffer and schedules a frame.
+  bool SubmitBuffer(int64_t texture_id, Buffer *buffer);
+
+  // Returns the buffer to the pool without showing it.
+  void CancelBuffer(int64_t texture_id, Buffer *buffer);
+
+  // release is called once the image is no longer referenced by the texture.
+  bool SubmitEGLImage(int64_t texture_id, EGLImage image, size_t width, size_t height, ReleaseCallback release);
+
+  // gl_external_texture_frame_callback
+  bool Populate(int64_t texture_id, size_t width, size_t height, FlutterOpenGLTexture *texture);
+
+private:
+  struct Texture;
+
+  std::shared_ptr<Texture> Find(int64_t texture_id);
+
+  bool Upload(Texture &texture, Buffer *buffer);
+
+  const FlutterEngine engine_;
+  std::mutex mutex_;
+  std::map<int64_t, std::shared_ptr<Texture>> textures_;
+  int64_t next_id_ = 1;
+  std::vector<uint32_t> orphaned_names_; // GL textures to be deleted on the raster thread
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ExternalTextureRegistry)
+};
+
+} // namespace flutter
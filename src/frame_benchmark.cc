@@ -0,0 +1,77 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+
+#include "debug.h"
+#include "frame_benchmark.h"
+
+namespace flutter {
+
+FrameBenchmark::FrameBenchmark(size_t frames, double rate_hz)
+    : frames_(frames)
+    , period_ns_(rate_hz > 0.0 ? static_cast<uint64_t>(1e9 / rate_hz) : 0) {
+  // The first present is the reference the first frame time is measured from.
+  present_ns_.reserve(frames_ + 1);
+
+  if (period_ns_ != 0) {
+    dbgI("benchmark: %zu frames, synthetic vsync at %.3f Hz\n", frames_, rate_hz);
+  } else {
+    dbgI("benchmark: %zu frames, unthrottled\n", frames_);
+  }
+}
+
+void FrameBenchmark::NextVsync(uint64_t now_ns, uint64_t vblank_ns, uint64_t *frame_start_ns, uint64_t *frame_target_ns) {
+  if (period_ns_ == 0) {
+    *frame_start_ns  = now_ns;
+    *frame_target_ns = now_ns + vblank_ns;
+    return;
+  }
+
+  // Ticks of the synthetic clock which passed while the frame was not requested are skipped, as
+  // the display would. The engine does not start the frame before frame_start_ns.
+  if (next_vsync_ns_ < now_ns) {
+    next_vsync_ns_ = next_vsync_ns_ == 0 ? now_ns : next_vsync_ns_ + (now_ns - next_vsync_ns_ + period_ns_ - 1) / period_ns_ * period_ns_;
+  }
+
+  *frame_start_ns  = next_vsync_ns_;
+  *frame_target_ns = next_vsync_ns_ + period_ns_;
+
+  next_vsync_ns_ += period_ns_;
+}
+
+bool FrameBenchmark::OnPresent(uint64_t now_ns) {
+  if (present_ns_.size() > frames_) {
+    return false;
+  }
+
+  present_ns_.push_back(now_ns);
+
+  if (present_ns_.size() <= frames_) {
+    return false;
+  }
+
+  done_.store(true, std::memory_order_release);
+
+  return true;
+}
+
+void FrameBenchmark::Report() const {
+  std::vector<uint64_t> frame_times_ns(frames_);
+
+  for (size_t i = 0; i < frames_; i++) {
+    frame_times_ns[i] = present_ns_[i + 1] - present_ns_[i];
+  }
+
+  std::sort(frame_times_ns.begin(), frame_times_ns.end());
+
+  const auto percentile = [&frame_times_ns](double p) { return frame_times_ns[std::min(frame_times_ns.size() - 1, static_cast<size_t>(p * frame_times_ns.size()))] / 1e6; };
+
+  const uint64_t duration_ns = present_ns_.back() - present_ns_.front();
+
+  dbgI("benchmark: %zu frames in %.3f s, %.2f FPS\n", frames_, duration_ns / 1e9, frames_ * 1e9 / duration_ns);
+  dbgI("benchmark: frame time min: %.3f ms, p50: %.3f ms, p90: %.3f ms, p99: %.3f ms, max: %.3f ms\n", frame_times_ns.front() / 1e6, percentile(0.50), percentile(0.90), percentile(0.99), frame_times_ns.back() / 1e6);
+}
+
+} // namespace flutter
@@ -0,0 +1,52 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Benchmark mode (see FLUTTER_WAYLAND_BENCHMARK_FRAMES) measuring the raster throughput rather than
+// the display refresh rate: the vsync requests are answered right away, or on a synthetic clock of
+// the given rate, and the buffer swaps do not wait for the compositor (eglSwapInterval(0)).
+//
+// The time between consecutive presents is collected for the given number of frames, the app has
+// to keep animating for the benchmark to complete.
+class FrameBenchmark {
+public:
+  // rate_hz 0 is unthrottled.
+  FrameBenchmark(size_t frames, double rate_hz);
+
+  // Platform thread, the frame times to pass to FlutterEngineOnVsync for a request arriving at
+  // now_ns, vblank_ns is the period of the display (used as the frame budget when unthrottled).
+  void NextVsync(uint64_t now_ns, uint64_t vblank_ns, uint64_t *frame_start_ns, uint64_t *frame_target_ns);
+
+  // Raster thread, after every buffer swap. Returns true once, when the last frame got presented.
+  bool OnPresent(uint64_t now_ns);
+
+  bool IsDone() const {
+    return done_.load(std::memory_order_acquire);
+  }
+
+  // Platform thread, once done: logs the achieved FPS and the frame time distribution.
+  void Report() const;
+
+private:
+  const size_t frames_;
+  const uint64_t period_ns_;    // of the synthetic clock, 0 if unthrottled
+  uint64_t next_vsync_ns_ = 0; // platform thread
+
+  std::vector<uint64_t> present_ns_; // raster thread, reserved upfront
+  std::atomic<bool> done_ = false;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(FrameBenchmark)
+};
+
+} // namespace flutter
@@ -0,0 +1,261 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include <errno.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <sstream>
+
+#include "debug.h"
+#include "egl_utils.h"
+#include "headless_output.h"
+
+namespace flutter {
+
+// PNG without compression (stored deflate blocks), so that no zlib/libpng is needed.
+class PngWriter {
+public:
+  static bool Write(const std::string &path, const uint8_t *rgba, uint32_t width, uint32_t height) {
+    FILE *const file = fopen(path.c_str(), "wbe");
+
+    if (file == nullptr) {
+      dbgE("headless: could not create %s (errno: %d)\n", path.c_str(), errno);
+      return false;
+    }
+
+    PngWriter png(file);
+
+    static const uint8_t kSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    fwrite(kSignature, 1, sizeof(kSignature), file);
+
+    png.BeginChunk("IHDR", 13);
+    png.Put32(width);
+    png.Put32(height);
+    png.Put({8, 6, 0, 0, 0}); // 8 bits per channel, RGBA, deflate, no filter, no interlace
+    png.EndChunk();
+
+    // A filter type byte per row, the rows split into stored blocks of at most 65535 bytes.
+    const size_t row_size  = 1 + 4 * static_cast<size_t>(width);
+    const size_t data_size = row_size * height;
+    const size_t blocks    = std::max<size_t>(1, (data_size + 65534) / 65535);
+
+    png.BeginChunk("IDAT", 2 + blocks * 5 + data_size + 4);
+    png.Put({0x78, 0x01}); // zlib header, no compression
+
+    size_t block_left = 0;
+    size_t data_left  = data_size;
+    uint32_t adler_a  = 1;
+    uint32_t adler_b  = 0;
+
+    const auto put_data = [&](const uint8_t *data, size_t size) {
+      while (size > 0) {
+        if (block_left == 0) {
+          block_left          = std::min<size_t>(data_left, 65535);
+          const uint8_t final = data_left == block_left;
+          png.Put({final, static_cast<uint8_t>(block_left), static_cast<uint8_t>(block_left >> 8), static_cast<uint8_t>(~block_left), static_cast<uint8_t>(~block_left >> 8)});
+        }
+
+        const size_t n = std::min(size, block_left);
+        png.Put(data, n);
+
+        for (size_t i = 0; i < n; i++) {
+          adler_a = (adler_a + data[i]) % 65521;
+          adler_b = (adler_b + adler_a) % 65521;
+        }
+
+        data += n;
+        size -= n;
+        block_left -= n;
+        data_left -= n;
+      }
+    };
+
+    static const uint8_t kFilterNone = 0;
+
+    for (uint32_t y = 0; y < height; y++) {
+      put_data(&kFilterNone, 1);
+      put_data(rgba + y * (row_size - 1), row_size - 1);
+    }
+
+    png.Put32((adler_b << 16) | adler_a);
+    png.EndChunk();
+
+    png.BeginChunk("IEND", 0);
+    png.EndChunk();
+
+    const bool success = !ferror(file);
+
+    if (fclose(file) != 0 || !success) {
+      dbgE("headless: could not write %s\n", path.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+private:
+  explicit PngWriter(FILE *file)
+      : file_(file) {
+    for (uint32_t n = 0; n < crc_table_.size(); n++) {
+      uint32_t c = n;
+
+      for (int k = 0; k < 8; k++) {
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      }
+
+      crc_table_[n] = c;
+    }
+  }
+
+  void BeginChunk(const char type[4], size_t size) {
+    Put32(static_cast<uint32_t>(size));
+    crc_ = 0xffffffff;
+    Put(reinterpret_cast<const uint8_t *>(type), 4);
+  }
+
+  void EndChunk() {
+    const uint32_t crc = crc_ ^ 0xffffffff;
+    Put32(crc);
+  }
+
+  void Put(const uint8_t *data, size_t size) {
+    fwrite(data, 1, size, file_);
+
+    for (size_t i = 0; i < size; i++) {
+      crc_ = crc_table_[(crc_ ^ data[i]) & 0xff] ^ (crc_ >> 8);
+    }
+  }
+
+  void Put(std::initializer_list<uint8_t> data) {
+    Put(data.begin(), data.size());
+  }
+
+  void Put32(uint32_t value) {
+    Put({static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)});
+  }
+
+  FILE *const file_;
+  std::array<uint32_t, 256> crc_table_;
+  uint32_t crc_ = 0;
+};
+
+HeadlessOutput::HeadlessOutput(const std::string &mode, const std::string &dump_frames, const std::string &dump_dir)
+    : dump_dir_(dump_dir.empty() ? "." : dump_dir) {
+  unsigned refresh_mhz = 0;
+  const int fields     = sscanf(mode.c_str(), "%dx%d@%u", &width_, &height_, &refresh_mhz);
+
+  if (fields < 2 || width_ <= 0 || height_ <= 0) {
+    dbgE("headless: invalid mode: %s (expected: <width>x<height>[@<refresh mHz>])\n", mode.c_str());
+    return;
+  }
+
+  if (fields == 3 && refresh_mhz > 0) {
+    vblank_ns_ = 1'000'000'000'000 / refresh_mhz;
+  }
+
+  std::stringstream ss(dump_frames);
+  std::string frame;
+
+  while (std::getline(ss, frame, ',')) {
+    char *end;
+    const uint64_t number = strtoull(frame.c_str(), &end, 10);
+
+    if (number == 0 || *end != '\0') {
+      dbgW("headless: invalid frame number to dump: %s\n", frame.c_str());
+      continue;
+    }
+
+    dump_frames_.push_back(number);
+  }
+
+  std::sort(dump_frames_.begin(), dump_frames_.end());
+  dump_frames_.erase(std::unique(dump_frames_.begin(), dump_frames_.end()), dump_frames_.end());
+
+  dbgI("headless: %dx%d, vblank: %.3f ms, %zu frame(s) to dump into %s\n", width_, height_, vblank_ns_ / 1e6, dump_frames_.size(), dump_dir_.c_str());
+
+  valid_ = true;
+}
+
+EGLDisplay HeadlessOutput::GetEGLDisplay() {
+  // Client extensions are queried without a display.
+  if (HasEGLExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+    const auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+    if (get_platform_display != nullptr) {
+      const EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+
+      if (display != EGL_NO_DISPLAY) {
+        dbgI("headless: using the surfaceless platform\n");
+        return display;
+      }
+    }
+  }
+
+  dbgI("headless: surfaceless platform not available, using the default EGL display\n");
+
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+EGLSurface HeadlessOutput::CreateSurface(EGLDisplay display, EGLConfig config) const {
+  const EGLint attribs[] = {EGL_WIDTH, width_, EGL_HEIGHT, height_, EGL_NONE};
+
+  return eglCreatePbufferSurface(display, config, attribs);
+}
+
+bool HeadlessOutput::OnFrameRendered() {
+  frame_++;
+
+  if (next_dump_ >= dump_frames_.size() || dump_frames_[next_dump_] != frame_) {
+    return false;
+  }
+
+  DumpFrame(frame_);
+
+  if (++next_dump_ < dump_frames_.size()) {
+    return false;
+  }
+
+  done_.store(true, std::memory_order_release);
+
+  return true;
+}
+
+bool HeadlessOutput::DumpFrame(uint64_t frame) {
+  static const auto read_pixels = reinterpret_cast<void(GL_APIENTRYP)(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void *)>(ResolveGLProc("glReadPixels"));
+
+  if (read_pixels == nullptr) {
+    return false;
+  }
+
+  const size_t stride = 4 * static_cast<size_t>(width_);
+
+  pixels_.resize(stride * height_);
+  read_pixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, pixels_.data());
+
+  // GL rows are bottom-up.
+  for (int32_t y = 0; y < height_ / 2; y++) {
+    std::swap_ranges(pixels_.begin() + y * stride, pixels_.begin() + (y + 1) * stride, pixels_.begin() + (height_ - 1 - y) * stride);
+  }
+
+  const std::string path = dump_dir_ + "/frame-" + std::to_string(frame) + ".png";
+
+  if (!PngWriter::Write(path, pixels_.data(), width_, height_)) {
+    return false;
+  }
+
+  dbgI("headless: frame %ju written into %s\n", static_cast<uintmax_t>(frame), path.c_str());
+
+  return true;
+}
+
+} // namespace flutter
@@ -0,0 +1,76 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Display backend for running without any compositor (FLUTTER_WAYLAND_HEADLESS), e.g. for visual
+// and performance tests on GPU-less CI runners. The frames are rendered into a pbuffer of the
+// Mesa surfaceless platform (llvmpipe without a GPU) or of the default EGL display, the vsync
+// follows an internal clock of the given refresh rate, and selected frames can be dumped into
+// PNG files.
+class HeadlessOutput {
+public:
+  // mode: "<width>x<height>[@<refresh mHz>]", dump_frames: comma-separated frame numbers (the first
+  // presented frame is 1), written into dump_dir as frame-<number>.png.
+  HeadlessOutput(const std::string &mode, const std::string &dump_frames, const std::string &dump_dir);
+
+  bool IsValid() const {
+    return valid_;
+  }
+
+  int32_t Width() const {
+    return width_;
+  }
+
+  int32_t Height() const {
+    return height_;
+  }
+
+  uint64_t VblankNs() const {
+    return vblank_ns_;
+  }
+
+  static EGLDisplay GetEGLDisplay();
+
+  EGLSurface CreateSurface(EGLDisplay display, EGLConfig config) const;
+
+  // Raster thread, with the frame rendered into the current surface. Returns true once, when the
+  // last frame to dump has been written.
+  bool OnFrameRendered();
+
+  // All the frames to dump have been written.
+  bool IsDone() const {
+    return done_.load(std::memory_order_acquire);
+  }
+
+private:
+  bool DumpFrame(uint64_t frame);
+
+  bool valid_         = false;
+  int32_t width_      = 0;
+  int32_t height_     = 0;
+  uint64_t vblank_ns_ = 1'000'000'000'000 / 60'000;
+
+  std::vector<uint64_t> dump_frames_; // sorted
+  const std::string dump_dir_;
+  size_t next_dump_ = 0;
+  uint64_t frame_   = 0;
+  std::vector<uint8_t> pixels_;
+  std::atomic<bool> done_ = false;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(HeadlessOutput)
+};
+
+} // namespace flutter
@@ -0,0 +1,186 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "debug.h"
+#include "input_recorder.h"
+
+namespace flutter {
+
+static constexpr char kMagic[4]    = {'F', 'L', 'W', 'I'};
+static constexpr uint32_t kVersion = 1;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(InputEvent) == 32, "the records are written as they are");
+
+InputRecorder::InputRecorder(const std::string &path)
+    : path_(path) {
+  fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd_ == -1) {
+    dbgE("input: could not create %s (errno: %d)\n", path_.c_str(), errno);
+    return;
+  }
+
+  FileHeader header = {.magic = {}, .version = kVersion, .record_size = sizeof(InputEvent), .reserved = 0};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+
+  if (write(fd_, &header, sizeof(header)) != sizeof(header)) {
+    dbgE("input: could not write %s (errno: %d)\n", path_.c_str(), errno);
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+
+  dbgI("input: recording into %s\n", path_.c_str());
+}
+
+InputRecorder::~InputRecorder() {
+  if (fd_ != -1) {
+    close(fd_);
+    dbgI("input: %ju event(s) recorded into %s\n", static_cast<uintmax_t>(events_), path_.c_str());
+  }
+}
+
+void InputRecorder::Start(uint64_t now_ns) {
+  start_ns_ = now_ns;
+}
+
+void InputRecorder::Record(const InputEvent &event, uint64_t now_ns) {
+  if (fd_ == -1 || start_ns_ == 0) {
+    return;
+  }
+
+  InputEvent record = event;
+  record.offset_ns  = now_ns - start_ns_;
+
+  if (write(fd_, &record, sizeof(record)) != sizeof(record)) {
+    dbgE("input: could not write %s (errno: %d), recording stopped\n", path_.c_str(), errno);
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+
+  events_++;
+}
+
+InputReplayer::InputReplayer(const std::string &path, double speed, uint64_t linger_ns)
+    : speed_(speed)
+    , linger_ns_(linger_ns) {
+  std::ifstream file(path, std::ios::binary);
+  FileHeader header;
+
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    dbgE("input: could not read %s\n", path.c_str());
+    return;
+  }
+
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.record_size != sizeof(InputEvent)) {
+    dbgE("input: %s is not an input recording (or of an unsupported version)\n", path.c_str());
+    return;
+  }
+
+  InputEvent event;
+
+  while (file.read(reinterpret_cast<char *>(&event), sizeof(event))) {
+    events_.push_back(event);
+  }
+
+  if (file.gcount() != 0) {
+    dbgW("input: %s: truncated record ignored\n", path.c_str());
+  }
+
+  valid_ = true;
+
+  dbgI("input: replaying %zu event(s) from %s, speed: %g\n", events_.size(), path.c_str(), speed_);
+}
+
+void InputReplayer::Start(uint64_t now_ns, uint32_t now_ms) {
+  start_ns_ = now_ns;
+
+  if (!events_.empty()) {
+    time_delta_ = now_ms - events_.front().time;
+  }
+}
+
+uint64_t InputReplayer::DueNs(const InputEvent &event) const {
+  return start_ns_ + static_cast<uint64_t>(event.offset_ns / speed_);
+}
+
+uint64_t InputReplayer::DispatchDue(uint64_t now_ns, const std::function<void(const InputEvent &)> &dispatch) {
+  if (finished_ || start_ns_ == 0) {
+    return 0;
+  }
+
+  // As fast as possible is still one event per event loop iteration, so that the events do not get
+  // all handled before the very first frame.
+  const size_t last = speed_ > 0.0 ? events_.size() : std::min(next_ + 1, events_.size());
+
+  for (; next_ < last && (speed_ <= 0.0 || DueNs(events_[next_]) <= now_ns); next_++) {
+    InputEvent event = events_[next_];
+    event.time += time_delta_;
+    dispatch(event);
+  }
+
+  if (next_ < events_.size()) {
+    return speed_ > 0.0 ? DueNs(events_[next_]) : now_ns;
+  }
+
+  if (end_ns_ == 0) {
+    end_ns_ = now_ns;
+  }
+
+  if (now_ns < end_ns_ + linger_ns_) {
+    return end_ns_ + linger_ns_;
+  }
+
+  Report(now_ns);
+  finished_ = true;
+
+  return 0;
+}
+
+void InputReplayer::OnFramePresented(uint64_t interval_ns, uint64_t refresh_ns) {
+  if (finished_ || start_ns_ == 0 || interval_ns > kIdleIntervalNs) {
+    return;
+  }
+
+  frame_intervals_ns_.push_back(interval_ns);
+
+  if (interval_ns * 2 > refresh_ns * 3) {
+    janky_frames_++;
+  }
+}
+
+void InputReplayer::Report(uint64_t now_ns) const {
+  dbgI("input: replay of %zu event(s) done in %.3f s (last event at %.3f s)\n", events_.size(), (now_ns - start_ns_) / 1e9, (end_ns_ - start_ns_) / 1e9);
+
+  if (frame_intervals_ns_.empty()) {
+    dbgI("input: no frames presented during the replay\n");
+    return;
+  }
+
+  auto intervals = frame_intervals_ns_;
+  std::sort(intervals.begin(), intervals.end());
+
+  const auto percentile = [&intervals](double p) { return intervals[std::min(intervals.size() - 1, static_cast<size_t>(p * intervals.size()))] / 1e6; };
+
+  dbgI("input: %zu frame(s), interval p50: %.3f ms, p90: %.3f ms, p99: %.3f ms, max: %.3f ms, janky: %ju (%.1f%%)\n", intervals.size(), percentile(0.50), percentile(0.90), percentile(0.99), intervals.back() / 1e6,
+       static_cast<uintmax_t>(janky_frames_), 100.0 * janky_frames_ / intervals.size());
+}
+
+} // namespace flutter
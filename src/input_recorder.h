@@ -0,0 +1,108 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A keyboard or pointer event as dispatched by the Wayland listeners.
+struct InputEvent {
+  enum Type : uint32_t {
+    kPointerLeave = 1,
+    kPointerMotion, // args: surface_x, surface_y (wl_fixed_t)
+    kPointerButton, // args: button, state
+    kKey,           // args: key, state
+    kKeyModifiers,  // args: mods_depressed, mods_latched, mods_locked, group
+  };
+
+  uint64_t offset_ns = 0; // since the start of the session
+  uint32_t type      = 0;
+  uint32_t time      = 0; // Wayland timestamp [ms]
+  uint32_t args[4]   = {};
+};
+
+// Writes the input events of a session into a file: a header followed by fixed size records,
+// see InputEvent. Each event is written right away, so a crash does not lose the session.
+class InputRecorder {
+public:
+  explicit InputRecorder(const std::string &path);
+
+  ~InputRecorder();
+
+  bool IsValid() const {
+    return fd_ != -1;
+  }
+
+  // The event offsets are relative to this.
+  void Start(uint64_t now_ns);
+
+  void Record(const InputEvent &event, uint64_t now_ns);
+
+private:
+  const std::string path_;
+  int fd_            = -1;
+  uint64_t start_ns_ = 0;
+  uint64_t events_   = 0;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(InputRecorder)
+};
+
+// Feeds a recorded session back, at its original timing scaled by speed or, with speed 0,
+// one event per event loop iteration (as fast as possible, while still letting frames through).
+// Also collects the frame intervals from the start of the replay until linger_ns after its
+// last event and then reports them, so that the jank of different builds can be compared
+// for the same input.
+class InputReplayer {
+public:
+  InputReplayer(const std::string &path, double speed, uint64_t linger_ns);
+
+  bool IsValid() const {
+    return valid_;
+  }
+
+  // Reported, no more events nor frames.
+  bool IsFinished() const {
+    return finished_;
+  }
+
+  void Start(uint64_t now_ns, uint32_t now_ms);
+
+  // Dispatches the due events (with their Wayland timestamps rebased to the start of the replay),
+  // returns when it should be called again (0 once finished).
+  uint64_t DispatchDue(uint64_t now_ns, const std::function<void(const InputEvent &)> &dispatch);
+
+  void OnFramePresented(uint64_t interval_ns, uint64_t refresh_ns);
+
+private:
+  // Longer intervals between the presented frames are idle periods rather than slow frames.
+  static constexpr uint64_t kIdleIntervalNs = 250'000'000;
+
+  uint64_t DueNs(const InputEvent &event) const;
+
+  void Report(uint64_t now_ns) const;
+
+  const double speed_;
+  const uint64_t linger_ns_;
+  std::vector<InputEvent> events_;
+  size_t next_         = 0;
+  bool valid_          = false;
+  bool finished_       = false;
+  uint64_t start_ns_   = 0; // 0 until started
+  uint32_t time_delta_ = 0; // added to the recorded Wayland timestamps
+  uint64_t end_ns_     = 0; // when the last event was dispatched
+
+  std::vector<uint64_t> frame_intervals_ns_;
+  uint64_t janky_frames_ = 0; // presented later than 1.5 refresh periods after the previous one
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(InputReplayer)
+};
+
+} // namespace flutter
@@ -9,7 +9,9 @@
 
 #include "utils.h"
 #include "debug.h"
+#include "startup_trace.h"
 #include "wayland_display.h"
+#include "zygote.h"
 
 static_assert(FLUTTER_ENGINE_VERSION == 1, "");
 
@@ -47,10 +49,29 @@ Supported environment variables:
  
      FLUTTER_WAYLAND_PIXEL_RATIO=<double>
                    Overwrites the pixel aspect ratio reported
-                   to the engine by FlutterEngineSendWindowMetricsEvent().
+                   to the engine by FlutterEngineSendWindowMetricsEvent()
+                   (defaults to the scale factor of the output).
 
                    See also: https://api.flutter.dev/flutter/dart-ui/Window/devicePixelRatio.html
 
+     FLUTTER_WAYLAND_RENDER_SCALE=<double>
+                   Value in the (0, 1] range (default: 1.0). Renders at the reduced internal
+                   resolution (e.g. 0.5 renders 1920x1080 output at 960x540) and lets the
+                   compositor upscale it to the full output size using wp_viewporter.
+                   The logical size of the UI is preserved. Ignored if the compositor does not
+                   support wp_viewporter.
+
+     FLUTTER_WAYLAND_DYNAMIC_RESOLUTION=<int>
+                   Non-zero value enables the dynamic resolution scaling: the render scale is
+                   stepped down (to FLUTTER_WAYLAND_MIN_RENDER_SCALE at most, default: 0.5) when
+                   frames miss their vblanks and back up (to FLUTTER_WAYLAND_RENDER_SCALE) once
+                   there is enough headroom again. Requires wp_viewporter and presentation-time.
+
+     FLUTTER_WAYLAND_OUTPUT_WAIT_MS=<int>
+                   Maximum time (in milliseconds, default: 500) to wait during startup for the compositor
+                   to advertise the output mode, so the first frame is rendered at the actual output size.
+                   If it does not arrive in time, 1920x1080 is assumed until it does.
+
      FLUTTER_WAYLAND_MAIN_UI=<int>
                    Non-zero value enables grabbing all keys (even without having
                    a focus) using Xwayland keyboard grabbing protocol (assuming 
@@ -58,6 +79,84 @@ Supported environment variables:
 
                    See also: https://github.com/wayland-project/wayland-protocols/tree/0a61d3516b10da4e65607a6dd97937ebedf6bcfa/unstable/xwayland-keyboard-grab
 
+     FLUTTER_WAYLAND_OPAQUE=<int>
+                   Non-zero value selects an EGL config without alpha channel and declares the
+                   whole surface opaque, so the compositor does not need to blend it. Defaults
+                   to the value of FLUTTER_WAYLAND_MAIN_UI.
+
+     FLUTTER_WAYLAND_PIXEL_FORMAT=<string>
+                   Window surface pixel format: "argb8888", "xrgb8888" or "rgb565". Defaults to
+                   "xrgb8888" if FLUTTER_WAYLAND_OPAQUE is enabled, "argb8888" otherwise. Formats
+                   without alpha imply FLUTTER_WAYLAND_OPAQUE, with "argb8888" and
+                   FLUTTER_WAYLAND_OPAQUE the surface is still declared opaque.
+
+     FLUTTER_WAYLAND_STENCIL_SIZE=<int>
+                   Minimum stencil buffer size in bits (default: 0).
+
+     FLUTTER_WAYLAND_MSAA_SAMPLES=<int>
+                   Minimum number of multisampling samples of the window surface (default: 0).
+
+     FLUTTER_WAYLAND_RESOURCE_CONTEXTS=<int>
+                   Number of EGL contexts (0-4, default: 1) shared with the onscreen context which
+                   the engine uses to upload textures off the raster thread. 0 disables them.
+
+     FLUTTER_WAYLAND_CHANNEL_WORKERS=<int>
+                   Number of threads (0-16, default: 2) running the native platform channel
+                   handlers which are not cheap enough to be run on the platform thread.
+
+     FLUTTER_WAYLAND_SHARED_BLOB_POOL_MB=<int>
+                   Size of the memfd-backed pool (default: 64, 0 disables it) of the bulk data
+                   blobs shared with Dart through FFI (flutter_wayland_blob_acquire/release).
+
+     FLUTTER_WAYLAND_DART_PORT_BATCHING=<int>
+                   Non-zero value (default) batches the native events posted to Dart ports
+                   (flutter_wayland/dart_ports channel) and delivers them once per frame.
+
+     FLUTTER_WAYLAND_PLUGIN_PATH=<string>
+                   Directory with the native plugin manifests (*.plugin, see plugin_api.h).
+                   A plugin library is loaded only when its first channel message arrives.
+
+     FLUTTER_WAYLAND_INPUT_RECORD=<string>
+                   Records the keyboard and pointer events of the session into this file.
+
+     FLUTTER_WAYLAND_INPUT_REPLAY=<string>
+                   Replays a recorded session (the live input is ignored meanwhile) and logs
+                   the frame intervals (p50/p90/p99/max, janky frames) measured during it.
+
+     FLUTTER_WAYLAND_INPUT_REPLAY_SPEED=<double>
+                   1.0 replays on the original timing (default), 0 as fast as possible.
+
+     FLUTTER_WAYLAND_INPUT_REPLAY_EXIT=<double>
+                   if > 0, keeps measuring for this many seconds after the last replayed event, then exits.
+
+     FLUTTER_WAYLAND_BENCHMARK_FRAMES=<int>
+                   if > 0, measures the raster throughput instead of following the display: vsync requests
+                   are answered right away, the buffer swaps do not wait for the compositor (eglSwapInterval(0)),
+                   and after this many frames the achieved FPS and the frame time distribution are logged
+                   and the launcher exits. The app has to keep animating.
+
+     FLUTTER_WAYLAND_BENCHMARK_RATE=<double>
+                   Rate [Hz] of the synthetic vsync clock of the benchmark mode (default: 0, unthrottled).
+
+     FLUTTER_WAYLAND_HEADLESS=<string>
+                   "<width>x<height>[@<refresh mHz>]" (e.g. "1280x720@60000"): runs without any Wayland compositor,
+                   rendering into an EGL pbuffer (of the Mesa surfaceless platform if available, which uses llvmpipe
+                   without a GPU, e.g. with LIBGL_ALWAYS_SOFTWARE=1) and with the vsync driven by an internal clock.
+
+     FLUTTER_WAYLAND_HEADLESS_DUMP_FRAMES=<string>
+                   Comma-separated numbers of the frames (the first one is 1) to write as PNG files into
+                   FLUTTER_WAYLAND_HEADLESS_DUMP_DIR (default: the current directory) as frame-<number>.png.
+                   The launcher exits once the last one is written.
+
+     FLUTTER_WAYLAND_TASK_BUDGET_US=<int>
+                   Time budget (default: 4000) of the platform tasks run in a row: the remaining ones wait
+                   for the pending vsync and input to be handled. 0 runs all the expired tasks at once.
+                   Housekeeping (e.g. the memory watcher) runs only after the expired engine tasks.
+
+     FLUTTER_WAYLAND_SLOW_TASK_MS=<double>
+                   if > 0, logs every platform task running longer than this. The lateness and duration
+                   of the platform tasks are summarized in the log at exit (and exported as metrics).
+
      FLUTTER_LAUNCHER_WAYLAND_DEBUG=<string>
                    where <string> can be any of syslog(3) prioritynames or its
                    unique abbreviation e.g. "err", "warning", "info" or "debug".
@@ -72,12 +171,37 @@ Supported environment variables:
                    "1000000,70000000,148478361,167038156,176318054"
                    At least one memory level needs to be defined for memory watcher to work. After each notification, there is 20sec cooldown period,
                    when additional FlutterEngineNotifyLowMemoryWarning notifications will not be called.
+
+     FLUTTER_LAUNCHER_WAYLAND_ZYGOTE_SOCKET=<string>
+                   if defined and no <asset_bundle_path> is given, the launcher pre-warms itself (engine library,
+                   ICU data) and waits for launch requests on the SOCK_SEQPACKET unix socket at this path, forking
+                   a child per request. A request is a single packet of NUL-separated arguments:
+                   "<asset_bundle_path>\0<flutter_flags>..."; the reply is the decimal pid of the launched child.
+                   Compare the "time to first presented frame" logged by the children with the one of a cold start.
+
+     FLUTTER_LAUNCHER_WAYLAND_METRICS_SOCKET=<string>
+                   if defined, runtime counters (frames, vsync latency, platform task lateness, duration and queue depth, input events and latency,
+                   memory watcher, log drops) are served in the Prometheus text format on a unix socket at this path,
+                   e.g.: curl --unix-socket <string> http://localhost/metrics
 )~" << std::endl;
 }
 
 static bool Main(std::vector<std::string> args) {
   dbg_init();
 
+  // Startup phases are reported relative to the process start (or to the launch request in zygote mode).
+  StartupTrace::Instance().SetOriginToProcessStart();
+
+  const auto zygote_socket_path = getEnv("FLUTTER_LAUNCHER_WAYLAND_ZYGOTE_SOCKET", std::string(""));
+
+  if (!zygote_socket_path.empty() && args.size() == 1) {
+    // Returns only in the forked child, with the arguments of the launch request.
+    if (!RunZygote(zygote_socket_path, args)) {
+      dbgE("Zygote mode failed\n");
+      return false;
+    }
+  }
+
   if (args.size() == 1) {
     dbgE("Invalid list of arguments\n");
     PrintUsage();
@@ -92,6 +216,7 @@ static bool Main(std::vector<std::string> args) {
     return false;
   }
 
+  // Used only if the compositor does not advertise the output mode in time.
   const size_t kWidth  = 1920;
   const size_t kHeight = 1080;
 
@@ -0,0 +1,284 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "debug.h"
+#include "metrics.h"
+
+namespace flutter {
+
+void MetricsHistogram::Observe(uint64_t ns) {
+  const auto it = std::lower_bound(kBoundsNs.begin(), kBoundsNs.end(), ns);
+
+  counts_[it - kBoundsNs.begin()].fetch_add(1, std::memory_order_relaxed);
+  sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+uint64_t MetricsHistogram::CumulativeCount(size_t i) const {
+  uint64_t count = 0;
+
+  for (size_t j = 0; j <= i; j++) {
+    count += counts_[j].load(std::memory_order_relaxed);
+  }
+
+  return count;
+}
+
+uint64_t MetricsHistogram::QuantileNs(double q) const {
+  const uint64_t count = CumulativeCount(kBoundsNs.size());
+
+  if (count == 0) {
+    return 0;
+  }
+
+  const auto rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+
+  for (size_t i = 0; i < kBoundsNs.size(); i++) {
+    if (CumulativeCount(i) >= rank) {
+      return kBoundsNs[i];
+    }
+  }
+
+  return UINT64_MAX;
+}
+
+void MetricsSizeHistogram::Observe(uint64_t value) {
+  const auto it = std::lower_bound(kBounds.begin(), kBounds.end(), value);
+
+  counts_[it - kBounds.begin()].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t MetricsSizeHistogram::CumulativeCount(size_t i) const {
+  uint64_t count = 0;
+
+  for (size_t j = 0; j <= i; j++) {
+    count += counts_[j].load(std::memory_order_relaxed);
+  }
+
+  return count;
+}
+
+Metrics &Metrics::Instance() {
+  static Metrics metrics;
+  return metrics;
+}
+
+MetricsServer::MetricsServer(const std::string &socket_path)
+    : socket_path_(socket_path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX, .sun_path = {}};
+
+  if (socket_path_.size() >= sizeof(addr.sun_path)) {
+    dbgE("metrics: socket path too long: %s\n", socket_path_.c_str());
+    return;
+  }
+
+  strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+
+  fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if (fd_ == -1) {
+    dbgE("metrics: socket failed (errno: %d)\n", errno);
+    return;
+  }
+
+  // A stale socket of a previous instance would make bind() fail.
+  unlink(socket_path_.c_str());
+
+  if (bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 || listen(fd_, 4) == -1) {
+    dbgE("metrics: could not listen on %s (errno: %d)\n", socket_path_.c_str(), errno);
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+
+  dbgI("metrics: serving on %s\n", socket_path_.c_str());
+}
+
+MetricsServer::~MetricsServer() {
+  for (const auto &client : clients_) {
+    close(client->fd);
+  }
+
+  if (fd_ != -1) {
+    close(fd_);
+    unlink(socket_path_.c_str());
+  }
+}
+
+void MetricsServer::HandleConnections(Reactor &reactor) {
+  int fd;
+
+  while ((fd = accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+    if (clients_.size() >= kMaxClients) {
+      dbgW("metrics: too many clients, dropping the oldest one\n");
+      CloseClient(reactor, clients_.front().get());
+    }
+
+    const size_t size = Render();
+
+    auto client      = std::make_unique<Client>();
+    client->fd       = fd;
+    client->response = std::string(buffer_.data(), size);
+
+    Client *const served = client.get();
+
+    // Edge triggered: the handler runs again once the client sent more or the socket has room for more.
+    if (!reactor.Add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, [this, &reactor, served](uint32_t events) { ServeClient(reactor, served, events); }, Reactor::Trigger::kEdge)) {
+      close(fd);
+      continue;
+    }
+
+    clients_.push_back(std::move(client));
+  }
+
+  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+    dbgW("metrics: accept failed (errno: %d)\n", errno);
+  }
+}
+
+void MetricsServer::ServeClient(Reactor &reactor, Client *client, uint32_t events) {
+  if (events & EPOLLERR) {
+    CloseClient(reactor, client);
+    return;
+  }
+
+  while (client->sent < client->response.size()) {
+    const ssize_t rv = send(client->fd, client->response.data() + client->sent, client->response.size() - client->sent, MSG_NOSIGNAL);
+
+    if (rv == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+
+      dbgW("metrics: could not send the response (errno: %d)\n", errno);
+      CloseClient(reactor, client);
+      return;
+    }
+
+    client->sent += rv;
+
+    if (client->sent == client->response.size()) {
+      shutdown(client->fd, SHUT_WR);
+    }
+  }
+
+  // The request itself is irrelevant, every request gets the metrics.
+  char request[512];
+  ssize_t rv;
+
+  while ((rv = read(client->fd, request, sizeof(request))) > 0 || (rv == -1 && errno == EINTR)) {
+  }
+
+  if (rv == 0 || (rv == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    if (client->sent < client->response.size()) {
+      dbgW("metrics: client left after %zu/%zu bytes of the response\n", client->sent, client->response.size());
+    }
+    CloseClient(reactor, client);
+  }
+}
+
+void MetricsServer::CloseClient(Reactor &reactor, Client *client) {
+  reactor.Remove(client->fd);
+  close(client->fd);
+
+  clients_.erase(std::find_if(clients_.begin(), clients_.end(), [client](const std::unique_ptr<Client> &c) { return c.get() == client; }));
+}
+
+void MetricsServer::Append(const char *format, ...) {
+  if (overflow_) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, format);
+  const int rv = std::vsnprintf(buffer_.data() + size_, buffer_.size() - size_, format, args);
+  va_end(args);
+
+  if (rv < 0 || static_cast<size_t>(rv) >= buffer_.size() - size_) {
+    overflow_ = true;
+    return;
+  }
+
+  size_ += rv;
+}
+
+void MetricsServer::AppendCounter(const char *name, const char *help, uint64_t value) {
+  Append("# HELP %s %s\n# TYPE %s counter\n%s %ju\n", name, help, name, name, static_cast<uintmax_t>(value));
+}
+
+void MetricsServer::AppendGauge(const char *name, const char *help, int64_t value) {
+  Append("# HELP %s %s\n# TYPE %s gauge\n%s %jd\n", name, help, name, name, static_cast<intmax_t>(value));
+}
+
+void MetricsServer::AppendHistogram(const char *name, const char *help, const MetricsHistogram &histogram) {
+  Append("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+  for (size_t i = 0; i < MetricsHistogram::kBoundsNs.size(); i++) {
+    Append("%s_bucket{le=\"%g\"} %ju\n", name, MetricsHistogram::kBoundsNs[i] / 1e9, static_cast<uintmax_t>(histogram.CumulativeCount(i)));
+  }
+
+  const uint64_t count = histogram.CumulativeCount(MetricsHistogram::kBoundsNs.size());
+
+  Append("%s_bucket{le=\"+Inf\"} %ju\n%s_sum %.9f\n%s_count %ju\n", name, static_cast<uintmax_t>(count), name, histogram.SumNs() / 1e9, name, static_cast<uintmax_t>(count));
+}
+
+void MetricsServer::AppendHistogram(const char *name, const char *help, const MetricsSizeHistogram &histogram) {
+  Append("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+  for (size_t i = 0; i < MetricsSizeHistogram::kBounds.size(); i++) {
+    Append("%s_bucket{le=\"%ju\"} %ju\n", name, static_cast<uintmax_t>(MetricsSizeHistogram::kBounds[i]), static_cast<uintmax_t>(histogram.CumulativeCount(i)));
+  }
+
+  const uint64_t count = histogram.CumulativeCount(MetricsSizeHistogram::kBounds.size());
+
+  Append("%s_bucket{le=\"+Inf\"} %ju\n%s_sum %ju\n%s_count %ju\n", name, static_cast<uintmax_t>(count), name, static_cast<uintmax_t>(histogram.Sum()), name, static_cast<uintmax_t>(count));
+}
+
+size_t MetricsServer::Render() {
+  const Metrics &m = Metrics::Instance();
+
+  size_     = 0;
+  overflow_ = false;
+
+  Append("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+
+  AppendCounter("flutter_wayland_frames_requested_total", "Vsync requests from the engine.", m.frames_requested.Value());
+  AppendCounter("flutter_wayland_frames_presented_total", "Frames reported as presented by the compositor.", m.frames_presented.Value());
+  AppendCounter("flutter_wayland_frames_discarded_total", "Frames reported as discarded by the compositor.", m.frames_discarded.Value());
+  AppendHistogram("flutter_wayland_vsync_latency_seconds", "Time from the vsync request to FlutterEngineOnVsync.", m.vsync_latency);
+  AppendGauge("flutter_wayland_platform_task_queue_depth", "Platform tasks queued when the expired ones were last collected.", m.platform_task_queue_depth.Value());
+  AppendHistogram("flutter_wayland_platform_task_lateness_seconds", "Delay between the target time of a platform task and its execution.", m.platform_task_lateness);
+  AppendHistogram("flutter_wayland_platform_task_duration_seconds", "Time a platform task took to run.", m.platform_task_duration);
+  AppendHistogram("flutter_wayland_platform_task_post_depth", "Platform tasks queued when a task was posted, including it.", m.platform_task_post_depth);
+  AppendCounter("flutter_wayland_platform_tasks_slow_total", "Platform tasks over the slow task threshold.", m.platform_tasks_slow.Value());
+  AppendCounter("flutter_wayland_input_key_events_total", "Key events sent to the engine.", m.input_key_events.Value());
+  AppendCounter("flutter_wayland_input_pointer_events_total", "Pointer events sent to the engine.", m.input_pointer_events.Value());
+  AppendHistogram("flutter_wayland_input_latency_seconds", "Time from the timestamp of a key or button event to sending it to the engine.", m.input_latency);
+  AppendGauge("flutter_wayland_memory_watcher_level", "Memory watermark level reached.", m.memory_watcher_level.Value());
+  AppendCounter("flutter_wayland_memory_warnings_sent_total", "Low memory warnings sent to the engine.", m.memory_warnings_sent.Value());
+  AppendCounter("flutter_wayland_log_messages_total", "Log messages written.", m.log_messages.Value());
+  AppendCounter("flutter_wayland_log_drops_total", "Log messages lost.", m.log_drops.Value());
+
+  if (overflow_) {
+    dbgW("metrics: response truncated to %zu bytes\n", size_);
+  }
+
+  return size_;
+}
+
+} // namespace flutter
@@ -0,0 +1,181 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+#include "reactor.h"
+
+namespace flutter {
+
+class MetricsCounter {
+public:
+  void Add(uint64_t n = 1) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  uint64_t Value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint64_t> value_ = 0;
+};
+
+class MetricsGauge {
+public:
+  void Set(int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  int64_t Value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> value_ = 0;
+};
+
+// Durations in fixed, roughly logarithmic buckets (50us .. 1s), exported in seconds.
+class MetricsHistogram {
+public:
+  static constexpr std::array<uint64_t, 14> kBoundsNs = {
+      50'000, 100'000, 250'000, 500'000, 1'000'000, 2'500'000, 5'000'000, 10'000'000, 16'666'667, 25'000'000, 50'000'000, 100'000'000, 250'000'000, 1'000'000'000,
+  };
+
+  void Observe(uint64_t ns);
+
+  // Cumulative count of the observations <= kBoundsNs[i] (i == kBoundsNs.size() for +Inf).
+  uint64_t CumulativeCount(size_t i) const;
+
+  uint64_t SumNs() const {
+    return sum_ns_.load(std::memory_order_relaxed);
+  }
+
+  // Upper bound of the bucket holding the q-quantile (UINT64_MAX for +Inf, 0 if empty).
+  uint64_t QuantileNs(double q) const;
+
+private:
+  std::array<std::atomic<uint64_t>, kBoundsNs.size() + 1> counts_ = {};
+  std::atomic<uint64_t> sum_ns_                                  = 0;
+};
+
+// Sizes (e.g. queue depths) in power of two buckets (1 .. 1024).
+class MetricsSizeHistogram {
+public:
+  static constexpr std::array<uint64_t, 11> kBounds = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
+
+  void Observe(uint64_t value);
+
+  // Cumulative count of the observations <= kBounds[i] (i == kBounds.size() for +Inf).
+  uint64_t CumulativeCount(size_t i) const;
+
+  uint64_t Sum() const {
+    return sum_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, kBounds.size() + 1> counts_ = {};
+  std::atomic<uint64_t> sum_                                   = 0;
+};
+
+// Process wide runtime counters, updated lock-free from any thread.
+struct Metrics {
+  static Metrics &Instance();
+
+  MetricsCounter frames_requested; // vsync callbacks from the engine
+  MetricsCounter frames_presented;
+  MetricsCounter frames_discarded;
+  MetricsHistogram vsync_latency; // vsync callback -> FlutterEngineOnVsync
+
+  MetricsGauge platform_task_queue_depth; // when the expired tasks were last collected
+  MetricsHistogram platform_task_lateness; // run time - target time
+  MetricsHistogram platform_task_duration;
+  MetricsSizeHistogram platform_task_post_depth; // queued tasks, including the posted one
+  MetricsCounter platform_tasks_slow;            // over FLUTTER_WAYLAND_SLOW_TASK_MS
+
+  MetricsCounter input_key_events;
+  MetricsCounter input_pointer_events;
+  MetricsHistogram input_latency; // key and button event timestamp -> sent to the engine, ms resolution
+
+  MetricsGauge memory_watcher_level;
+  MetricsCounter memory_warnings_sent;
+
+  MetricsCounter log_messages;
+  MetricsCounter log_drops; // formatting or stdout write failures
+};
+
+// Serves Metrics::Instance() in the Prometheus text format (over HTTP/1.0, so that
+// `curl --unix-socket <path> http://localhost/metrics` works) on a unix domain socket.
+// There is no thread of its own: fd() is polled by the owner, which calls
+// HandleConnections() when it becomes readable. The metrics are rendered into a fixed buffer,
+// each connection then allocates its Client and a copy of the response, since several of them
+// may be served concurrently (a scrape every few seconds, so not on any hot path).
+class MetricsServer {
+public:
+  explicit MetricsServer(const std::string &socket_path);
+
+  ~MetricsServer();
+
+  bool IsValid() const {
+    return fd_ != -1;
+  }
+
+  int fd() const {
+    return fd_;
+  }
+
+  // Accepts the pending connections and registers them with reactor, which serves them without
+  // blocking: each client gets the metrics rendered when it connected.
+  void HandleConnections(Reactor &reactor);
+
+private:
+  // The oldest client is dropped when a new one would exceed it, so silent clients can't pile up.
+  static constexpr size_t kMaxClients = 8;
+
+  struct Client {
+    int fd = -1;
+    std::string response;
+    size_t sent = 0;
+  };
+
+  // Sends what the socket accepts of the response, then drains the request until the client
+  // closes the connection (closing it with unread data would reset it before the response is read).
+  void ServeClient(Reactor &reactor, Client *client, uint32_t events);
+
+  void CloseClient(Reactor &reactor, Client *client);
+
+  void Append(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  void AppendCounter(const char *name, const char *help, uint64_t value);
+
+  void AppendGauge(const char *name, const char *help, int64_t value);
+
+  void AppendHistogram(const char *name, const char *help, const MetricsHistogram &histogram);
+
+  void AppendHistogram(const char *name, const char *help, const MetricsSizeHistogram &histogram);
+
+  // Renders the response into buffer_, returns its size.
+  size_t Render();
+
+  const std::string socket_path_;
+  int fd_ = -1;
+
+  std::vector<std::unique_ptr<Client>> clients_;
+
+  std::array<char, 16384> buffer_;
+  size_t size_   = 0;
+  bool overflow_ = false;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(MetricsServer)
+};
+
+} // namespace flutter
@@ -0,0 +1,57 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Public C interface of the native plugins loaded by flutter-launcher-wayland.
+//
+// A plugin is a shared object accompanied by a manifest (<name>.plugin) in the plugin directory
+// (FLUTTER_WAYLAND_PLUGIN_PATH):
+//
+//   library=libmy_plugin.so          # relative to the plugin directory
+//   channels=my/channel,my/other     # platform channels claimed by the plugin
+//   init=my_plugin_init              # optional, defaults to flutter_wayland_plugin_init
+//   thread=worker                    # optional, handlers run on the platform thread by default
+//
+// The library is loaded only when the first message for any of its channels arrives, at which
+// point its init function is called and expected to set the handlers of the claimed channels.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLUTTER_WAYLAND_PLUGIN_API_VERSION 1
+
+typedef struct FlutterWaylandResponder FlutterWaylandResponder;
+
+// responder has to be passed to respond() exactly once, from any thread.
+typedef void (*FlutterWaylandMessageHandler)(void *user_data, const char *channel, const uint8_t *message, size_t message_size, FlutterWaylandResponder *responder);
+
+// Every plugin gets its own instance, host identifies the plugin in the calls.
+typedef struct {
+  uint32_t version; // FLUTTER_WAYLAND_PLUGIN_API_VERSION
+  void *host;
+
+  // Only the channels claimed in the manifest of the calling plugin can be handled.
+  bool (*set_message_handler)(void *host, const char *channel, FlutterWaylandMessageHandler handler, void *user_data);
+
+  // An empty reply (NULL, 0) means the message is not implemented.
+  void (*respond)(FlutterWaylandResponder *responder, const uint8_t *data, size_t size);
+
+  // Fire and forget message to Dart, can be called from any thread: the engine accepts messages
+  // on the platform thread only, so from the other threads the message is copied and sent from
+  // there later (then true means it was queued, not sent).
+  bool (*send)(void *host, const char *channel, const uint8_t *message, size_t message_size);
+} FlutterWaylandPluginHostApi;
+
+// Returns false if the plugin could not be initialized. api stays valid for the process lifetime.
+typedef bool (*FlutterWaylandPluginInit)(const FlutterWaylandPluginHostApi *api);
+
+#ifdef __cplusplus
+}
+#endif
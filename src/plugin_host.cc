@@ -0,0 +1,255 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <dirent.h>
+#include <dlfcn.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "debug.h"
+#include "plugin_host.h"
+
+struct FlutterWaylandResponder {
+  flutter::ChannelDispatcher::Responder responder;
+};
+
+namespace flutter {
+
+static const std::string kManifestSuffix = ".plugin";
+
+static std::string Trim(const std::string &s) {
+  const auto begin = s.find_first_not_of(" \t\r");
+
+  if (begin == std::string::npos) {
+    return "";
+  }
+
+  return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+PluginHost::PluginHost(ChannelDispatcher &channels, PlatformEventLoop &platform_loop)
+    : channels_(channels)
+    , platform_loop_(platform_loop) {
+}
+
+PluginHost::~PluginHost() {
+  for (const auto &it : claims_) {
+    channels_.RemoveHandler(it.first);
+  }
+}
+
+bool PluginHost::ParseManifest(const std::string &directory, const std::string &file_name, Plugin *plugin) {
+  std::ifstream manifest(directory + "/" + file_name);
+
+  if (!manifest) {
+    dbgW("Could not read plugin manifest: %s/%s\n", directory.c_str(), file_name.c_str());
+    return false;
+  }
+
+  plugin->name = file_name.substr(0, file_name.size() - kManifestSuffix.size());
+
+  std::string line;
+
+  while (std::getline(manifest, line)) {
+    line = Trim(line.substr(0, line.find('#')));
+
+    const auto eq = line.find('=');
+
+    if (eq == std::string::npos) {
+      continue;
+    }
+
+    const auto key   = Trim(line.substr(0, eq));
+    const auto value = Trim(line.substr(eq + 1));
+
+    if (key == "library") {
+      plugin->library_path = value[0] == '/' ? value : directory + "/" + value;
+    } else if (key == "init") {
+      plugin->init_symbol = value;
+    } else if (key == "thread") {
+      plugin->policy = value == "worker" ? ChannelDispatcher::ThreadPolicy::kWorker : ChannelDispatcher::ThreadPolicy::kPlatform;
+    } else if (key == "channels") {
+      std::stringstream ss(value);
+      std::string channel;
+
+      while (std::getline(ss, channel, ',')) {
+        channel = Trim(channel);
+        if (!channel.empty()) {
+          plugin->channels.push_back(channel);
+        }
+      }
+    } else {
+      dbgW("plugin %s: unknown manifest key: %s\n", plugin->name.c_str(), key.c_str());
+    }
+  }
+
+  if (plugin->library_path.empty() || plugin->channels.empty()) {
+    dbgW("plugin %s: manifest without library or channels\n", plugin->name.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+void PluginHost::Scan(const std::string &directory) {
+  DIR *const dir = opendir(directory.c_str());
+
+  if (dir == nullptr) {
+    dbgW("Could not open plugin directory: %s\n", directory.c_str());
+    return;
+  }
+
+  struct dirent *entry;
+
+  while ((entry = readdir(dir)) != nullptr) {
+    const std::string file_name = entry->d_name;
+
+    if (file_name.size() <= kManifestSuffix.size() || file_name.compare(file_name.size() - kManifestSuffix.size(), kManifestSuffix.size(), kManifestSuffix) != 0) {
+      continue;
+    }
+
+    auto plugin = std::make_unique<Plugin>();
+
+    if (!ParseManifest(directory, file_name, plugin.get())) {
+      continue;
+    }
+
+    Plugin *const p = plugin.get();
+
+    p->host                    = this;
+    p->api.version             = FLUTTER_WAYLAND_PLUGIN_API_VERSION;
+    p->api.host                = p;
+    p->api.set_message_handler = &PluginHost::SetMessageHandler;
+    p->api.respond             = &PluginHost::Respond;
+    p->api.send                = &PluginHost::Send;
+
+    for (const auto &channel : p->channels) {
+      {
+        std::lock_guard<std::mutex> lock(handlers_mutex_);
+
+        if (!claims_.emplace(channel, p).second) {
+          dbgW("plugin %s: channel %s already claimed by plugin %s\n", p->name.c_str(), channel.c_str(), claims_[channel]->name.c_str());
+          continue;
+        }
+      }
+
+      channels_.SetHandler(
+          channel, [this, p, channel](const uint8_t *data, size_t size, ChannelDispatcher::Responder responder) { OnMessage(*p, channel, data, size, std::move(responder)); }, p->policy);
+    }
+
+    dbgI("plugin %s: %zu channel(s), %s\n", p->name.c_str(), p->channels.size(), p->library_path.c_str());
+
+    plugins_.push_back(std::move(plugin));
+  }
+
+  closedir(dir);
+}
+
+bool PluginHost::Load(Plugin &plugin) {
+  std::lock_guard<std::mutex> lock(plugin.load_mutex);
+
+  if (plugin.load_attempted) {
+    return plugin.loaded;
+  }
+
+  plugin.load_attempted = true;
+
+  const uint64_t start_ns = FlutterEngineGetCurrentTime();
+
+  plugin.handle = dlopen(plugin.library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+  if (plugin.handle == nullptr) {
+    dbgE("plugin %s: %s\n", plugin.name.c_str(), dlerror());
+    return false;
+  }
+
+  const uint64_t loaded_ns = FlutterEngineGetCurrentTime();
+
+  const auto init = reinterpret_cast<FlutterWaylandPluginInit>(dlsym(plugin.handle, plugin.init_symbol.c_str()));
+
+  if (init == nullptr) {
+    dbgE("plugin %s: no %s symbol\n", plugin.name.c_str(), plugin.init_symbol.c_str());
+    return false;
+  }
+
+  if (!init(&plugin.api)) {
+    dbgE("plugin %s: initialization failed\n", plugin.name.c_str());
+    return false;
+  }
+
+  const uint64_t end_ns = FlutterEngineGetCurrentTime();
+
+  dbgI("plugin %s: loaded in %.3f ms (dlopen: %.3f ms, init: %.3f ms)\n", plugin.name.c_str(), (end_ns - start_ns) / 1e6, (loaded_ns - start_ns) / 1e6, (end_ns - loaded_ns) / 1e6);
+
+  plugin.loaded = true;
+
+  return true;
+}
+
+void PluginHost::OnMessage(Plugin &plugin, const std::string &channel, const uint8_t *data, size_t size, ChannelDispatcher::Responder responder) {
+  if (!Load(plugin)) {
+    return; // replies with an empty message
+  }
+
+  Handler handler;
+
+  {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+
+    const auto it = handlers_.find(channel);
+
+    if (it != handlers_.end()) {
+      handler = it->second;
+    }
+  }
+
+  if (handler.handler == nullptr) {
+    dbgW("plugin %s: no handler for channel %s\n", plugin.name.c_str(), channel.c_str());
+    return;
+  }
+
+  handler.handler(handler.user_data, channel.c_str(), data, size, new FlutterWaylandResponder{std::move(responder)});
+}
+
+bool PluginHost::SetMessageHandler(void *host, const char *channel, FlutterWaylandMessageHandler handler, void *user_data) {
+  auto *const plugin = static_cast<Plugin *>(host);
+  auto *const self   = plugin->host;
+
+  std::lock_guard<std::mutex> lock(self->handlers_mutex_);
+
+  const auto claim = self->claims_.find(channel);
+
+  if (claim == self->claims_.end() || claim->second != plugin) {
+    dbgE("plugin %s: channel %s is not claimed by its manifest\n", plugin->name.c_str(), channel);
+    return false;
+  }
+
+  self->handlers_[channel] = Handler{handler, user_data};
+
+  return true;
+}
+
+void PluginHost::Respond(FlutterWaylandResponder *responder, const uint8_t *data, size_t size) {
+  responder->responder.Send(data, size);
+  delete responder;
+}
+
+bool PluginHost::Send(void *host, const char *channel, const uint8_t *message, size_t message_size) {
+  auto *const self = static_cast<Plugin *>(host)->host;
+
+  if (self->platform_loop_.RunsTasksOnCurrentThread()) {
+    return self->channels_.Send(channel, message, message_size);
+  }
+
+  self->platform_loop_.PostBackgroundTask([self, channel = std::string(channel), data = std::vector<uint8_t>(message, message + message_size)]() {
+    if (!self->channels_.Send(channel.c_str(), data.data(), data.size())) {
+      dbgW("Could not send a plugin message on channel %s\n", channel.c_str());
+    }
+  });
+
+  return true;
+}
+
+} // namespace flutter
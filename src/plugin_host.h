@@ -0,0 +1,79 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "channel_dispatcher.h"
+#include "event_loop.h"
+#include "macros.h"
+#include "plugin_api.h"
+
+namespace flutter {
+
+// Native plugins (see plugin_api.h) loaded on demand: only the manifests are read at startup,
+// a plugin is dlopen()ed and initialized when the first message for one of its channels arrives.
+class PluginHost {
+public:
+  // Messages sent by the plugins off the platform thread are posted to platform_loop.
+  PluginHost(ChannelDispatcher &channels, PlatformEventLoop &platform_loop);
+
+  // Plugins stay loaded for the lifetime of the process, only the handlers are removed.
+  ~PluginHost();
+
+  // Reads all the *.plugin manifests in the directory and claims their channels.
+  void Scan(const std::string &directory);
+
+private:
+  struct Plugin {
+    PluginHost *host = nullptr;
+    FlutterWaylandPluginHostApi api; // api.host points back to the plugin
+
+    std::string name;
+    std::string library_path;
+    std::string init_symbol = "flutter_wayland_plugin_init";
+    std::vector<std::string> channels;
+    ChannelDispatcher::ThreadPolicy policy = ChannelDispatcher::ThreadPolicy::kPlatform;
+
+    std::mutex load_mutex;
+    bool load_attempted = false;
+    bool loaded         = false;
+    void *handle        = nullptr;
+  };
+
+  struct Handler {
+    FlutterWaylandMessageHandler handler = nullptr;
+    void *user_data                      = nullptr;
+  };
+
+  bool ParseManifest(const std::string &directory, const std::string &file_name, Plugin *plugin);
+
+  bool Load(Plugin &plugin);
+
+  void OnMessage(Plugin &plugin, const std::string &channel, const uint8_t *data, size_t size, ChannelDispatcher::Responder responder);
+
+  static bool SetMessageHandler(void *host, const char *channel, FlutterWaylandMessageHandler handler, void *user_data);
+
+  static void Respond(FlutterWaylandResponder *responder, const uint8_t *data, size_t size);
+
+  static bool Send(void *host, const char *channel, const uint8_t *message, size_t message_size);
+
+  ChannelDispatcher &channels_;
+  PlatformEventLoop &platform_loop_;
+
+  std::vector<std::unique_ptr<Plugin>> plugins_;
+
+  std::mutex handlers_mutex_;
+  std::map<std::string, Plugin *> claims_;
+  std::map<std::string, Handler> handlers_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PluginHost)
+};
+
+} // namespace flutter
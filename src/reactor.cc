@@ -0,0 +1,162 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "debug.h"
+#include "reactor.h"
+#include "utils.h"
+
+namespace flutter {
+
+Reactor::Reactor() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+
+  if (epoll_fd_ == -1) {
+    dbgE("reactor: epoll_create1 failed (errno: %d)\n", errno);
+    return;
+  }
+
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  if (timer_fd_ == -1) {
+    dbgE("reactor: timerfd_create failed (errno: %d)\n", errno);
+    return;
+  }
+
+  // The deadline timer is the only source with a null data pointer.
+  struct epoll_event event = {.events = EPOLLIN, .data = {.ptr = nullptr}};
+
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event) == -1) {
+    dbgE("reactor: could not add the deadline timer (errno: %d)\n", errno);
+    close(timer_fd_);
+    timer_fd_ = -1;
+  }
+}
+
+Reactor::~Reactor() {
+  if (timer_fd_ != -1) {
+    close(timer_fd_);
+  }
+
+  if (epoll_fd_ != -1) {
+    close(epoll_fd_);
+  }
+}
+
+bool Reactor::Add(int fd, uint32_t events, Handler handler, Trigger trigger) {
+  auto source = std::make_unique<Source>(Source{fd, next_order_++, std::move(handler)});
+
+  struct epoll_event event = {.events = events | (trigger == Trigger::kEdge ? static_cast<uint32_t>(EPOLLET) : 0), .data = {.ptr = source.get()}};
+
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+    dbgE("reactor: could not add fd %d (errno: %d)\n", fd, errno);
+    return false;
+  }
+
+  sources_.push_back(std::move(source));
+
+  return true;
+}
+
+void Reactor::Remove(int fd) {
+  const auto it = std::find_if(sources_.begin(), sources_.end(), [fd](const std::unique_ptr<Source> &source) { return source->fd == fd; });
+
+  if (it == sources_.end()) {
+    return;
+  }
+
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+    dbgW("reactor: could not remove fd %d (errno: %d)\n", fd, errno);
+  }
+
+  // It may still be among the ready sources of the current dispatch.
+  (*it)->fd = -1;
+  removed_.push_back(std::move(*it));
+  sources_.erase(it);
+}
+
+bool Reactor::ArmTimer(uint64_t deadline_ns) {
+  if (deadline_ns == armed_deadline_ns_) {
+    return true;
+  }
+
+  // Zero disarms it.
+  struct itimerspec spec = {};
+  timespec_from_nsec(&spec.it_value, static_cast<int64_t>(deadline_ns));
+
+  if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+    dbgE("reactor: timerfd_settime failed (errno: %d)\n", errno);
+    return false;
+  }
+
+  armed_deadline_ns_ = deadline_ns;
+
+  return true;
+}
+
+int Reactor::RunOnce(uint64_t deadline_ns) {
+  int timeout_ms = -1;
+
+  if (deadline_ns != 0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (deadline_ns <= static_cast<uint64_t>(now.tv_sec) * NSEC_PER_SEC + now.tv_nsec) {
+      timeout_ms  = 0;
+      deadline_ns = 0;
+    }
+  }
+
+  if (!ArmTimer(deadline_ns)) {
+    return -1;
+  }
+
+  struct epoll_event events[kMaxEvents];
+  int count;
+
+  do {
+    count = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+  } while (count == -1 && errno == EINTR);
+
+  if (count == -1) {
+    dbgE("reactor: epoll_wait failed (errno: %d)\n", errno);
+    return -1;
+  }
+
+  ready_.clear();
+
+  for (int i = 0; i < count; i++) {
+    auto *const source = static_cast<Source *>(events[i].data.ptr);
+
+    if (source == nullptr) {
+      uint64_t expirations;
+      while (read(timer_fd_, &expirations, sizeof expirations) == -1 && errno == EINTR) {
+      }
+      armed_deadline_ns_ = 0;
+      continue;
+    }
+
+    ready_.emplace_back(source, static_cast<uint32_t>(events[i].events));
+  }
+
+  std::sort(ready_.begin(), ready_.end(), [](const auto &a, const auto &b) { return a.first->order < b.first->order; });
+
+  for (const auto &[source, ready_events] : ready_) {
+    if (source->fd != -1) {
+      source->handler(ready_events);
+    }
+  }
+
+  removed_.clear();
+
+  return static_cast<int>(ready_.size());
+}
+
+} // namespace flutter
@@ -0,0 +1,73 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// epoll based event loop of the platform thread: the event sources are registered once, every
+// wakeup dispatches all the ready ones (in the order they were added), and the deadline of the
+// caller is a timerfd (nanosecond precision, unlike the epoll_wait timeout).
+class Reactor {
+public:
+  // Called with the ready epoll events (EPOLLIN, EPOLLERR, ...) of the source.
+  using Handler = std::function<void(uint32_t events)>;
+
+  enum class Trigger {
+    kLevel, // the handler is called as long as the source is ready
+    kEdge,  // the handler is called when the source becomes ready, it has to drain it
+  };
+
+  Reactor();
+
+  ~Reactor();
+
+  bool IsValid() const {
+    return epoll_fd_ != -1 && timer_fd_ != -1;
+  }
+
+  // The fd stays owned by the caller, and has to be removed before it gets closed.
+  bool Add(int fd, uint32_t events, Handler handler, Trigger trigger = Trigger::kLevel);
+
+  // Can be called from a handler, also for the source being dispatched.
+  void Remove(int fd);
+
+  // Waits until a source is ready or deadline_ns (CLOCK_MONOTONIC, 0 for none) passes, and calls
+  // the handlers of all the ready sources. Returns the number of them, 0 on the deadline, -1 on error.
+  int RunOnce(uint64_t deadline_ns);
+
+private:
+  struct Source {
+    int fd;
+    uint64_t order;
+    Handler handler;
+  };
+
+  bool ArmTimer(uint64_t deadline_ns);
+
+  static constexpr int kMaxEvents = 16;
+
+  int epoll_fd_               = -1;
+  int timer_fd_               = -1;
+  uint64_t armed_deadline_ns_ = 0;
+
+  uint64_t next_order_ = 0;
+  std::vector<std::unique_ptr<Source>> sources_;
+  std::vector<std::unique_ptr<Source>> removed_; // kept alive until the dispatch is over
+  std::vector<std::pair<Source *, uint32_t>> ready_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(Reactor)
+};
+
+} // namespace flutter
@@ -0,0 +1,79 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+
+#include "debug.h"
+#include "resolution_controller.h"
+
+namespace flutter {
+
+ResolutionController::ResolutionController(const Config &config)
+    : config_(config)
+    , scale_(config.max_scale) {
+}
+
+bool ResolutionController::OnFramePresented(uint64_t interval_ns, uint64_t refresh_ns) {
+  if (interval_ns == 0 || refresh_ns == 0) {
+    return false;
+  }
+
+  // Rounded number of vblanks between the two frames.
+  const uint64_t vblanks = (interval_ns + refresh_ns / 2) / refresh_ns;
+
+  // A long gap means nothing was animating rather than the frame being late.
+  if (vblanks > 4) {
+    return false;
+  }
+
+  return OnFrame(vblanks > 1 ? vblanks - 1 : 0);
+}
+
+bool ResolutionController::OnFrameDiscarded() {
+  return OnFrame(1);
+}
+
+bool ResolutionController::OnFrame(size_t missed_vblanks) {
+  frames_++;
+  missed_ += missed_vblanks;
+
+  if (frames_ < config_.window_frames) {
+    return false;
+  }
+
+  const double miss_ratio = static_cast<double>(missed_) / frames_;
+  const double old_scale  = scale_;
+
+  frames_ = missed_ = 0;
+
+  if (miss_ratio > config_.miss_ratio_down) {
+    clean_windows_ = 0;
+
+    // The higher resolution has just been proven to be too expensive, be more patient next time.
+    if (just_stepped_up_) {
+      backoff_shift_ = std::min(backoff_shift_ + 1, config_.max_backoff_shift);
+    }
+
+    scale_ = std::max(config_.min_scale, scale_ - config_.step);
+  } else if (miss_ratio == 0.0) {
+    if (++clean_windows_ >= (config_.clean_windows_up << backoff_shift_)) {
+      clean_windows_ = 0;
+      scale_         = std::min(config_.max_scale, scale_ + config_.step);
+    }
+  } else {
+    clean_windows_ = 0;
+  }
+
+  just_stepped_up_ = scale_ > old_scale;
+
+  if (scale_ == old_scale) {
+    return false;
+  }
+
+  dbgI("resolution: missed vblanks per frame: %.3f, render scale: %.3f -> %.3f\n", miss_ratio, old_scale, scale_);
+
+  return true;
+}
+
+} // namespace flutter
@@ -0,0 +1,55 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flutter {
+
+// Closed-loop controller of the internal render scale (see FLUTTER_WAYLAND_RENDER_SCALE).
+//
+// Fed with the presentation timing of every frame, it evaluates the ratio of missed vblanks
+// over windows of frames: the scale is stepped down as soon as a window misses too many of them
+// and stepped back up only after several consecutive windows without a single miss. Going back
+// down right after a step up doubles the number of clean windows required for the next step up.
+class ResolutionController {
+public:
+  struct Config {
+    double min_scale         = 0.5;
+    double max_scale         = 1.0;
+    double step              = 0.125;
+    size_t window_frames     = 30;  // frames per evaluation window
+    double miss_ratio_down   = 0.1; // missed vblanks per frame which trigger a step down
+    size_t clean_windows_up  = 4;   // consecutive windows without a miss needed for a step up
+    size_t max_backoff_shift = 4;   // clean_windows_up << max_backoff_shift is the upper limit
+  };
+
+  explicit ResolutionController(const Config &config);
+
+  // interval_ns is the time since the previously presented frame, refresh_ns the vblank period.
+  // Returns true if Scale() has changed.
+  bool OnFramePresented(uint64_t interval_ns, uint64_t refresh_ns);
+
+  // Returns true if Scale() has changed.
+  bool OnFrameDiscarded();
+
+  double Scale() const {
+    return scale_;
+  }
+
+private:
+  bool OnFrame(size_t missed_vblanks);
+
+  const Config config_;
+  double scale_;
+  size_t frames_        = 0;
+  size_t missed_        = 0;
+  size_t clean_windows_ = 0;
+  size_t backoff_shift_ = 0;
+  bool just_stepped_up_ = false;
+};
+
+} // namespace flutter
@@ -0,0 +1,199 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <GLES2/gl2.h>
+
+#include <atomic>
+#include <cstring>
+
+#include <flutter_embedder.h>
+
+#include "debug.h"
+#include "egl_utils.h"
+#include "resource_context.h"
+
+namespace flutter {
+
+// Set on the threads owning a resource context, only their uploads are accounted.
+static thread_local bool upload_thread = false;
+
+static std::atomic<uint64_t> upload_count    = 0;
+static std::atomic<uint64_t> upload_total_ns = 0;
+static std::atomic<uint64_t> upload_max_ns   = 0;
+
+static void AccountUpload(const uint64_t start_ns) {
+  const uint64_t duration_ns = FlutterEngineGetCurrentTime() - start_ns;
+
+  upload_count++;
+  upload_total_ns += duration_ns;
+
+  uint64_t max_ns = upload_max_ns.load(std::memory_order_relaxed);
+  while (duration_ns > max_ns && !upload_max_ns.compare_exchange_weak(max_ns, duration_ns, std::memory_order_relaxed)) {
+  }
+}
+
+typedef void(GL_APIENTRYP TexImage2DProc)(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void *);
+typedef void(GL_APIENTRYP TexSubImage2DProc)(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void *);
+
+static TexImage2DProc real_tex_image_2d        = nullptr;
+static TexSubImage2DProc real_tex_sub_image_2d = nullptr;
+
+static void GL_APIENTRY TexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels) {
+  if (!upload_thread || pixels == nullptr) {
+    real_tex_image_2d(target, level, internalformat, width, height, border, format, type, pixels);
+    return;
+  }
+
+  const uint64_t start_ns = FlutterEngineGetCurrentTime();
+  real_tex_image_2d(target, level, internalformat, width, height, border, format, type, pixels);
+  AccountUpload(start_ns);
+}
+
+static void GL_APIENTRY TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels) {
+  if (!upload_thread) {
+    real_tex_sub_image_2d(target, level, xoffset, yoffset, width, height, format, type, pixels);
+    return;
+  }
+
+  const uint64_t start_ns = FlutterEngineGetCurrentTime();
+  real_tex_sub_image_2d(target, level, xoffset, yoffset, width, height, format, type, pixels);
+  AccountUpload(start_ns);
+}
+
+ResourceContextPool::ResourceContextPool(EGLDisplay display, EGLConfig config, const EGLConfigPolicy &policy, EGLContext share_context, size_t size)
+    : display_(display) {
+  const bool surfaceless = HasEGLExtension(display, "EGL_KHR_surfaceless_context");
+
+  if (!surfaceless) {
+    // Nothing is rendered into the pbuffers, only the format has to match the onscreen one.
+    EGLConfigPolicy pbuffer_policy = policy;
+    pbuffer_policy.surface_type    = EGL_PBUFFER_BIT;
+    pbuffer_policy.stencil_size    = 0;
+    pbuffer_policy.samples         = 0;
+
+    config = ChooseEGLConfig(display, pbuffer_policy);
+
+    if (config == nullptr) {
+      dbgE("No pbuffer EGL config for the resource contexts.\n");
+      return;
+    }
+  }
+
+  const EGLint ctx_attribs[]     = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+  const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+
+  for (size_t i = 0; i < size; i++) {
+    Context ctx;
+
+    ctx.context = eglCreateContext(display, config, share_context, ctx_attribs);
+
+    if (ctx.context == EGL_NO_CONTEXT) {
+      LogLastEGLError();
+      dbgE("Could not create resource context %zu.\n", i);
+      break;
+    }
+
+    if (!surfaceless) {
+      ctx.surface = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+
+      if (ctx.surface == EGL_NO_SURFACE) {
+        LogLastEGLError();
+        dbgE("Could not create resource context %zu pbuffer surface.\n", i);
+        eglDestroyContext(display, ctx.context);
+        break;
+      }
+    }
+
+    contexts_.push_back(ctx);
+  }
+
+  dbgI("Created %zu/%zu %s resource context(s)\n", contexts_.size(), size, surfaceless ? "surfaceless" : "pbuffer");
+}
+
+ResourceContextPool::~ResourceContextPool() {
+  for (auto &ctx : contexts_) {
+    if (ctx.surface != EGL_NO_SURFACE) {
+      eglDestroySurface(display_, ctx.surface);
+    }
+
+    eglDestroyContext(display_, ctx.context);
+  }
+
+  contexts_.clear();
+
+  LogUploadStats();
+}
+
+const ResourceContextPool::Context *ResourceContextPool::AcquireForCurrentThread() {
+  const auto self = std::this_thread::get_id();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  Context *free_ctx = nullptr;
+
+  for (auto &ctx : contexts_) {
+    if (ctx.owner == self) {
+      return &ctx;
+    }
+
+    if (free_ctx == nullptr && ctx.owner == std::thread::id()) {
+      free_ctx = &ctx;
+    }
+  }
+
+  if (free_ctx != nullptr) {
+    free_ctx->owner = self;
+  }
+
+  return free_ctx;
+}
+
+bool ResourceContextPool::MakeCurrent() {
+  const Context *ctx = AcquireForCurrentThread();
+
+  if (ctx == nullptr) {
+    dbgE("No resource context left for this thread (pool size: %zu)\n", contexts_.size());
+    return false;
+  }
+
+  if (eglMakeCurrent(display_, ctx->surface, ctx->surface, ctx->context) != EGL_TRUE) {
+    LogLastEGLError();
+    dbgE("Could not make the RESOURCE context current\n");
+    return false;
+  }
+
+  upload_thread = true;
+
+  return true;
+}
+
+void *ResourceContextPool::InterceptGLProc(const char *name, void *address) {
+  if (address == nullptr || name == nullptr) {
+    return address;
+  }
+
+  if (strcmp(name, "glTexImage2D") == 0) {
+    real_tex_image_2d = reinterpret_cast<TexImage2DProc>(address);
+    return reinterpret_cast<void *>(&TexImage2D);
+  }
+
+  if (strcmp(name, "glTexSubImage2D") == 0) {
+    real_tex_sub_image_2d = reinterpret_cast<TexSubImage2DProc>(address);
+    return reinterpret_cast<void *>(&TexSubImage2D);
+  }
+
+  return address;
+}
+
+void ResourceContextPool::LogUploadStats() {
+  const uint64_t count = upload_count.load();
+
+  if (count == 0) {
+    return;
+  }
+
+  dbgI("texture uploads: %ju, total: %.3f ms, avg: %.3f ms, max: %.3f ms\n", static_cast<uintmax_t>(count), upload_total_ns.load() / 1e6, upload_total_ns.load() / 1e6 / count, upload_max_ns.load() / 1e6);
+}
+
+} // namespace flutter
@@ -0,0 +1,61 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "egl_utils.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Contexts sharing the object namespace of the onscreen context, which the engine makes current
+// (make_resource_current) on its IO thread(s) to upload textures off the raster thread.
+//
+// A context is assigned to a thread on its first MakeCurrent() call and stays with it for the
+// lifetime of the pool. With EGL_KHR_surfaceless_context the contexts are bound without any
+// surface, otherwise a 1x1 pbuffer is allocated for each of them, using a pbuffer capable config
+// of the policy's format (the onscreen config might support window surfaces only).
+class ResourceContextPool {
+public:
+  ResourceContextPool(EGLDisplay display, EGLConfig config, const EGLConfigPolicy &policy, EGLContext share_context, size_t size);
+
+  // Destroys all the contexts and surfaces, the display must still be initialized.
+  ~ResourceContextPool();
+
+  bool IsValid() const {
+    return !contexts_.empty();
+  }
+
+  bool MakeCurrent();
+
+  // Returns address, or a wrapper of it accounting the time spent in texture uploads
+  // (glTexImage2D, glTexSubImage2D) on the threads owning a resource context.
+  static void *InterceptGLProc(const char *name, void *address);
+
+  // Logs the texture upload counters.
+  static void LogUploadStats();
+
+private:
+  struct Context {
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    std::thread::id owner;
+  };
+
+  const Context *AcquireForCurrentThread();
+
+  const EGLDisplay display_;
+  std::mutex mutex_;
+  std::vector<Context> contexts_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ResourceContextPool)
+};
+
+} // namespace flutter
@@ -0,0 +1,259 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sys/mman.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "channel_dispatcher.h"
+#include "debug.h"
+#include "shared_blob.h"
+#include "standard_codec.h"
+
+namespace flutter {
+
+static constexpr size_t kMinChunkShift = 12; // 4 KiB
+
+// Freed chunks at least this large have their pages dropped instead of being kept resident.
+static constexpr size_t kPunchHoleSize = 256 * 1024;
+
+std::atomic<SharedBlobPool *> SharedBlobPool::instance_ = nullptr;
+
+size_t SharedBlobPool::ChunkSize(size_t size_class) {
+  return size_t(1) << (kMinChunkShift + size_class);
+}
+
+SharedBlobPool::SharedBlobPool(size_t capacity, int notify_fd)
+    : capacity_(capacity)
+    , notify_fd_(notify_fd) {
+  fd_ = memfd_create("flutter-shared-blobs", MFD_CLOEXEC);
+
+  if (fd_ == -1) {
+    dbgE("memfd_create() failed (errno: %d)\n", errno);
+    return;
+  }
+
+  // The file is sparse, pages are allocated only once written.
+  if (ftruncate(fd_, capacity_) == -1) {
+    dbgE("ftruncate() failed (errno: %d)\n", errno);
+    return;
+  }
+
+  void *const base = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+  if (base == MAP_FAILED) {
+    dbgE("mmap() failed (errno: %d)\n", errno);
+    return;
+  }
+
+  base_ = static_cast<uint8_t *>(base);
+
+  while (ChunkSize(free_chunks_.size()) <= capacity_) {
+    free_chunks_.emplace_back();
+  }
+
+  instance_ = this;
+
+  dbgI("shared blob pool: %zu MiB\n", capacity_ >> 20);
+}
+
+SharedBlobPool::~SharedBlobPool() {
+  SharedBlobPool *self = this;
+  instance_.compare_exchange_strong(self, nullptr);
+
+  if (base_ != nullptr) {
+    munmap(base_, capacity_);
+  }
+
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+bool SharedBlobPool::Allocate(size_t size, Blob *blob) {
+  if (!IsValid() || size == 0) {
+    return false;
+  }
+
+  size_t size_class = 0;
+
+  while (size_class < free_chunks_.size() && ChunkSize(size_class) < size) {
+    size_class++;
+  }
+
+  if (size_class == free_chunks_.size()) {
+    dbgE("shared blob too large: %zu bytes\n", size);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto &free_chunks = free_chunks_[size_class];
+  size_t offset;
+
+  if (free_chunks.empty() && !pending_.empty()) {
+    ReclaimLocked();
+  }
+
+  if (!free_chunks.empty()) {
+    offset = free_chunks.back();
+    free_chunks.pop_back();
+  } else if (capacity_ - bump_ >= ChunkSize(size_class)) {
+    offset = bump_;
+    bump_ += ChunkSize(size_class);
+  } else {
+    // Chunks are not split nor merged across size classes.
+    dbgE("shared blob pool exhausted, could not allocate %zu bytes\n", size);
+    return false;
+  }
+
+  uint32_t index;
+
+  if (!free_slots_.empty()) {
+    index = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    index = slots_.size();
+    slots_.emplace_back();
+  }
+
+  Slot &slot      = slots_[index];
+  slot.refs       = 1;
+  slot.offset     = offset;
+  slot.size       = size;
+  slot.size_class = size_class;
+
+  blob->handle = (static_cast<uint64_t>(slot.generation) << 32) | (index + 1);
+  blob->data   = base_ + offset;
+  blob->size   = size;
+  blob->fd     = fd_;
+  blob->offset = offset;
+
+  return true;
+}
+
+bool SharedBlobPool::Acquire(uint64_t handle, Blob *blob) {
+  const uint64_t index = (handle & 0xffffffff) - 1;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (index >= slots_.size()) {
+    return false;
+  }
+
+  Slot &slot = slots_[index];
+
+  if (slot.refs == 0 || slot.generation != (handle >> 32)) {
+    return false;
+  }
+
+  slot.refs++;
+
+  blob->handle = handle;
+  blob->data   = base_ + slot.offset;
+  blob->size   = slot.size;
+  blob->fd     = fd_;
+  blob->offset = slot.offset;
+
+  return true;
+}
+
+void SharedBlobPool::Release(uint64_t handle) {
+  const uint64_t index = (handle & 0xffffffff) - 1;
+  bool notify          = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (index >= slots_.size() || slots_[index].refs == 0 || slots_[index].generation != (handle >> 32)) {
+      dbgW("release of an invalid shared blob handle: %jx\n", static_cast<uintmax_t>(handle));
+      return;
+    }
+
+    if (--slots_[index].refs == 0) {
+      notify = pending_.empty();
+      pending_.push_back(index);
+    }
+  }
+
+  if (notify && notify_fd_ != -1) {
+    const uint64_t value = 1;
+    if (write(notify_fd_, &value, sizeof(value)) != sizeof(value)) {
+      dbgW("Could not wake up the platform thread (errno: %d)\n", errno);
+    }
+  }
+}
+
+bool SharedBlobPool::Send(ChannelDispatcher &channels, const char *channel, const Blob &blob) {
+  StandardMessageWriter writer;
+
+  writer.BeginList(2);
+  writer.WriteInt(static_cast<int64_t>(blob.handle));
+  writer.WriteInt(static_cast<int64_t>(blob.size));
+
+  if (!channels.Send(channel, writer.data(), writer.size())) {
+    Release(blob.handle);
+    return false;
+  }
+
+  return true;
+}
+
+void SharedBlobPool::Reclaim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReclaimLocked();
+}
+
+void SharedBlobPool::ReclaimLocked() {
+  for (const uint32_t index : pending_) {
+    Slot &slot        = slots_[index];
+    const size_t size = ChunkSize(slot.size_class);
+
+    auto &free_chunks = free_chunks_[slot.size_class];
+
+    // The first free chunk of a size class stays resident and is the next one handed out, so a
+    // producer cycling through blobs does not fault the pages in again for every one of them.
+    if (size < kPunchHoleSize || free_chunks.empty()) {
+      free_chunks.push_back(slot.offset);
+    } else {
+      if (fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, slot.offset, size) == -1) {
+        dbgW("Could not release shared blob pages (errno: %d)\n", errno);
+      }
+
+      free_chunks.insert(free_chunks.begin(), slot.offset);
+    }
+
+    // Invalidates all the outstanding copies of the handle.
+    slot.generation++;
+    free_slots_.push_back(index);
+  }
+
+  pending_.clear();
+}
+
+} // namespace flutter
+
+int32_t flutter_wayland_blob_acquire(uint64_t handle, const uint8_t **data, uint64_t *size) {
+  auto *const pool = flutter::SharedBlobPool::Instance();
+  flutter::SharedBlobPool::Blob blob;
+
+  if (pool == nullptr || !pool->Acquire(handle, &blob)) {
+    return 0;
+  }
+
+  *data = blob.data;
+  *size = blob.size;
+
+  return 1;
+}
+
+void flutter_wayland_blob_release(uint64_t handle) {
+  auto *const pool = flutter::SharedBlobPool::Instance();
+
+  if (pool != nullptr) {
+    pool->Release(handle);
+  }
+}
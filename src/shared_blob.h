@@ -0,0 +1,104 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+class ChannelDispatcher;
+
+// Bulk data shared between native code and Dart without copying it through platform messages.
+//
+// Blobs are carved out of a single memfd-backed mapping (power-of-two size classes, 4 KiB minimum),
+// so the pages can also be written by another process the fd is passed to. Native code allocates
+// a blob, fills it and sends only its handle over a channel (Send()); Dart then reads the memory
+// in place through FFI (flutter_wayland_blob_acquire/release exported by the executable).
+//
+// Blobs are reference counted. The memory of released ones is reclaimed on the platform thread,
+// which is woken up through notify_fd; large chunks have their pages returned to the system,
+// except for one per size class which is kept for the next allocation.
+class SharedBlobPool {
+public:
+  struct Blob {
+    uint64_t handle = 0;
+    uint8_t *data   = nullptr;
+    size_t size     = 0;
+    int fd          = -1; // of the whole pool, data starts at offset
+    size_t offset   = 0;
+  };
+
+  SharedBlobPool(size_t capacity, int notify_fd);
+
+  ~SharedBlobPool();
+
+  bool IsValid() const {
+    return base_ != nullptr;
+  }
+
+  // The new blob has a single reference owned by the caller.
+  bool Allocate(size_t size, Blob *blob);
+
+  // Takes another reference, fails for released or unknown handles.
+  bool Acquire(uint64_t handle, Blob *blob);
+
+  void Release(uint64_t handle);
+
+  // Hands the caller's reference over to Dart, which receives [handle, size]
+  // (StandardMessageCodec) and has to release it once done.
+  bool Send(ChannelDispatcher &channels, const char *channel, const Blob &blob);
+
+  // Platform thread.
+  void Reclaim();
+
+  // For the FFI entry points.
+  static SharedBlobPool *Instance() {
+    return instance_.load();
+  }
+
+private:
+  struct Slot {
+    uint32_t generation = 0;
+    uint32_t refs       = 0;
+    size_t offset       = 0;
+    size_t size         = 0;
+    size_t size_class   = 0;
+  };
+
+  static size_t ChunkSize(size_t size_class);
+
+  void ReclaimLocked();
+
+  static std::atomic<SharedBlobPool *> instance_;
+
+  const size_t capacity_;
+  const int notify_fd_;
+  int fd_        = -1;
+  uint8_t *base_ = nullptr;
+
+  std::mutex mutex_;
+  size_t bump_ = 0; // never handed out part of the mapping starts here
+  std::vector<std::vector<size_t>> free_chunks_; // offsets, per size class
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> free_slots_;
+  std::vector<uint32_t> pending_; // slots without references, to be reclaimed
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(SharedBlobPool)
+};
+
+} // namespace flutter
+
+// Dart: DynamicLibrary.executable().lookupFunction<...>('flutter_wayland_blob_acquire')
+extern "C" {
+// Returns 1 and the blob memory on success, 0 otherwise. The memory stays valid until released.
+__attribute__((visibility("default"))) int32_t flutter_wayland_blob_acquire(uint64_t handle, const uint8_t **data, uint64_t *size);
+
+__attribute__((visibility("default"))) void flutter_wayland_blob_release(uint64_t handle);
+}
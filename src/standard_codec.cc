@@ -0,0 +1,501 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstring>
+#include <limits>
+
+#include "debug.h"
+#include "standard_codec.h"
+
+namespace flutter {
+
+// Type tags as defined by StandardMessageCodec, all values are in the host byte order.
+enum : uint8_t {
+  kNull = 0,
+  kTrue,
+  kFalse,
+  kInt32,
+  kInt64,
+  kLargeInt, // hex string, not produced by current Dart versions
+  kFloat64,
+  kString,
+  kUint8List,
+  kInt32List,
+  kInt64List,
+  kFloat64List,
+  kList,
+  kMap,
+  kFloat32List,
+};
+
+// Protects the stack from malicious or corrupted messages.
+static constexpr size_t kMaxDepth = 64;
+
+bool StandardValue::GetInt(int64_t *out) const {
+  if (const auto *v = Get<int32_t>()) {
+    *out = *v;
+    return true;
+  }
+
+  if (const auto *v = Get<int64_t>()) {
+    *out = *v;
+    return true;
+  }
+
+  return false;
+}
+
+const StandardValue *StandardValue::Find(std::string_view key) const {
+  const auto *map = Get<StandardMap>();
+
+  if (map == nullptr) {
+    return nullptr;
+  }
+
+  for (const auto &entry : *map) {
+    const auto *k = entry.key.Get<std::string_view>();
+
+    if (k != nullptr && *k == key) {
+      return &entry.value;
+    }
+  }
+
+  return nullptr;
+}
+
+StandardMessageReader::StandardMessageReader(const uint8_t *data, size_t size)
+    : data_(data)
+    , size_(size) {
+}
+
+bool StandardMessageReader::ReadByte(uint8_t *byte) {
+  if (pos_ >= size_) {
+    return false;
+  }
+
+  *byte = data_[pos_++];
+
+  return true;
+}
+
+template <typename T> bool StandardMessageReader::ReadScalar(T *value) {
+  if (size_ - pos_ < sizeof(T)) {
+    return false;
+  }
+
+  memcpy(value, data_ + pos_, sizeof(T));
+  pos_ += sizeof(T);
+
+  return true;
+}
+
+bool StandardMessageReader::ReadSize(size_t *size) {
+  uint8_t byte;
+
+  if (!ReadByte(&byte)) {
+    return false;
+  }
+
+  if (byte < 254) {
+    *size = byte;
+    return true;
+  }
+
+  if (byte == 254) {
+    uint16_t value;
+    if (!ReadScalar(&value)) {
+      return false;
+    }
+    *size = value;
+    return true;
+  }
+
+  uint32_t value;
+  if (!ReadScalar(&value)) {
+    return false;
+  }
+  *size = value;
+
+  return true;
+}
+
+bool StandardMessageReader::Align(size_t alignment) {
+  const size_t mod = pos_ % alignment;
+
+  if (mod != 0) {
+    if (size_ - pos_ < alignment - mod) {
+      return false;
+    }
+    pos_ += alignment - mod;
+  }
+
+  return true;
+}
+
+template <typename T> bool StandardMessageReader::ReadTypedList(StandardValue *value) {
+  size_t count;
+
+  if (!ReadSize(&count) || !Align(sizeof(T)) || (size_ - pos_) / sizeof(T) < count) {
+    return false;
+  }
+
+  const uint8_t *const bytes = data_ + pos_;
+  pos_ += count * sizeof(T);
+
+  if (reinterpret_cast<uintptr_t>(bytes) % alignof(T) == 0) {
+    value->value = std::span<const T>(reinterpret_cast<const T *>(bytes), count);
+    return true;
+  }
+
+  auto &copy = copies_.emplace_back((count * sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  memcpy(copy.data(), bytes, count * sizeof(T));
+  value->value = std::span<const T>(reinterpret_cast<const T *>(copy.data()), count);
+
+  return true;
+}
+
+bool StandardMessageReader::Read(StandardValue *value) {
+  uint8_t type;
+
+  if (!ReadByte(&type)) {
+    return false;
+  }
+
+  switch (type) {
+  case kNull:
+    value->value = std::monostate();
+    return true;
+  case kTrue:
+    value->value = true;
+    return true;
+  case kFalse:
+    value->value = false;
+    return true;
+  case kInt32: {
+    int32_t v;
+    if (!ReadScalar(&v)) {
+      return false;
+    }
+    value->value = v;
+    return true;
+  }
+  case kInt64: {
+    int64_t v;
+    if (!ReadScalar(&v)) {
+      return false;
+    }
+    value->value = v;
+    return true;
+  }
+  case kFloat64: {
+    double v;
+    if (!Align(8) || !ReadScalar(&v)) {
+      return false;
+    }
+    value->value = v;
+    return true;
+  }
+  case kLargeInt:
+  case kString: {
+    size_t length;
+    if (!ReadSize(&length) || size_ - pos_ < length) {
+      return false;
+    }
+    const std::string_view v(reinterpret_cast<const char *>(data_ + pos_), length);
+    if (type == kLargeInt) {
+      value->value = StandardLargeInt{v};
+    } else {
+      value->value = v;
+    }
+    pos_ += length;
+    return true;
+  }
+  case kUint8List:
+    return ReadTypedList<uint8_t>(value);
+  case kInt32List:
+    return ReadTypedList<int32_t>(value);
+  case kInt64List:
+    return ReadTypedList<int64_t>(value);
+  case kFloat32List:
+    return ReadTypedList<float>(value);
+  case kFloat64List:
+    return ReadTypedList<double>(value);
+  case kList:
+  case kMap: {
+    size_t count;
+
+    // Every element takes at least one byte, which bounds the allocation below.
+    if (depth_ >= kMaxDepth || !ReadSize(&count) || size_ - pos_ < count) {
+      return false;
+    }
+
+    depth_++;
+
+    bool ok = true;
+
+    if (type == kList) {
+      StandardList list(count);
+      for (size_t i = 0; ok && i < count; i++) {
+        ok = Read(&list[i]);
+      }
+      value->value = std::move(list);
+    } else {
+      StandardMap map(count);
+      for (size_t i = 0; ok && i < count; i++) {
+        ok = Read(&map[i].key) && Read(&map[i].value);
+      }
+      value->value = std::move(map);
+    }
+
+    depth_--;
+
+    return ok;
+  }
+  default:
+    dbgW("StandardMessageCodec: unknown type: %u at: %zu\n", type, pos_ - 1);
+    return false;
+  }
+}
+
+void StandardMessageWriter::WriteRaw(const void *data, size_t size) {
+  const auto *const bytes = static_cast<const uint8_t *>(data);
+  buffer_.insert(buffer_.end(), bytes, bytes + size);
+}
+
+void StandardMessageWriter::WriteSize(size_t size) {
+  if (size < 254) {
+    WriteByte(static_cast<uint8_t>(size));
+  } else if (size <= 0xffff) {
+    const uint16_t value = static_cast<uint16_t>(size);
+    WriteByte(254);
+    WriteRaw(&value, sizeof(value));
+  } else {
+    const uint32_t value = static_cast<uint32_t>(size);
+    WriteByte(255);
+    WriteRaw(&value, sizeof(value));
+  }
+}
+
+void StandardMessageWriter::Align(size_t alignment) {
+  const size_t mod = buffer_.size() % alignment;
+
+  if (mod != 0) {
+    buffer_.resize(buffer_.size() + alignment - mod, 0);
+  }
+}
+
+void StandardMessageWriter::WriteNull() {
+  WriteByte(kNull);
+}
+
+void StandardMessageWriter::WriteBool(bool value) {
+  WriteByte(value ? kTrue : kFalse);
+}
+
+void StandardMessageWriter::WriteInt(int64_t value) {
+  if (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max()) {
+    const int32_t v = static_cast<int32_t>(value);
+    WriteByte(kInt32);
+    WriteRaw(&v, sizeof(v));
+  } else {
+    WriteByte(kInt64);
+    WriteRaw(&value, sizeof(value));
+  }
+}
+
+void StandardMessageWriter::WriteLargeInt(std::string_view hex) {
+  WriteByte(kLargeInt);
+  WriteSize(hex.size());
+  WriteRaw(hex.data(), hex.size());
+}
+
+void StandardMessageWriter::WriteDouble(double value) {
+  WriteByte(kFloat64);
+  Align(8);
+  WriteRaw(&value, sizeof(value));
+}
+
+void StandardMessageWriter::WriteString(std::string_view value) {
+  WriteByte(kString);
+  WriteSize(value.size());
+  WriteRaw(value.data(), value.size());
+}
+
+void StandardMessageWriter::WriteUint8List(std::span<const uint8_t> value) {
+  WriteByte(kUint8List);
+  WriteSize(value.size());
+  WriteRaw(value.data(), value.size_bytes());
+}
+
+void StandardMessageWriter::WriteInt32List(std::span<const int32_t> value) {
+  WriteByte(kInt32List);
+  WriteSize(value.size());
+  Align(4);
+  WriteRaw(value.data(), value.size_bytes());
+}
+
+void StandardMessageWriter::WriteInt64List(std::span<const int64_t> value) {
+  WriteByte(kInt64List);
+  WriteSize(value.size());
+  Align(8);
+  WriteRaw(value.data(), value.size_bytes());
+}
+
+void StandardMessageWriter::WriteFloat32List(std::span<const float> value) {
+  WriteByte(kFloat32List);
+  WriteSize(value.size());
+  Align(4);
+  WriteRaw(value.data(), value.size_bytes());
+}
+
+void StandardMessageWriter::WriteFloat64List(std::span<const double> value) {
+  WriteByte(kFloat64List);
+  WriteSize(value.size());
+  Align(8);
+  WriteRaw(value.data(), value.size_bytes());
+}
+
+void StandardMessageWriter::BeginList(size_t size) {
+  WriteByte(kList);
+  WriteSize(size);
+}
+
+void StandardMessageWriter::BeginMap(size_t size) {
+  WriteByte(kMap);
+  WriteSize(size);
+}
+
+void StandardMessageWriter::Write(const StandardValue &value) {
+  struct Visitor {
+    StandardMessageWriter &w;
+
+    void operator()(std::monostate) {
+      w.WriteNull();
+    }
+    void operator()(bool v) {
+      w.WriteBool(v);
+    }
+    void operator()(int32_t v) {
+      w.WriteInt(v);
+    }
+    void operator()(int64_t v) {
+      // Keep the width of the decoded value, so that decode/encode round-trips byte for byte.
+      w.WriteByte(kInt64);
+      w.WriteRaw(&v, sizeof(v));
+    }
+    void operator()(StandardLargeInt v) {
+      w.WriteLargeInt(v.hex);
+    }
+    void operator()(double v) {
+      w.WriteDouble(v);
+    }
+    void operator()(std::string_view v) {
+      w.WriteString(v);
+    }
+    void operator()(std::span<const uint8_t> v) {
+      w.WriteUint8List(v);
+    }
+    void operator()(std::span<const int32_t> v) {
+      w.WriteInt32List(v);
+    }
+    void operator()(std::span<const int64_t> v) {
+      w.WriteInt64List(v);
+    }
+    void operator()(std::span<const float> v) {
+      w.WriteFloat32List(v);
+    }
+    void operator()(std::span<const double> v) {
+      w.WriteFloat64List(v);
+    }
+    void operator()(const StandardList &v) {
+      w.BeginList(v.size());
+      for (const auto &item : v) {
+        w.Write(item);
+      }
+    }
+    void operator()(const StandardMap &v) {
+      w.BeginMap(v.size());
+      for (const auto &entry : v) {
+        w.Write(entry.key);
+        w.Write(entry.value);
+      }
+    }
+  };
+
+  std::visit(Visitor{*this}, value.value);
+}
+
+namespace StandardMethodCodec {
+
+bool DecodeMethodCall(StandardMessageReader &reader, std::string_view *method, StandardValue *arguments) {
+  StandardValue name;
+
+  if (!reader.Read(&name) || name.Get<std::string_view>() == nullptr) {
+    return false;
+  }
+
+  *method = *name.Get<std::string_view>();
+
+  return reader.Read(arguments) && reader.AtEnd();
+}
+
+void EncodeMethodCall(StandardMessageWriter &writer, std::string_view method, const StandardValue &arguments) {
+  writer.WriteString(method);
+  writer.Write(arguments);
+}
+
+void EncodeSuccessEnvelope(StandardMessageWriter &writer, const StandardValue &result) {
+  writer.WriteByte(0);
+  writer.Write(result);
+}
+
+void EncodeErrorEnvelope(StandardMessageWriter &writer, std::string_view code, std::string_view message, const StandardValue &details) {
+  writer.WriteByte(1);
+  writer.WriteString(code);
+
+  if (message.empty()) {
+    writer.WriteNull();
+  } else {
+    writer.WriteString(message);
+  }
+
+  writer.Write(details);
+}
+
+bool DecodeEnvelope(StandardMessageReader &reader, StandardValue *result, StandardMethodError *error, bool *is_error) {
+  uint8_t flag;
+
+  if (!reader.ReadByte(&flag) || flag > 1) {
+    return false;
+  }
+
+  *is_error = flag == 1;
+
+  if (!*is_error) {
+    return reader.Read(result) && reader.AtEnd();
+  }
+
+  StandardValue code, message;
+
+  if (!reader.Read(&code) || code.Get<std::string_view>() == nullptr || !reader.Read(&message) || !reader.Read(&error->details)) {
+    return false;
+  }
+
+  error->code    = *code.Get<std::string_view>();
+  error->message = message.Get<std::string_view>() ? *message.Get<std::string_view>() : std::string_view();
+
+  // Newer framework versions append the stack trace (a string or null).
+  if (!reader.AtEnd()) {
+    StandardValue stacktrace;
+    if (!reader.Read(&stacktrace)) {
+      return false;
+    }
+  }
+
+  return reader.AtEnd();
+}
+
+} // namespace StandardMethodCodec
+
+} // namespace flutter
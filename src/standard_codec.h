@@ -0,0 +1,175 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// StandardMessageCodec (package:flutter/services.dart) for the native channel handlers.
+//
+// Decoding does not copy: strings and typed data lists are views into the message buffer, which
+// therefore has to outlive the decoded values. Typed data which happens to be misaligned in memory
+// (the codec aligns it relative to the start of the message only) is copied into the reader.
+// Encoding appends to a buffer which keeps its capacity across Reset() calls, so a writer reused
+// for every message of a channel stops allocating once it has seen the largest one.
+
+struct StandardValue;
+struct StandardMapEntry;
+
+// Integer too large for int64_t, as its hexadecimal string (not produced by current Dart versions).
+// Kept apart from the strings so that it is re-encoded with its own type tag.
+struct StandardLargeInt {
+  std::string_view hex;
+};
+
+using StandardList = std::vector<StandardValue>;
+using StandardMap  = std::vector<StandardMapEntry>;
+
+struct StandardValue {
+  using Variant = std::variant<std::monostate, bool, int32_t, int64_t, StandardLargeInt, double, std::string_view, std::span<const uint8_t>, std::span<const int32_t>, std::span<const int64_t>, std::span<const float>, std::span<const double>, StandardList,
+                               StandardMap>;
+
+  Variant value;
+
+  bool IsNull() const {
+    return std::holds_alternative<std::monostate>(value);
+  }
+
+  template <typename T> const T *Get() const {
+    return std::get_if<T>(&value);
+  }
+
+  // Either int32_t or int64_t, the codec picks the smallest encoding.
+  bool GetInt(int64_t *out) const;
+
+  // Map lookup by a string key, nullptr if not a map or no such key.
+  const StandardValue *Find(std::string_view key) const;
+};
+
+struct StandardMapEntry {
+  StandardValue key;
+  StandardValue value;
+};
+
+class StandardMessageReader {
+public:
+  StandardMessageReader(const uint8_t *data, size_t size);
+
+  // Returns false if the message is malformed or truncated.
+  bool Read(StandardValue *value);
+
+  bool AtEnd() const {
+    return pos_ == size_;
+  }
+
+  // For the envelopes of the method codec.
+  bool ReadByte(uint8_t *byte);
+
+private:
+  bool ReadSize(size_t *size);
+
+  bool Align(size_t alignment);
+
+  template <typename T> bool ReadScalar(T *value);
+
+  template <typename T> bool ReadTypedList(StandardValue *value);
+
+  const uint8_t *const data_;
+  const size_t size_;
+  size_t pos_   = 0;
+  size_t depth_ = 0;
+  std::deque<std::vector<uint64_t>> copies_; // 8-byte aligned storage for misaligned typed data
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(StandardMessageReader)
+};
+
+class StandardMessageWriter {
+public:
+  StandardMessageWriter() = default;
+
+  // Starts a new message, keeping the allocated capacity.
+  void Reset() {
+    buffer_.clear();
+  }
+
+  const uint8_t *data() const {
+    return buffer_.data();
+  }
+
+  size_t size() const {
+    return buffer_.size();
+  }
+
+  // Exchanges the encoded messages (and capacities) of the two writers.
+  void Swap(StandardMessageWriter &other) {
+    buffer_.swap(other.buffer_);
+  }
+
+  void WriteNull();
+  void WriteBool(bool value);
+  void WriteInt(int64_t value); // int32 if it fits
+  void WriteLargeInt(std::string_view hex);
+  void WriteDouble(double value);
+  void WriteString(std::string_view value);
+  void WriteUint8List(std::span<const uint8_t> value);
+  void WriteInt32List(std::span<const int32_t> value);
+  void WriteInt64List(std::span<const int64_t> value);
+  void WriteFloat32List(std::span<const float> value);
+  void WriteFloat64List(std::span<const double> value);
+
+  // To be followed by size values (lists) or size key/value pairs (maps).
+  void BeginList(size_t size);
+  void BeginMap(size_t size);
+
+  void Write(const StandardValue &value);
+
+  // For the envelopes of the method codec.
+  void WriteByte(uint8_t byte) {
+    buffer_.push_back(byte);
+  }
+
+private:
+  void WriteSize(size_t size);
+
+  void Align(size_t alignment);
+
+  void WriteRaw(const void *data, size_t size);
+
+  std::vector<uint8_t> buffer_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(StandardMessageWriter)
+};
+
+// StandardMethodCodec: method calls and success/error envelopes on top of the message codec.
+struct StandardMethodError {
+  std::string_view code;
+  std::string_view message; // empty if null
+  StandardValue details;
+};
+
+namespace StandardMethodCodec {
+
+bool DecodeMethodCall(StandardMessageReader &reader, std::string_view *method, StandardValue *arguments);
+
+void EncodeMethodCall(StandardMessageWriter &writer, std::string_view method, const StandardValue &arguments);
+
+void EncodeSuccessEnvelope(StandardMessageWriter &writer, const StandardValue &result);
+
+void EncodeErrorEnvelope(StandardMessageWriter &writer, std::string_view code, std::string_view message, const StandardValue &details);
+
+// Returns false if malformed, *is_error tells whether *result or *error has been set.
+bool DecodeEnvelope(StandardMessageReader &reader, StandardValue *result, StandardMethodError *error, bool *is_error);
+
+} // namespace StandardMethodCodec
+
+} // namespace flutter
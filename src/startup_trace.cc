@@ -0,0 +1,130 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <flutter_embedder.h>
+
+#include "debug.h"
+#include "startup_trace.h"
+
+namespace flutter {
+
+static const char *phase_name(const size_t phase) {
+  static const char *const names[] = {
+      "wayland-connect", "egl-setup", "icu-data", "aot-load", "engine-init", "engine-run", "first-present", "first-presented",
+  };
+  static_assert(std::size(names) == static_cast<size_t>(StartupPhase::kCount));
+
+  return phase < std::size(names) ? names[phase] : "unknown";
+}
+
+static void store_once(std::atomic<uint64_t> &slot, const uint64_t value) {
+  uint64_t expected = 0;
+
+  if (slot.load(std::memory_order_relaxed) != 0) {
+    return;
+  }
+
+  slot.compare_exchange_strong(expected, value);
+}
+
+StartupTrace &StartupTrace::Instance() {
+  static StartupTrace instance;
+  return instance;
+}
+
+StartupTrace::StartupTrace()
+    : origin_ns_(FlutterEngineGetCurrentTime()) {
+}
+
+void StartupTrace::SetOrigin(uint64_t origin_ns) {
+  origin_ns_ = origin_ns;
+}
+
+void StartupTrace::SetOriginToProcessStart() {
+  std::ifstream stat_file("/proc/self/stat");
+  std::string stat;
+
+  if (!std::getline(stat_file, stat)) {
+    dbgW("startup: Could not read /proc/self/stat\n");
+    return;
+  }
+
+  // The process name (2nd field) may contain spaces, so start parsing after it; starttime is the 22nd field.
+  const auto comm_end = stat.rfind(')');
+
+  if (comm_end == std::string::npos) {
+    return;
+  }
+
+  std::istringstream fields(stat.substr(comm_end + 1));
+  std::string field;
+  unsigned long long start_ticks = 0;
+
+  for (int i = 3; i <= 22 && fields >> field; i++) {
+    if (i == 22) {
+      start_ticks = std::stoull(field);
+    }
+  }
+
+  const long ticks_per_sec = sysconf(_SC_CLK_TCK);
+  struct timespec boottime;
+
+  if (start_ticks == 0 || ticks_per_sec <= 0 || clock_gettime(CLOCK_BOOTTIME, &boottime) != 0) {
+    return;
+  }
+
+  const uint64_t now_ns        = FlutterEngineGetCurrentTime();
+  const uint64_t boottime_ns   = boottime.tv_sec * 1'000'000'000ULL + boottime.tv_nsec;
+  const uint64_t start_boot_ns = start_ticks * (1'000'000'000ULL / ticks_per_sec);
+
+  if (start_boot_ns < boottime_ns && boottime_ns - start_boot_ns < now_ns) {
+    origin_ns_ = now_ns - (boottime_ns - start_boot_ns);
+  }
+}
+
+void StartupTrace::Begin(StartupPhase phase) {
+  store_once(begin_ns_[static_cast<size_t>(phase)], FlutterEngineGetCurrentTime());
+}
+
+void StartupTrace::End(StartupPhase phase) {
+  store_once(end_ns_[static_cast<size_t>(phase)], FlutterEngineGetCurrentTime());
+}
+
+bool StartupTrace::HasBegun(StartupPhase phase) const {
+  return begin_ns_[static_cast<size_t>(phase)].load(std::memory_order_relaxed) != 0;
+}
+
+void StartupTrace::Dump() {
+  if (dumped_.exchange(true)) {
+    return;
+  }
+
+  const uint64_t origin_ns = origin_ns_;
+  uint64_t last_end_ns     = origin_ns;
+
+  for (size_t i = 0; i < begin_ns_.size(); i++) {
+    const uint64_t begin_ns = begin_ns_[i];
+    const uint64_t end_ns   = end_ns_[i];
+
+    if (begin_ns == 0 || end_ns == 0) {
+      dbgI("startup: %-16s not recorded\n", phase_name(i));
+      continue;
+    }
+
+    dbgI("startup: %-16s start:%9.3fms end:%9.3fms duration:%9.3fms\n", phase_name(i), (begin_ns - origin_ns) / 1e6, (end_ns - origin_ns) / 1e6, (end_ns - begin_ns) / 1e6);
+    last_end_ns = std::max(last_end_ns, end_ns);
+  }
+
+  dbgI("startup: time to first presented frame: %.3fms\n", (last_end_ns - origin_ns) / 1e6);
+}
+
+} // namespace flutter
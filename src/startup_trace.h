@@ -0,0 +1,80 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Startup phases, roughly in the order they complete. Phases running on
+// different threads may overlap (e.g. kICUData/kAOTLoad vs. kWaylandConnect/kEGLSetup).
+enum class StartupPhase {
+  kWaylandConnect = 0,
+  kEGLSetup,
+  kICUData,
+  kAOTLoad,
+  kEngineInitialize,
+  kEngineRun,
+  kFirstPresent,
+  kFirstFramePresented,
+  kCount,
+};
+
+// Records start/end timestamps of the startup phases (FlutterEngineGetCurrentTime() clock)
+// and logs a time-to-first-presented-frame breakdown once the first frame hits the screen.
+// Begin()/End() can be called from any thread, only the first call for each phase is recorded.
+class StartupTrace {
+public:
+  static StartupTrace &Instance();
+
+  // Resets the reference point all the phases are reported relative to.
+  void SetOrigin(uint64_t origin_ns);
+
+  // Uses the process start time (as reported by /proc/self/stat) as the reference point,
+  // so that the time spent in exec() and dynamic linking is accounted for as well.
+  void SetOriginToProcessStart();
+
+  void Begin(StartupPhase phase);
+
+  void End(StartupPhase phase);
+
+  bool HasBegun(StartupPhase phase) const;
+
+  // Logs all the recorded phases, only the first call has any effect.
+  void Dump();
+
+private:
+  StartupTrace();
+
+  std::atomic<uint64_t> origin_ns_;
+  std::array<std::atomic<uint64_t>, static_cast<size_t>(StartupPhase::kCount)> begin_ns_ = {};
+  std::array<std::atomic<uint64_t>, static_cast<size_t>(StartupPhase::kCount)> end_ns_   = {};
+  std::atomic<bool> dumped_                                                              = false;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(StartupTrace)
+};
+
+class ScopedStartupPhase {
+public:
+  explicit ScopedStartupPhase(StartupPhase phase)
+      : phase_(phase) {
+    StartupTrace::Instance().Begin(phase_);
+  }
+
+  ~ScopedStartupPhase() {
+    StartupTrace::Instance().End(phase_);
+  }
+
+private:
+  const StartupPhase phase_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ScopedStartupPhase)
+};
+
+} // namespace flutter
@@ -4,6 +4,8 @@
 
 #include <memory>
 #include <sstream>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
@@ -100,6 +102,23 @@ bool FileExistsAtPath(const std::string &path) {
   return ::access(path.c_str(), R_OK) == 0;
 }
 
+void PrefetchFileAtPath(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1) {
+    dbgW("Could not open %s for prefetching (errno: %d)\n", path.c_str(), errno);
+    return;
+  }
+
+  const int rv = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+  if (rv != 0) {
+    dbgW("posix_fadvise(%s) failed (rv: %d)\n", path.c_str(), rv);
+  }
+
+  ::close(fd);
+}
+
 bool FlutterAssetBundleIsValid(const std::string &bundle_path) {
   if (!FileExistsAtPath(bundle_path)) {
     dbgE("Bundle directory: %s does not exist\n", bundle_path.c_str());
@@ -123,26 +142,6 @@ std::string FlutterGetAppAotElfName() {
   return std::string("../../lib/libapp.so"); // assumes 'flutter build' directory layout
 }
 
-bool FlutterSendMessage(FlutterEngine engine, const char *channel, const uint8_t *message, const size_t message_size) {
-  FlutterPlatformMessageResponseHandle *response_handle = nullptr;
-
-  FlutterPlatformMessage platform_message = {
-      .struct_size     = sizeof(FlutterPlatformMessage),
-      .channel         = channel,
-      .message         = message,
-      .message_size    = message_size,
-      .response_handle = response_handle,
-  };
-
-  FlutterEngineResult message_result = FlutterEngineSendPlatformMessage(engine, &platform_message);
-
-  if (response_handle != nullptr) {
-    FlutterPlatformMessageReleaseResponseHandle(engine, response_handle);
-  }
-
-  return message_result == kSuccess;
-}
-
 void FlutterParseLocale(const std::string &locale, MyFlutterLocale *fl) {
   if (locale.empty() || fl == nullptr) {
     return;
@@ -21,12 +21,13 @@ std::string GetExecutableDirectory();
 
 bool FileExistsAtPath(const std::string &path);
 
+// Asks the kernel to start reading the file into the page cache, returns immediately.
+void PrefetchFileAtPath(const std::string &path);
+
 bool FlutterAssetBundleIsValid(const std::string &bundle_path);
 
 std::string FlutterGetAppAotElfName();
 
-bool FlutterSendMessage(FlutterEngine engine, const char *channel, const uint8_t *message, const size_t message_size);
-
 struct MyFlutterLocale : public FlutterLocale {
   MyFlutterLocale() {
     struct_size   = sizeof(FlutterLocale);
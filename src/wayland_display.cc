@@ -13,11 +13,11 @@
 #include <sys/timerfd.h>
 
 #include <chrono>
+#include <algorithm>
 #include <sstream>
 #include <vector>
 #include <functional>
 
-#include <dlfcn.h>
 #include <climits>
 #include <cstring>
 #include <cassert>
@@ -33,6 +33,8 @@
 #include "keys.h"
 #include "utils.h"
 #include "egl_utils.h"
+#include "reactor.h"
+#include "startup_trace.h"
 #include "wayland_display.h"
 
 #include <sstream>
@@ -53,13 +55,31 @@ DBG_TIMING(
 
 namespace flutter {
 
-static double get_pixel_ratio(int32_t physical_width, int32_t physical_height, int32_t pixels_width, int32_t pixels_height) {
+static double get_pixel_ratio(int32_t physical_width, int32_t physical_height, int32_t pixels_width, int32_t pixels_height, double pixel_ratio) {
 
   if (pixels_width == 0 || physical_height == 0 || pixels_width == 0 || pixels_height == 0) {
     return 1.0;
   }
 
-  return getEnv("FLUTTER_WAYLAND_PIXEL_RATIO", 1.0);
+  return pixel_ratio;
+}
+
+static void wake_up_platform_thread(int event_fd) {
+  const uint64_t value = 1;
+
+  if (write(event_fd, &value, sizeof(value)) != sizeof(value)) {
+    dbgE("Could not wake up the platform thread (errno: %d)\n", errno);
+  }
+}
+
+// Wayland event timestamps are milliseconds of CLOCK_MONOTONIC (wrapping around), as the engine time.
+static void observe_input_latency(uint32_t time_ms) {
+  const uint32_t latency_ms = static_cast<uint32_t>(FlutterEngineGetCurrentTime() / 1'000'000) - time_ms;
+
+  // Anything else comes from a compositor using another clock.
+  if (latency_ms < 10'000) {
+    Metrics::Instance().input_latency.Observe(latency_ms * uint64_t{1'000'000});
+  }
 }
 
 static inline WaylandDisplay *get_wayland_display(void *data, const bool check_non_null = true) {
@@ -90,6 +110,12 @@ const wl_registry_listener WaylandDisplay::kRegistryListener = {
         return;
       }
 
+      if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+        wd->xdg_wm_base_ = static_cast<decltype(xdg_wm_base_)>(wl_registry_bind(wl_registry, name, &xdg_wm_base_interface, 1));
+        xdg_wm_base_add_listener(wd->xdg_wm_base_, &kXdgWmBaseListener, wd);
+        return;
+      }
+
       if (strcmp(interface, "wl_seat") == 0) {
         wd->seat_ = static_cast<decltype(seat_)>(wl_registry_bind(wl_registry, name, &wl_seat_interface, 4));
         wl_seat_add_listener(wd->seat_, &kSeatListener, wd);
@@ -97,7 +123,9 @@ const wl_registry_listener WaylandDisplay::kRegistryListener = {
       }
 
       if (strcmp(interface, "wl_output") == 0) {
-        wd->output_ = static_cast<decltype(output_)>(wl_registry_bind(wl_registry, name, &wl_output_interface, 1));
+        // version 2 is needed for the output.done and output.scale events
+        wd->output.version_ = std::min(version, 2u);
+        wd->output_         = static_cast<decltype(output_)>(wl_registry_bind(wl_registry, name, &wl_output_interface, wd->output.version_));
         wl_output_add_listener(wd->output_, &kOutputListener, wd);
         return;
       }
@@ -108,6 +136,11 @@ const wl_registry_listener WaylandDisplay::kRegistryListener = {
         return;
       }
 
+      if (strcmp(interface, wp_viewporter_interface.name) == 0) {
+        wd->viewporter_ = static_cast<decltype(viewporter_)>(wl_registry_bind(wl_registry, name, &wp_viewporter_interface, 1));
+        return;
+      }
+
       if (strcmp(interface, zwp_xwayland_keyboard_grab_manager_v1_interface.name) == 0) {
         wd->kbd_grab_manager_ = static_cast<decltype(kbd_grab_manager_)>(wl_registry_bind(wl_registry, name, &zwp_xwayland_keyboard_grab_manager_v1_interface, 1));
         return;
@@ -132,20 +165,9 @@ const wl_shell_surface_listener WaylandDisplay::kShellSurfaceListener = {
       if (wd == nullptr)
         return;
 
-      if (wd->window_ == nullptr)
-        return;
-
-      wl_egl_window_resize(wd->window_, wd->screen_width_ = width, wd->screen_height_ = height, 0, 0);
+      dbgI("shell.configure: %dx%d\n", width, height);
 
-      FlutterWindowMetricsEvent event = {};
-      event.struct_size               = sizeof(event);
-      event.width                     = wd->screen_width_;
-      event.height                    = wd->screen_height_;
-      event.pixel_ratio               = get_pixel_ratio(wd->physical_width_, wd->physical_height_, wd->screen_width_, wd->screen_height_);
-
-      auto success = FlutterEngineSendWindowMetricsEvent(wd->engine_, &event) == kSuccess;
-
-      dbgI("shell.configure: %zdx%zd par: %.3g status: %s\n", event.width, event.height, event.pixel_ratio, (success ? "success" : "failed"));
+      wd->RequestResize(width * wd->output.scale_, height * wd->output.scale_);
     },
 
     .popup_done = [](void *data, struct wl_shell_surface *wl_shell_surface) -> void {
@@ -153,6 +175,48 @@ const wl_shell_surface_listener WaylandDisplay::kShellSurfaceListener = {
     },
 };
 
+const xdg_wm_base_listener WaylandDisplay::kXdgWmBaseListener = {
+    .ping =
+        [](void *data, struct xdg_wm_base *xdg_wm_base, uint32_t serial) {
+          xdg_wm_base_pong(xdg_wm_base, serial);
+        },
+};
+
+const xdg_surface_listener WaylandDisplay::kXdgSurfaceListener = {
+    .configure =
+        [](void *data, struct xdg_surface *xdg_surface, uint32_t serial) {
+          WaylandDisplay *const wd = get_wayland_display(data);
+
+          // ends the configure sequence started by xdg_toplevel.configure
+          wd->resize.pending_    = true;
+          wd->resize.ack_needed_ = true;
+          wd->resize.serial_     = serial;
+        },
+};
+
+const xdg_toplevel_listener WaylandDisplay::kXdgToplevelListener = {
+    .configure =
+        [](void *data, struct xdg_toplevel *xdg_toplevel, int32_t width, int32_t height, struct wl_array *states) {
+          WaylandDisplay *const wd = get_wayland_display(data);
+
+          dbgI("xdg_toplevel.configure: %dx%d\n", width, height);
+
+          // 0x0 means we are free to pick the size on our own
+          if (width > 0 && height > 0) {
+            wd->resize.width_  = width * wd->output.scale_;
+            wd->resize.height_ = height * wd->output.scale_;
+          }
+        },
+    .close =
+        [](void *data, struct xdg_toplevel *xdg_toplevel) {
+          WaylandDisplay *const wd = get_wayland_display(data);
+
+          dbgI("xdg_toplevel.close\n");
+
+          wd->valid_ = false;
+        },
+};
+
 const wl_pointer_listener WaylandDisplay::kPointerListener = {
     .enter = [](void *data, struct wl_pointer *wl_pointer, uint32_t serial, struct wl_surface *surface, wl_fixed_t surface_x, wl_fixed_t surface_y) {},
 
@@ -160,6 +224,10 @@ const wl_pointer_listener WaylandDisplay::kPointerListener = {
         [](void *data, struct wl_pointer *wl_pointer, uint32_t serial, struct wl_surface *surface) {
           WaylandDisplay *const wd = get_wayland_display(data);
 
+          if (!wd->OnInputEvent({.type = InputEvent::kPointerLeave})) {
+            return;
+          }
+
           wd->key_modifiers = static_cast<GdkModifierType>(0);
         },
 
@@ -167,6 +235,10 @@ const wl_pointer_listener WaylandDisplay::kPointerListener = {
         [](void *data, struct wl_pointer *wl_pointer, uint32_t time, wl_fixed_t surface_x, wl_fixed_t surface_y) {
           WaylandDisplay *const wd = get_wayland_display(data);
 
+          if (!wd->OnInputEvent({.type = InputEvent::kPointerMotion, .time = time, .args = {static_cast<uint32_t>(surface_x), static_cast<uint32_t>(surface_y)}})) {
+            return;
+          }
+
           // just store raw values
           wd->surface_x = surface_x;
           wd->surface_y = surface_y;
@@ -176,15 +248,22 @@ const wl_pointer_listener WaylandDisplay::kPointerListener = {
         [](void *data, struct wl_pointer *wl_pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state) {
           WaylandDisplay *const wd = get_wayland_display(data);
 
+          if (!wd->OnInputEvent({.type = InputEvent::kPointerButton, .time = time, .args = {button, state}})) {
+            return;
+          }
+
           uint32_t button_number = button - BTN_LEFT;
           button_number          = button_number == 1 ? 2 : button_number == 2 ? 1 : button_number;
 
+          // surface local coordinates -> physical pixels of the rendered frame
+          const double scale = wd->SurfaceToRenderScale();
+
           FlutterPointerEvent event = {
               .struct_size    = sizeof(event),
               .phase          = state == WL_POINTER_BUTTON_STATE_PRESSED ? FlutterPointerPhase::kDown : FlutterPointerPhase::kUp,
               .timestamp      = time * 1'000,
-              .x              = wl_fixed_to_double(wd->surface_x),
-              .y              = wl_fixed_to_double(wd->surface_y),
+              .x              = wl_fixed_to_double(wd->surface_x) * scale,
+              .y              = wl_fixed_to_double(wd->surface_y) * scale,
               .device         = 0,
               .signal_kind    = kFlutterPointerSignalKindNone,
               .scroll_delta_x = 0,
@@ -194,6 +273,8 @@ const wl_pointer_listener WaylandDisplay::kPointerListener = {
           };
 
           FlutterEngineSendPointerEvent(wd->engine_, &event, 1);
+          Metrics::Instance().input_pointer_events.Add();
+          observe_input_latency(time);
         },
 
     .axis = [](void *data, struct wl_pointer *wl_pointer, uint32_t time, uint32_t axis, wl_fixed_t value) {},
@@ -231,10 +312,14 @@ const wl_keyboard_listener WaylandDisplay::kKeyboardListener = {
         [](void *data, struct wl_keyboard *wl_keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state_w) {
           WaylandDisplay *const wd = get_wayland_display(data);
 
+          if (!wd->OnInputEvent({.type = InputEvent::kKey, .time = time, .args = {key, state_w}})) {
+            return;
+          }
+
           uint32_t repeat_delay_ms_   = 0;
           uint32_t repeat_interval_ms = 0;
 
-          if (wd->key_handler(wd->key.last_ = key, wd->key.state_ = state_w)) {
+          if (wd->key_handler(wd->key.last_ = key, wd->key.state_ = state_w, false, time)) {
             repeat_delay_ms_   = wd->key.repeat_delay_ms_;
             repeat_interval_ms = wd->key.repeat_interval_ms_;
           }
@@ -253,6 +338,10 @@ const wl_keyboard_listener WaylandDisplay::kKeyboardListener = {
         [](void *data, struct wl_keyboard *wl_keyboard, uint32_t serial, uint32_t mods_depressed, uint32_t mods_latched, uint32_t mods_locked, uint32_t group) {
           WaylandDisplay *const wd = get_wayland_display(data);
 
+          if (!wd->OnInputEvent({.type = InputEvent::kKeyModifiers, .args = {mods_depressed, mods_latched, mods_locked, group}})) {
+            return;
+          }
+
           xkb_state_update_mask(wd->xkb_state, mods_depressed, mods_latched, mods_locked, group, 0, 0);
         },
 
@@ -318,29 +407,42 @@ const wl_output_listener WaylandDisplay::kOutputListener = {
         [](void *data, struct wl_output *wl_output, uint32_t flags, int32_t width, int32_t height, int32_t refresh) {
           WaylandDisplay *const wd = get_wayland_display(data);
 
-          wd->vsync.vblank_time_ns_ = 1'000'000'000'000 / refresh;
+          dbgI("output.mode(data:%p, wl_output:%p, flags:%d, width:%d, height:%d, refresh:%d)\n", data, static_cast<void *>(wl_output), flags, width, height, refresh);
 
-          dbgI("output.mode(data:%p, wl_output:%p, flags:%d, width:%d->%d, height:%d->%d, refresh:%d)\n", data, static_cast<void *>(wl_output), flags, wd->screen_width_, width, wd->screen_height_, height, refresh);
-
-          if (wd->engine_) {
-            FlutterWindowMetricsEvent event = {};
-            event.struct_size               = sizeof(event);
-            event.width                     = (wd->screen_width_ = width);
-            event.height                    = (wd->screen_height_ = height);
-            event.pixel_ratio               = get_pixel_ratio(wd->physical_width_, wd->physical_height_, wd->screen_width_, wd->screen_height_);
+          if (!(flags & WL_OUTPUT_MODE_CURRENT)) {
+            return;
+          }
 
-            auto success = FlutterEngineSendWindowMetricsEvent(wd->engine_, &event) == kSuccess;
+          if (refresh > 0) {
+            wd->vsync.vblank_time_ns_ = 1'000'000'000'000 / refresh;
+          }
 
-            wl_egl_window_resize(wd->window_, wd->screen_width_, wd->screen_height_, 0, 0);
+          wd->output.mode_width_  = width;
+          wd->output.mode_height_ = height;
 
-            dbgI("Window resized: %zdx%zd par: %.3g status: %s.\n", event.width, event.height, event.pixel_ratio, (success ? "success" : "failed"));
-          } else {
-            wd->window_metrix_skipped_ = true;
-            dbgI("Window resized: %dx%d status: %s.\n", wd->screen_width_, wd->screen_width_, "skipped");
+          // output.done is not available before version 2, so this is all we get
+          if (wd->output.version_ < 2) {
+            wd->output.done_ = true;
+            wd->ApplyOutputMode();
           }
         },
-    .done  = [](void *data, struct wl_output *wl_output) { printf("output.done(data:%p, wl_output:%p)\n", data, static_cast<void *>(wl_output)); },
-    .scale = [](void *data, struct wl_output *wl_output, int32_t factor) { printf("output.scale(data:%p, wl_output:%p, factor:%d)\n", data, static_cast<void *>(wl_output), factor); },
+    .done =
+        [](void *data, struct wl_output *wl_output) {
+          WaylandDisplay *const wd = get_wayland_display(data);
+
+          dbgI("output.done(data:%p, wl_output:%p)\n", data, static_cast<void *>(wl_output));
+
+          wd->output.done_ = true;
+          wd->ApplyOutputMode();
+        },
+    .scale =
+        [](void *data, struct wl_output *wl_output, int32_t factor) {
+          WaylandDisplay *const wd = get_wayland_display(data);
+
+          dbgI("output.scale(data:%p, wl_output:%p, factor:%d)\n", data, static_cast<void *>(wl_output), factor);
+
+          wd->output.scale_ = factor;
+        },
 };
 
 const struct wp_presentation_feedback_listener WaylandDisplay::kPresentationFeedbackListener = {
@@ -351,6 +453,8 @@ const struct wp_presentation_feedback_listener WaylandDisplay::kPresentationFeed
 
           const uint64_t new_last_frame_ns = (((static_cast<uint64_t>(tv_sec_hi) << 32) + tv_sec_lo) * 1'000'000'000) + tv_nsec;
 
+          Metrics::Instance().frames_presented.Add();
+
           if (refresh != wd->vsync.vblank_time_ns_) {
             static auto displayed = false;
 
@@ -368,12 +472,33 @@ const struct wp_presentation_feedback_listener WaylandDisplay::kPresentationFeed
             t0 = t1;
           })
 
+          if (wd->resolution_controller_ && wd->vsync.last_frame_ != 0 && wd->resolution_controller_->OnFramePresented(new_last_frame_ns - wd->vsync.last_frame_, refresh ? refresh : wd->vsync.vblank_time_ns_)) {
+            wd->OnRenderScaleChanged();
+          }
+
+          if (wd->input.replayer_ && wd->vsync.last_frame_ != 0) {
+            wd->input.replayer_->OnFramePresented(new_last_frame_ns - wd->vsync.last_frame_, refresh ? refresh : wd->vsync.vblank_time_ns_);
+          }
+
           wd->vsync.last_frame_ = new_last_frame_ns;
+
+          if (StartupTrace::Instance().HasBegun(StartupPhase::kFirstFramePresented)) {
+            StartupTrace::Instance().End(StartupPhase::kFirstFramePresented);
+            StartupTrace::Instance().Dump();
+          }
         },
     .discarded =
         [](void *data, struct wp_presentation_feedback *wp_presentation_feedback) {
+          WaylandDisplay *const wd = get_wayland_display(data);
+
+          Metrics::Instance().frames_discarded.Add();
+
           // TODO: remove it
           dbgW("presentation.frame dropped\n");
+
+          if (wd->resolution_controller_ && wd->resolution_controller_->OnFrameDiscarded()) {
+            wd->OnRenderScaleChanged();
+          }
         },
 }; // namespace flutter
 
@@ -388,7 +513,7 @@ const struct wp_presentation_listener WaylandDisplay::kPresentationListener = {
         },
 };
 
-bool WaylandDisplay::key_handler(const uint32_t key, const uint32_t state_w, const bool is_repeat) {
+bool WaylandDisplay::key_handler(const uint32_t key, const uint32_t state_w, const bool is_repeat, const uint32_t time) {
   if (keymap_format == WL_KEYBOARD_KEYMAP_FORMAT_NO_KEYMAP) {
     dbgW("key: Hmm - no keymap, no key event\n");
     return false;
@@ -464,10 +589,17 @@ bool WaylandDisplay::key_handler(const uint32_t key, const uint32_t state_w, con
   message += "}";
 
   if (!message.empty()) {
-    bool success = FlutterSendMessage(engine_, "flutter/keyevent", reinterpret_cast<const uint8_t *>(message.c_str()), message.size());
+    bool success = channels_->Send("flutter/keyevent", reinterpret_cast<const uint8_t *>(message.c_str()), message.size());
 
     if (!success) {
       dbgE("Error sending PlatformMessage: %s\n", message.c_str());
+    } else {
+      Metrics::Instance().input_key_events.Add();
+
+      // The repeated ones have no timestamp.
+      if (!is_repeat) {
+        observe_input_latency(time);
+      }
     }
   }
 
@@ -483,6 +615,95 @@ WaylandDisplay::WaylandDisplay(size_t width, size_t height, const std::string &b
     return;
   }
 
+  pixel_ratio_ = getEnv("FLUTTER_WAYLAND_PIXEL_RATIO", 0.0);
+
+  // The main UI covers the whole screen, so there is nothing to blend it with.
+  opaque_ = getEnv("FLUTTER_WAYLAND_OPAQUE", getEnv("FLUTTER_WAYLAND_MAIN_UI", 0.)) != 0.;
+
+  egl_config_policy_.format = opaque_ ? EGLConfigPolicy::Format::kXRGB8888 : EGLConfigPolicy::Format::kARGB8888;
+
+  const auto pixel_format = getEnv("FLUTTER_WAYLAND_PIXEL_FORMAT", std::string());
+
+  if (pixel_format != "" && !ParseEGLConfigFormat(pixel_format, &egl_config_policy_.format)) {
+    dbgW("Invalid FLUTTER_WAYLAND_PIXEL_FORMAT: %s, using %s\n", pixel_format.c_str(), EGLConfigFormatName(egl_config_policy_.format));
+  }
+
+  // Formats without alpha can't be blended anyway, let the compositor know. An explicit opaque
+  // request stays in effect with an alpha format too.
+  opaque_ = opaque_ || egl_config_policy_.format != EGLConfigPolicy::Format::kARGB8888;
+
+  egl_config_policy_.stencil_size = static_cast<EGLint>(getEnv("FLUTTER_WAYLAND_STENCIL_SIZE", 0.));
+  egl_config_policy_.samples      = static_cast<EGLint>(getEnv("FLUTTER_WAYLAND_MSAA_SAMPLES", 0.));
+
+  const auto headless_mode = getEnv("FLUTTER_WAYLAND_HEADLESS", std::string());
+
+  if (headless_mode != "") {
+    headless_ = std::make_unique<HeadlessOutput>(headless_mode, getEnv("FLUTTER_WAYLAND_HEADLESS_DUMP_FRAMES", std::string()), getEnv("FLUTTER_WAYLAND_HEADLESS_DUMP_DIR", std::string()));
+
+    if (!headless_->IsValid()) {
+      return;
+    }
+
+    egl_config_policy_.surface_type = EGL_PBUFFER_BIT;
+  }
+
+  render.scale_ = getEnv("FLUTTER_WAYLAND_RENDER_SCALE", 1.0);
+
+  if (!(render.scale_ > 0.0 && render.scale_ <= 1.0)) {
+    dbgW("Invalid FLUTTER_WAYLAND_RENDER_SCALE: %g, using 1.0\n", render.scale_);
+    render.scale_ = 1.0;
+  }
+
+  if (getEnv("FLUTTER_WAYLAND_DYNAMIC_RESOLUTION", 0.) != 0.) {
+    ResolutionController::Config config;
+    config.max_scale = render.scale_;
+    // Render scales below 0.1 are valid, they are only never stepped down.
+    config.min_scale = std::clamp(getEnv("FLUTTER_WAYLAND_MIN_RENDER_SCALE", 0.5), std::min(0.1, render.scale_), render.scale_);
+
+    dbgI("Dynamic resolution: render scale range: [%.3g, %.3g]\n", config.min_scale, config.max_scale);
+
+    resolution_controller_ = std::make_unique<ResolutionController>(config);
+  }
+
+  const auto metrics_socket = getEnv("FLUTTER_LAUNCHER_WAYLAND_METRICS_SOCKET", std::string());
+
+  if (metrics_socket != "") {
+    metrics_server_ = std::make_unique<MetricsServer>(metrics_socket);
+
+    if (!metrics_server_->IsValid()) {
+      dbgW("metrics: not serving the runtime counters\n");
+      metrics_server_.reset();
+    }
+  }
+
+  const auto benchmark_frames = static_cast<size_t>(std::max(getEnv("FLUTTER_WAYLAND_BENCHMARK_FRAMES", 0.), 0.));
+
+  if (benchmark_frames > 0) {
+    benchmark_ = std::make_unique<FrameBenchmark>(benchmark_frames, getEnv("FLUTTER_WAYLAND_BENCHMARK_RATE", 0.));
+  }
+
+  event_loop_._task_budget_ns = static_cast<uint64_t>(std::max(getEnv("FLUTTER_WAYLAND_TASK_BUDGET_US", 4000.), 0.) * 1000);
+  event_loop_._slow_task_ns   = static_cast<uint64_t>(std::max(getEnv("FLUTTER_WAYLAND_SLOW_TASK_MS", 0.), 0.) * 1e6);
+
+  const auto input_record = getEnv("FLUTTER_WAYLAND_INPUT_RECORD", std::string());
+  const auto input_replay = getEnv("FLUTTER_WAYLAND_INPUT_REPLAY", std::string());
+
+  if (input_replay != "") {
+    const double linger_s = getEnv("FLUTTER_WAYLAND_INPUT_REPLAY_EXIT", 0.);
+
+    input.replayer_ = std::make_unique<InputReplayer>(input_replay, std::max(getEnv("FLUTTER_WAYLAND_INPUT_REPLAY_SPEED", 1.0), 0.0), static_cast<uint64_t>(std::max(linger_s, 0.) * 1e9));
+    input.exit_     = linger_s > 0.;
+
+    if (!input.replayer_->IsValid()) {
+      input.replayer_.reset();
+    }
+  } else if (input_record != "") {
+    input.recorder_ = std::make_unique<InputRecorder>(input_record);
+  }
+
+  // Nothing below depends on the ICU data nor on the AOT snapshot until the engine gets initialized.
+  engine_assets_ = std::async(std::launch::async, &WaylandDisplay::LoadEngineAssets, bundle_path);
+
   if (socketpair(AF_LOCAL, SOCK_DGRAM | SOCK_CLOEXEC, 0, &vsync.sv_[0]) == -1) {
     dbgE("socketpair() failed, errno: %d\n", errno);
     return;
@@ -495,27 +716,47 @@ WaylandDisplay::WaylandDisplay(size_t width, size_t height, const std::string &b
     return;
   }
 
-  display_ = wl_display_connect(nullptr);
+  if (headless_) {
+    // As if an output of this mode was connected, at 96 dpi.
+    screen_width_         = headless_->Width();
+    screen_height_        = headless_->Height();
+    physical_width_       = screen_width_ * 254 / 960;
+    physical_height_      = screen_height_ * 254 / 960;
+    vsync.vblank_time_ns_ = headless_->VblankNs();
+  } else {
+    ScopedStartupPhase phase(StartupPhase::kWaylandConnect);
 
-  if (!display_) {
-    dbgE("Could not connect to the wayland display\n");
-    return;
-  }
+    display_ = wl_display_connect(nullptr);
 
-  registry_ = wl_display_get_registry(display_);
+    if (!display_) {
+      dbgE("Could not connect to the wayland display\n");
+      return;
+    }
 
-  if (!registry_) {
-    dbgE("Could not get the wayland registry\n");
-    return;
-  }
+    registry_ = wl_display_get_registry(display_);
 
-  wl_registry_add_listener(registry_, &kRegistryListener, this);
+    if (!registry_) {
+      dbgE("Could not get the wayland registry\n");
+      return;
+    }
 
-  wl_display_roundtrip(display_);
+    wl_registry_add_listener(registry_, &kRegistryListener, this);
 
-  if (!SetupEGL()) {
-    dbgE("Could not setup EGL.\n");
-    return;
+    wl_display_roundtrip(display_);
+
+    // Lay out and render the very first frame with the actual output size.
+    if (!WaitForOutputConfiguration(static_cast<int>(getEnv("FLUTTER_WAYLAND_OUTPUT_WAIT_MS", 500.)))) {
+      dbgW("No output configuration received, using the default size: %dx%d\n", screen_width_, screen_height_);
+    }
+  }
+
+  {
+    ScopedStartupPhase phase(StartupPhase::kEGLSetup);
+
+    if (!SetupEGL()) {
+      dbgE("Could not setup EGL.\n");
+      return;
+    }
   }
 
   if (!SetupEngine(bundle_path, command_line_args)) {
@@ -527,6 +768,46 @@ WaylandDisplay::WaylandDisplay(size_t width, size_t height, const std::string &b
   valid_ = true;
 }
 
+WaylandDisplay::EngineAssets WaylandDisplay::LoadEngineAssets(const std::string &bundle_path) {
+  EngineAssets assets;
+
+  {
+    ScopedStartupPhase phase(StartupPhase::kICUData);
+
+    assets.icu_data_path = GetICUDataPath();
+
+    if (assets.icu_data_path == "") {
+      return assets;
+    }
+
+    // The engine maps the file on its own, just make sure it's (being) read into the page cache by then.
+    PrefetchFileAtPath(assets.icu_data_path);
+  }
+
+  if (FlutterEngineRunsAOTCompiledDartCode()) {
+    ScopedStartupPhase phase(StartupPhase::kAOTLoad);
+
+    dbgI("Using AOT precompiled runtime\n");
+
+    std::string libapp_aot_path = bundle_path + "/" + FlutterGetAppAotElfName(); // dw: TODO: There seems to be no convention name we could use, so let's temporary hardcode the path.
+
+    if (std::ifstream(libapp_aot_path)) {
+      dbgI("Loading AOT snapshot: %s\n", libapp_aot_path.c_str());
+
+      const char *error = nullptr;
+      auto handle       = Aot_LoadELF(libapp_aot_path.c_str(), 0, &error, &assets.vm_snapshot_data, &assets.vm_snapshot_instructions, &assets.isolate_snapshot_data, &assets.isolate_snapshot_instructions);
+
+      if (!handle) {
+        dbgE("Could not load AOT library: %s (error: %s).\n", libapp_aot_path.c_str(), error ? error : "");
+        return assets;
+      }
+    }
+  }
+
+  assets.valid = true;
+  return assets;
+}
+
 bool WaylandDisplay::SetupEngine(const std::string &bundle_path, const std::vector<std::string> &command_line_args) {
   FlutterRendererConfig config = {};
   config.type                  = kOpenGL;
@@ -540,6 +821,12 @@ bool WaylandDisplay::SetupEngine(const std::string &bundle_path, const std::vect
       return false;
     }
 
+    // The swap interval applies to the surface bound on the calling (raster) thread.
+    if (wd->benchmark_ && eglSwapInterval(wd->egl_display_, 0) != EGL_TRUE) {
+      LogLastEGLError();
+      dbgW("benchmark: could not disable the swap interval\n");
+    }
+
     return true;
   };
   config.open_gl.clear_current = [](void *data) -> bool {
@@ -558,12 +845,25 @@ bool WaylandDisplay::SetupEngine(const std::string &bundle_path, const std::vect
 
     DBG_TIMING(static auto tprev = FlutterEngineGetCurrentTime(); auto tb = FlutterEngineGetCurrentTime(); dbgI("[%09.4f][%ld] >>> swap buffer [%09.4f]\n", (tb - t00) / 1e9, gettid(), (tb - tprev) / 1e9););
 
+    // Read back before the swap, the pbuffer content is undefined after it.
+    if (wd->headless_ && wd->headless_->OnFrameRendered()) {
+      wake_up_platform_thread(wd->event_loop_._platform_event_loop_eventfd);
+    }
+
     if (eglSwapBuffers(wd->egl_display_, wd->egl_surface_) != EGL_TRUE) {
       LogLastEGLError();
       dbgE("Could not swap the EGL buffer\n");
       return false;
     }
 
+    StartupTrace::Instance().End(StartupPhase::kFirstPresent);
+    StartupTrace::Instance().Begin(StartupPhase::kFirstFramePresented);
+
+    // Wakes up the platform thread to report and exit.
+    if (wd->benchmark_ && wd->benchmark_->OnPresent(FlutterEngineGetCurrentTime())) {
+      wake_up_platform_thread(wd->event_loop_._platform_event_loop_eventfd);
+    }
+
     DBG_TIMING(auto ta = FlutterEngineGetCurrentTime(); dbgI("[%09.4f][%ld] <<< swap buffer [dur:%09.4f]\n", (ta - t00) / 1e9, gettid(), (ta - tb) / 1e9); tprev = tb;);
 
     return true;
@@ -572,36 +872,22 @@ bool WaylandDisplay::SetupEngine(const std::string &bundle_path, const std::vect
   config.open_gl.make_resource_current = [](void *data) -> bool {
     WaylandDisplay *const wd = get_wayland_display(data);
 
-    if (eglMakeCurrent(wd->egl_display_, wd->resource_egl_surface_, wd->resource_egl_surface_, wd->resource_egl_context_) != EGL_TRUE) {
-      LogLastEGLError();
-      dbgE("Could not make the RESOURCE context current\n");
-      return false;
-    }
-
-    return true;
+    return wd->resource_contexts_ && wd->resource_contexts_->MakeCurrent();
   };
 
   config.open_gl.gl_proc_resolver = [](void *data, const char *name) -> void * {
-    auto address = eglGetProcAddress(name);
-    if (address != nullptr) {
-      return reinterpret_cast<void *>(address);
-    }
-
-    dbgW("Using dlsym fallback to resolve: %s\n.", name ? name : "");
-
-    address = reinterpret_cast<void (*)()>(dlsym(RTLD_DEFAULT, name));
+    return ResourceContextPool::InterceptGLProc(name, ResolveGLProc(name));
+  };
 
-    if (address != nullptr) {
-      return reinterpret_cast<void *>(address);
-    }
+  config.open_gl.gl_external_texture_frame_callback = [](void *data, int64_t texture_id, size_t width, size_t height, FlutterOpenGLTexture *texture) -> bool {
+    WaylandDisplay *const wd = get_wayland_display(data);
 
-    dbgW("Tried unsuccessfully to resolve: %s\n.", name ? name : "");
-    return nullptr;
+    return wd->external_textures_ && wd->external_textures_->Populate(texture_id, width, height, texture);
   };
 
-  auto icu_data_path = GetICUDataPath();
+  const auto assets = engine_assets_.get();
 
-  if (icu_data_path == "") {
+  if (!assets.valid) {
     return false;
   }
 
@@ -614,9 +900,16 @@ bool WaylandDisplay::SetupEngine(const std::string &bundle_path, const std::vect
   FlutterProjectArgs args = {
       .struct_size       = sizeof(FlutterProjectArgs),
       .assets_path       = bundle_path.c_str(),
-      .icu_data_path     = icu_data_path.c_str(),
+      .icu_data_path     = assets.icu_data_path.c_str(),
       .command_line_argc = static_cast<int>(command_line_args_c.size()),
       .command_line_argv = command_line_args_c.data(),
+      .platform_message_callback = [](const FlutterPlatformMessage *message, void *data) -> void {
+        WaylandDisplay *const wd = get_wayland_display(data);
+
+        if (wd->channels_) {
+          wd->channels_->OnPlatformMessage(message);
+        }
+      },
       .vsync_callback    = [](void *data, intptr_t baton) -> void {
         WaylandDisplay *const wd = get_wayland_display(data);
 
@@ -630,7 +923,10 @@ bool WaylandDisplay::SetupEngine(const std::string &bundle_path, const std::vect
           exit(1);
         }
 
-        wd->vsync.baton_ = baton;
+        Metrics::Instance().frames_requested.Add();
+
+        wd->vsync.baton_ns_ = FlutterEngineGetCurrentTime();
+        wd->vsync.baton_    = baton;
 
         if (wd->vSyncSendNotifyData() != 1) {
           exit(1);
@@ -661,38 +957,57 @@ bool WaylandDisplay::SetupEngine(const std::string &bundle_path, const std::vect
     exit(1);
   }
 
-  std::string libapp_aot_path = bundle_path + "/" + FlutterGetAppAotElfName(); // dw: TODO: There seems to be no convention name we could use, so let's temporary hardcode the path.
+  args.vm_snapshot_data              = assets.vm_snapshot_data;
+  args.vm_snapshot_instructions      = assets.vm_snapshot_instructions;
+  args.isolate_snapshot_data         = assets.isolate_snapshot_data;
+  args.isolate_snapshot_instructions = assets.isolate_snapshot_instructions;
 
-  if (FlutterEngineRunsAOTCompiledDartCode()) {
-    dbgI("Using AOT precompiled runtime\n");
+  StartupTrace::Instance().Begin(StartupPhase::kEngineInitialize);
+  auto result = FlutterEngineInitialize(FLUTTER_ENGINE_VERSION, &config, &args, this /* userdata */, &engine_);
+  StartupTrace::Instance().End(StartupPhase::kEngineInitialize);
 
-    if (std::ifstream(libapp_aot_path)) {
-      dbgI("Loading AOT snapshot: %s\n", libapp_aot_path.c_str());
+  if (result != kSuccess) {
+    dbgE("Could not initialize the Flutter engine.\n");
+    return false;
+  }
 
-      const char *error;
-      auto handle = Aot_LoadELF(libapp_aot_path.c_str(), 0, &error, &args.vm_snapshot_data, &args.vm_snapshot_instructions, &args.isolate_snapshot_data, &args.isolate_snapshot_instructions);
+  external_textures_ = std::make_unique<ExternalTextureRegistry>(engine_);
 
-      if (!handle) {
-        dbgE("Could not load AOT library: %s (error: %s).\n", libapp_aot_path.c_str(), error ? error : "");
-        return false;
-      }
-    }
+  const auto channel_workers = static_cast<size_t>(std::clamp(getEnv("FLUTTER_WAYLAND_CHANNEL_WORKERS", 2.), 0., 16.));
+  channels_                  = std::make_unique<ChannelDispatcher>(engine_, channel_workers, 64 /* max queued messages */);
+
+  const auto plugin_path = getEnv("FLUTTER_WAYLAND_PLUGIN_PATH", std::string());
+
+  if (plugin_path != "") {
+    // Only the manifests are read here, the plugins are loaded on their first message.
+    plugins_ = std::make_unique<PluginHost>(*channels_, *event_loop_._platform_event_loop);
+    plugins_->Scan(plugin_path);
   }
 
-  auto result = FlutterEngineInitialize(FLUTTER_ENGINE_VERSION, &config, &args, this /* userdata */, &engine_);
+  dart_ports_ = std::make_unique<DartPortBridge>(engine_, *channels_, getEnv("FLUTTER_WAYLAND_DART_PORT_BATCHING", 1.) != 0., event_loop_._platform_event_loop_eventfd);
 
-  if (result != kSuccess) {
-    dbgE("Could not initialize the Flutter engine.\n");
-    return false;
+  const auto shared_blob_pool_mb = static_cast<size_t>(std::max(getEnv("FLUTTER_WAYLAND_SHARED_BLOB_POOL_MB", 64.), 0.));
+
+  if (shared_blob_pool_mb > 0) {
+    // Reclamation of the released blobs is driven by the platform event loop.
+    shared_blobs_ = std::make_unique<SharedBlobPool>(shared_blob_pool_mb << 20, event_loop_._platform_event_loop_eventfd);
+
+    if (!shared_blobs_->IsValid()) {
+      shared_blobs_.reset();
+    }
   }
 
+  StartupTrace::Instance().Begin(StartupPhase::kEngineRun);
   result = FlutterEngineRunInitialized(engine_);
+  StartupTrace::Instance().End(StartupPhase::kEngineRun);
 
   if (result != kSuccess) {
     dbgE("Could not run the Flutter engine.\n");
     return false;
   }
 
+  StartupTrace::Instance().Begin(StartupPhase::kFirstPresent);
+
   {
     MyFlutterLocale fl;
     std::string lang = getEnv("LANG", std::string(""));
@@ -713,24 +1028,216 @@ bool WaylandDisplay::SetupEngine(const std::string &bundle_path, const std::vect
 
   SetupMemoryWatcher();
 
-  if (window_metrix_skipped_) {
-    FlutterWindowMetricsEvent event = {};
+  // The one and only metrics event before the first frame, later ones are sent only on actual changes.
+  return SendWindowMetrics();
+}
+
+// Keeps the logical size of the UI independent of the internal render resolution.
+double WaylandDisplay::PixelRatio() const {
+  return get_pixel_ratio(physical_width_, physical_height_, render.width_, render.height_, pixel_ratio_ > 0.0 ? pixel_ratio_ : output.scale_) * render.scale_;
+}
+
+bool WaylandDisplay::SendWindowMetrics() {
+  if (!engine_) {
+    return false;
+  }
+
+  FlutterWindowMetricsEvent event = {};
+
+  event.struct_size = sizeof(event);
+  event.width       = render.width_;
+  event.height      = render.height_;
+  event.pixel_ratio = PixelRatio();
+
+  const auto success = FlutterEngineSendWindowMetricsEvent(engine_, &event) == kSuccess;
+
+  if (success) {
+    sent_pixel_ratio_ = event.pixel_ratio;
+  }
+
+  dbgI("Window metrics: %zdx%zd par: %.3g status: %s\n", event.width, event.height, event.pixel_ratio, (success ? "success" : "failed"));
+
+  return success;
+}
+
+bool WaylandDisplay::WaitForOutputConfiguration(int timeout_ms) {
+  if (!output_) {
+    return false;
+  }
+
+  // The compositor sends the whole output configuration right after the bind, so the sync callback
+  // fires after it anyway (output.done is not available on version 1 outputs).
+  static const wl_callback_listener sync_listener = {
+      .done =
+          [](void *data, struct wl_callback *cb, uint32_t callback_data) {
+            wl_callback_destroy(cb);
+            *static_cast<wl_callback **>(data) = nullptr;
+          },
+  };
+
+  wl_callback *sync = wl_display_sync(display_);
+  wl_callback_add_listener(sync, &sync_listener, &sync);
 
-    event.struct_size = sizeof(event);
-    event.width       = screen_width_;
-    event.height      = screen_height_;
-    event.pixel_ratio = get_pixel_ratio(physical_width_, physical_height_, screen_width_, screen_height_);
+  const uint64_t deadline_ns = FlutterEngineGetCurrentTime() + static_cast<uint64_t>(timeout_ms) * 1'000'000;
+
+  while (!output.done_ && sync != nullptr) {
+    if (wl_display_prepare_read(display_) != 0) {
+      wl_display_dispatch_pending(display_);
+      continue;
+    }
 
-    const auto success = FlutterEngineSendWindowMetricsEvent(engine_, &event) == kSuccess;
+    wl_display_flush(display_);
 
-    dbgI("Window metric: %zdx%zd par: %.3g status: %s\n", event.width, event.height, event.pixel_ratio, (success ? "success" : "failed"));
+    const uint64_t now_ns = FlutterEngineGetCurrentTime();
 
-    return success;
+    if (now_ns >= deadline_ns) {
+      wl_display_cancel_read(display_);
+      break;
+    }
+
+    struct pollfd pfd = {.fd = wl_display_get_fd(display_), .events = POLLIN, .revents = 0};
+    const int rv      = poll(&pfd, 1, static_cast<int>((deadline_ns - now_ns + 999'999) / 1'000'000));
+
+    if (rv > 0 && (pfd.revents & POLLIN)) {
+      wl_display_read_events(display_);
+    } else {
+      wl_display_cancel_read(display_);
+    }
+
+    wl_display_dispatch_pending(display_);
+  }
+
+  if (sync != nullptr) {
+    wl_callback_destroy(sync);
+  }
+
+  return output.done_ && output.mode_width_ > 0 && output.mode_height_ > 0;
+}
+
+void WaylandDisplay::ApplyOutputMode() {
+  if (output.mode_width_ <= 0 || output.mode_height_ <= 0) {
+    return;
+  }
+
+  dbgI("Output mode: %dx%d -> %dx%d scale: %d\n", screen_width_, screen_height_, output.mode_width_, output.mode_height_, output.scale_);
+
+  // Before the EGL setup the window simply gets created with the right size.
+  if (!window_) {
+    screen_width_  = output.mode_width_;
+    screen_height_ = output.mode_height_;
+    return;
+  }
+
+  RequestResize(output.mode_width_, output.mode_height_);
+}
+
+void WaylandDisplay::RequestResize(int32_t width, int32_t height) {
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+
+  resize.pending_ = true;
+  resize.width_   = width;
+  resize.height_  = height;
+}
+
+// Applies all the size changes received since the last call as a single EGL window resize
+// and a single metrics event, not more often than once per frame.
+// Returns 0 or the time at which it should be called again.
+uint64_t WaylandDisplay::ApplyPendingResize() {
+  if (!resize.pending_) {
+    return 0;
+  }
+
+  const uint64_t now_ns = FlutterEngineGetCurrentTime();
+
+  if (window_ && now_ns < resize.last_applied_ns_ + vsync.vblank_time_ns_) {
+    return resize.last_applied_ns_ + vsync.vblank_time_ns_;
+  }
+
+  resize.pending_ = false;
+
+  // must be acked before the buffer of the new size gets committed
+  if (resize.ack_needed_) {
+    xdg_surface_ack_configure(xdg_surface_, resize.serial_);
+    resize.ack_needed_ = false;
+  }
+
+  if (resize.width_ > 0 && resize.height_ > 0) {
+    screen_width_  = resize.width_;
+    screen_height_ = resize.height_;
+  }
+
+  // The pixel ratio follows the output scale and geometry as well, which may leave the buffer size as it is.
+  if (!UpdateRenderSize() && PixelRatio() == sent_pixel_ratio_) {
+    return 0;
+  }
+
+  resize.last_applied_ns_ = now_ns;
+
+  SendWindowMetrics();
+
+  return 0;
+}
+
+// Recalculates the EGL window size and the surface scaling (buffer scale or viewport destination)
+// out of the current screen size, output scale and render scale. Returns true if anything changed.
+bool WaylandDisplay::UpdateRenderSize() {
+  const int32_t output_scale = std::max(output.scale_, 1);
+  const int32_t buffer_scale = render.viewport_ ? 1 : output_scale;
+  const int32_t width        = std::max(1, static_cast<int32_t>(screen_width_ * render.scale_ + 0.5));
+  const int32_t height       = std::max(1, static_cast<int32_t>(screen_height_ * render.scale_ + 0.5));
+
+  // With a viewport the output scale changes the destination size only.
+  if (width == render.width_ && height == render.height_ && buffer_scale == render.buffer_scale_ && output_scale == render.output_scale_) {
+    return false;
+  }
+
+  dbgI("Render size: %dx%d -> %dx%d (screen: %dx%d, render scale: %.3g, buffer scale: %d, output scale: %d)\n", render.width_, render.height_, width, height, screen_width_, screen_height_, render.scale_, buffer_scale, output_scale);
+
+  render.width_        = width;
+  render.height_       = height;
+  render.buffer_scale_ = buffer_scale;
+  render.output_scale_ = output_scale;
+
+  // Both are double-buffered, i.e. applied together with the next buffer commit (eglSwapBuffers).
+  if (surface_) {
+    wl_surface_set_buffer_scale(surface_, buffer_scale);
+  }
+
+  if (render.viewport_) {
+    wp_viewport_set_destination(render.viewport_, screen_width_ / output_scale, screen_height_ / output_scale);
+  }
+
+  // Lets the compositor skip blending (and promote the surface to an overlay plane), applied with the next commit as well.
+  if (opaque_ && surface_) {
+    wl_region *const region = wl_compositor_create_region(compositor_);
+    wl_region_add(region, 0, 0, screen_width_ / output_scale, screen_height_ / output_scale);
+    wl_surface_set_opaque_region(surface_, region);
+    wl_region_destroy(region);
+  }
+
+  if (window_) {
+    wl_egl_window_resize(window_, render.width_, render.height_, 0, 0);
   }
 
   return true;
 }
 
+// Applied the same way as any other resize, i.e. at most once per frame.
+void WaylandDisplay::OnRenderScaleChanged() {
+  render.scale_   = resolution_controller_->Scale();
+  resize.pending_ = true;
+}
+
+double WaylandDisplay::SurfaceToRenderScale() const {
+  if (screen_width_ <= 0) {
+    return 1.0;
+  }
+
+  return static_cast<double>(render.width_) * std::max(output.scale_, 1) / screen_width_;
+}
+
 void WaylandDisplay::HandleMemoryWatcherEvent() {
   // minimum 20 sec between FlutterEngineNotifyLowMemoryWarning calls
   constexpr auto min_time_between_warnings_ns_ = uint64_t(2e10);
@@ -775,9 +1282,11 @@ void WaylandDisplay::HandleMemoryWatcherEvent() {
         dbgE(MEMWATCHTAG "FlutterEngineNotifyLowMemoryWarning failed with %d\n", int(ret));
         return;
       }
+      Metrics::Instance().memory_warnings_sent.Add();
       memory_watcher_.last_warning_sent_ns = now_ns;
     }
     memory_watcher_.current_level = level;
+    Metrics::Instance().memory_watcher_level.Set(level);
   }
 }
 
@@ -869,6 +1378,15 @@ void WaylandDisplay::SetupMemoryWatcher() {
 WaylandDisplay::~WaylandDisplay() {
   CleanupMemoryWatcher();
 
+  // Replies of the still queued messages need the engine, the worker handlers need the plugins.
+  if (channels_) {
+    channels_->Shutdown();
+  }
+
+  plugins_.reset();
+  dart_ports_.reset();
+  channels_.reset();
+
   if (engine_) {
     auto result = FlutterEngineShutdown(engine_);
     if (result == kSuccess) {
@@ -878,6 +1396,24 @@ WaylandDisplay::~WaylandDisplay() {
     }
   }
 
+  external_textures_.reset();
+  shared_blobs_.reset();
+
+  if (xdg_toplevel_) {
+    xdg_toplevel_destroy(xdg_toplevel_);
+    xdg_toplevel_ = nullptr;
+  }
+
+  if (xdg_surface_) {
+    xdg_surface_destroy(xdg_surface_);
+    xdg_surface_ = nullptr;
+  }
+
+  if (xdg_wm_base_) {
+    xdg_wm_base_destroy(xdg_wm_base_);
+    xdg_wm_base_ = nullptr;
+  }
+
   if (shell_surface_) {
     wl_shell_surface_destroy(shell_surface_);
     shell_surface_ = nullptr;
@@ -904,11 +1440,22 @@ WaylandDisplay::~WaylandDisplay() {
   xkb_context_unref(xkb_context);
   xkb_context = nullptr;
 
+  if (egl_display_) {
+    eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  }
+
+  resource_contexts_.reset();
+
   if (egl_surface_) {
     eglDestroySurface(egl_display_, egl_surface_);
     egl_surface_ = nullptr;
   }
 
+  if (egl_context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(egl_display_, egl_context_);
+    egl_context_ = EGL_NO_CONTEXT;
+  }
+
   if (egl_display_) {
     eglTerminate(egl_display_);
     egl_display_ = nullptr;
@@ -919,6 +1466,16 @@ WaylandDisplay::~WaylandDisplay() {
     window_ = nullptr;
   }
 
+  if (render.viewport_) {
+    wp_viewport_destroy(render.viewport_);
+    render.viewport_ = nullptr;
+  }
+
+  if (viewporter_) {
+    wp_viewporter_destroy(viewporter_);
+    viewporter_ = nullptr;
+  }
+
   if (surface_) {
     wl_surface_destroy(surface_);
     surface_ = nullptr;
@@ -953,16 +1510,28 @@ ssize_t WaylandDisplay::vSyncHandler() {
   const auto t_now_ns                      = FlutterEngineGetCurrentTime();
   const uint64_t after_vsync_time_ns       = (t_now_ns - vsync.last_frame_) % vsync.vblank_time_ns_;
   const uint64_t before_next_vsync_time_ns = vsync.vblank_time_ns_ - after_vsync_time_ns;
-  const uint64_t current_ns                = t_now_ns + before_next_vsync_time_ns;
-  const uint64_t finish_time_ns            = current_ns + vsync.vblank_time_ns_;
+  uint64_t current_ns                      = t_now_ns + before_next_vsync_time_ns;
+  uint64_t finish_time_ns                  = current_ns + vsync.vblank_time_ns_;
   intptr_t baton                           = std::atomic_exchange(&vsync.baton_, 0);
 
+  // The display does not pace the frames in the benchmark mode.
+  if (benchmark_) {
+    benchmark_->NextVsync(t_now_ns, vsync.vblank_time_ns_, &current_ns, &finish_time_ns);
+  }
+
   DBG_TIMING({
     auto tx = FlutterEngineGetCurrentTime();
     dbgI("[%09.4f][%ld] flutterEngineOnVsync [%jx]  (t:%09.4f d:%09.4f vb:%09.4f c:%09.4f f:%09.4f)\n", (tx - t00) / 1e9, gettid(), static_cast<uintmax_t>(baton), (t_now_ns - t00) / 1e9, (t_now_ns - vsync.last_frame_) / 1e9,
          vsync.vblank_time_ns_ / 1e9, (current_ns - t00) / 1e9, (finish_time_ns - t00) / 1e9);
   });
 
+  // The events batched during the previous frame are delivered before the new one starts.
+  if (dart_ports_) {
+    dart_ports_->Flush();
+  }
+
+  Metrics::Instance().vsync_latency.Observe(FlutterEngineGetCurrentTime() - vsync.baton_ns_);
+
   const auto status = FlutterEngineOnVsync(engine_, baton, current_ns, finish_time_ns);
 
   if (status != kSuccess) {
@@ -985,6 +1554,12 @@ const struct wl_callback_listener WaylandDisplay::kFrameListener = {
           }
 
           wd->vsync.last_frame_ = FlutterEngineGetCurrentTime();
+
+          if (StartupTrace::Instance().HasBegun(StartupPhase::kFirstFramePresented)) {
+            StartupTrace::Instance().End(StartupPhase::kFirstFramePresented);
+            StartupTrace::Instance().Dump();
+          }
+
           wl_callback_destroy(cb);
           wl_callback_add_listener(wl_surface_frame(wd->surface_), &kFrameListener, data);
         }
@@ -1023,14 +1598,65 @@ ssize_t WaylandDisplay::vSyncSendNotifyData() {
   return rv;
 }
 
-static void set_sleep_to_next_platform_event(const uint64_t timestamp_of_next_platform_event, struct timespec &ts) {
-  if (timestamp_of_next_platform_event == 0) {
-    ts = {.tv_sec = LONG_MAX, .tv_nsec = 0};
-  } else {
-    const uint64_t now           = FlutterEngineGetCurrentTime();
-    const uint64_t time_to_sleep = now <= timestamp_of_next_platform_event ? timestamp_of_next_platform_event - now : 0;
-    timespec_from_nsec(&ts, time_to_sleep);
+// 0 stands for "no timestamp"
+static uint64_t earliest_timestamp(const uint64_t a, const uint64_t b) {
+  if (a == 0 || b == 0) {
+    return a + b;
+  }
+
+  return std::min(a, b);
+}
+
+// Records the live input events, or drops them while a session is being replayed, so that
+// the replayed events are the only ones reaching the listeners.
+bool WaylandDisplay::OnInputEvent(const InputEvent &event) {
+  if (input.replayer_ && !input.replayer_->IsFinished()) {
+    return input.dispatching_;
+  }
+
+  if (input.recorder_) {
+    input.recorder_->Record(event, FlutterEngineGetCurrentTime());
+  }
+
+  return true;
+}
+
+void WaylandDisplay::ReplayInputEvent(const InputEvent &event) {
+  input.dispatching_ = true;
+
+  switch (event.type) {
+  case InputEvent::kPointerLeave:
+    kPointerListener.leave(this, nullptr, 0, nullptr);
+    break;
+  case InputEvent::kPointerMotion:
+    kPointerListener.motion(this, nullptr, event.time, static_cast<wl_fixed_t>(event.args[0]), static_cast<wl_fixed_t>(event.args[1]));
+    break;
+  case InputEvent::kPointerButton:
+    kPointerListener.button(this, nullptr, 0, event.time, event.args[0], event.args[1]);
+    break;
+  case InputEvent::kKey:
+    kKeyboardListener.key(this, nullptr, 0, event.time, event.args[0], event.args[1]);
+    break;
+  case InputEvent::kKeyModifiers:
+    kKeyboardListener.modifiers(this, nullptr, 0, event.args[0], event.args[1], event.args[2], event.args[3]);
+    break;
+  default:
+    dbgW("input: unknown event type: %u\n", event.type);
+    break;
+  }
+
+  input.dispatching_ = false;
+}
+
+uint64_t WaylandDisplay::ReplayInput() {
+  const uint64_t timestamp_of_next_event_ns = input.replayer_->DispatchDue(FlutterEngineGetCurrentTime(), [this](const InputEvent &event) { ReplayInputEvent(event); });
+
+  if (input.exit_ && input.replayer_->IsFinished()) {
+    dbgI("input: replay finished, exiting\n");
+    valid_ = false;
   }
+
+  return timestamp_of_next_event_ns;
 }
 
 bool WaylandDisplay::Run() {
@@ -1039,9 +1665,12 @@ bool WaylandDisplay::Run() {
     return false;
   }
 
-  const int fd = wl_display_get_fd(display_);
+  // There is neither a Wayland connection nor a surface in the headless mode.
+  const int fd = display_ ? wl_display_get_fd(display_) : -1;
 
-  wl_callback_add_listener(wl_surface_frame(surface_), &kFrameListener, this);
+  if (surface_) {
+    wl_callback_add_listener(wl_surface_frame(surface_), &kFrameListener, this);
+  }
 
   if (kbd_grab_manager_ && getEnv("FLUTTER_WAYLAND_MAIN_UI", 0.) != 0.) {
     /* It's the main UI application, so check if we can receive all keys */
@@ -1049,120 +1678,217 @@ bool WaylandDisplay::Run() {
     xwayland_keyboard_grab = zwp_xwayland_keyboard_grab_manager_v1_grab_keyboard(kbd_grab_manager_, surface_, seat_);
   }
 
-  while (valid_) {
-    while (wl_display_prepare_read(display_) != 0) {
+  uint64_t timestamp_of_next_platform_event_ns = 0;
+
+  const uint64_t run_start_ns = FlutterEngineGetCurrentTime();
+
+  if (input.recorder_) {
+    input.recorder_->Start(run_start_ns);
+  }
+
+  if (input.replayer_) {
+    input.replayer_->Start(run_start_ns, static_cast<uint32_t>(run_start_ns / 1'000'000));
+  }
+
+  // Vsync and input are served before the rest of the expired platform tasks.
+  const std::function<bool()> io_pending = [this, fd]() {
+    struct pollfd fds[3] = {
+        {.fd = vsync.sv_[vsync.SOCKET_READER], .events = POLLIN, .revents = 0},
+        {.fd = fd, .events = POLLIN, .revents = 0},
+        {.fd = key.timer_fd_, .events = POLLIN, .revents = 0}
+    };
+    return poll(&fds[0], std::size(fds), 0) > 0;
+  };
+
+  Reactor reactor;
+
+  if (!reactor.IsValid()) {
+    dbgE("Could not create the event reactor.\n");
+    valid_ = false;
+    return false;
+  }
+
+  // A source that is not watched would never be served, so the loop must not start without it.
+  const auto add_source = [&](const char *name, int source_fd, Reactor::Handler handler) {
+    if (reactor.Add(source_fd, EPOLLIN, std::move(handler))) {
+      return true;
+    }
+    dbgE("Could not watch the %s fd %d.\n", name, source_fd);
+    valid_ = false;
+    return false;
+  };
+
+  // The sources are dispatched in this order, the vsync and input ones first.
+  bool failed            = false;
+  bool wayland_read      = false;
+  bool event_loop_wakeup = false;
+
+  const bool vsync_added = add_source("vsync", vsync.sv_[vsync.SOCKET_READER], [&](uint32_t) {
+    if (vSyncReadNotifyData() != 1) {
+      failed = true;
+      return;
+    }
+
+    if (vsync.presentation_clk_id_ != UINT32_MAX && presentation_ != nullptr) {
+      DBG_TIMING({
+        auto tx = FlutterEngineGetCurrentTime();
+        dbgI("[%09.4f][%ld] add listener\n", (tx - t00) / 1e9, gettid());
+      });
+      wp_presentation_feedback_add_listener(::wp_presentation_feedback(presentation_, surface_), &kPresentationFeedbackListener, this);
       wl_display_dispatch_pending(display_);
     }
 
-    wl_display_flush(display_);
+    if (vSyncHandler() != 1) {
+      failed = true;
+    }
+  });
 
-    uint64_t timestamp_of_next_platform_event_ns = 0;
+  if (!vsync_added) {
+    return false;
+  }
 
+  const bool key_timer_added = add_source("key repeat timer", key.timer_fd_, [&](uint32_t) {
+    uint64_t count;
+    int rv;
     do {
+      rv = read(key.timer_fd_, &count, sizeof count);
+    } while (rv == -1 && errno == EINTR);
 
-      struct timespec ts;
-      set_sleep_to_next_platform_event(timestamp_of_next_platform_event_ns, ts);
+    if (rv == -1) {
+      printf("ERROR: read returned -1 (errno: %d)\n", errno);
+      failed = true;
+      return;
+    }
 
-      int rv, ppoll_rv;
+    key_handler(key.last_, key.state_, true);
+  });
 
-      struct pollfd fds[5] = {
-          {.fd = vsync.sv_[vsync.SOCKET_READER], .events = POLLIN, .revents = 0},
-          {.fd = fd, .events = POLLIN | POLLERR, .revents = 0},
-          {.fd = key.timer_fd_, .events = POLLIN | POLLERR, .revents = 0},
-          {.fd = memory_watcher_.event_fd, .events = POLLIN | POLLERR, .revents = 0},
-          {.fd = event_loop_._platform_event_loop_eventfd, .events = POLLIN | POLLERR, .revents = 0}
-      };
+  if (!key_timer_added) {
+    return false;
+  }
 
-      do {
-        ppoll_rv = ppoll(&fds[0], std::size(fds), &ts, nullptr);
-      } while (ppoll_rv == -1 && errno == EINTR);
+  if (display_) {
+    const bool wayland_added = add_source("Wayland display", fd, [&](uint32_t) {
+      wayland_read = true;
 
-      if (ppoll_rv == -1) {
-        printf("ERROR: ppoll returned -1 (errno: %d)\n", errno);
-        return false;
+      if (wl_display_read_events(display_) == -1) {
+        dbgE("wl_display_read_events failed (errno: %d)\n", errno);
+        failed = true;
       }
+    });
 
-      if (fds[2].revents & POLLIN) {
-        uint64_t count;
-        do {
-          rv = read(fds[2].fd, &count, sizeof count);
-        } while (rv == -1 && errno == EINTR);
-
-        if (rv == -1) {
-          printf("ERROR: read returned -1 (errno: %d)\n", errno);
-          return false;
-        }
+    if (!wayland_added) {
+      return false;
+    }
+  }
 
-        key_handler(key.last_, key.state_, true);
+  if (memory_watcher_.event_fd != -1) {
+    const bool memory_watcher_added = add_source("memory watcher", memory_watcher_.event_fd, [&](uint32_t) {
+      uint64_t result;
+      int rv;
+      do {
+        rv = read(memory_watcher_.event_fd, &result, sizeof result);
+      } while (rv == -1 && errno == EINTR);
+      if (rv == -1) {
+        dbgE(MEMWATCHTAG "problems reading event fd, errno=%d\n", errno);
+      } else {
+        event_loop_._platform_event_loop->PostBackgroundTask([this]() { HandleMemoryWatcherEvent(); });
       }
+    });
 
-      if (fds[0].revents & POLLIN) {
-        auto rv = vSyncReadNotifyData();
+    if (!memory_watcher_added) {
+      return false;
+    }
+  }
 
-        if (rv != 1) {
-          return false;
-        }
+  const bool event_loop_added = add_source("platform event loop", event_loop_._platform_event_loop_eventfd, [&](uint32_t) {
+    uint64_t result;
+    int rv;
+    do {
+      rv = read(event_loop_._platform_event_loop_eventfd, &result, sizeof result);
+    } while (rv == -1 && errno == EINTR);
 
-        if (vsync.presentation_clk_id_ != UINT32_MAX && presentation_ != nullptr) {
-          DBG_TIMING({
-            auto tx = FlutterEngineGetCurrentTime();
-            dbgI("[%09.4f][%ld] add listener\n", (tx - t00) / 1e9, gettid());
-          });
-          wp_presentation_feedback_add_listener(::wp_presentation_feedback(presentation_, surface_), &kPresentationFeedbackListener, this);
-          wl_display_dispatch_pending(display_);
-        }
+    event_loop_wakeup = true;
+
+    if (shared_blobs_) {
+      shared_blobs_->Reclaim();
+    }
+  });
 
-        rv = vSyncHandler();
+  if (!event_loop_added) {
+    return false;
+  }
 
-        if (rv != 1) {
-          return false;
-        }
+  if (metrics_server_ && !add_source("metrics server", metrics_server_->fd(), [this, &reactor](uint32_t) { metrics_server_->HandleConnections(reactor); })) {
+    return false;
+  }
 
-        continue;
-      }
+  while (valid_) {
+    while (display_ && wl_display_prepare_read(display_) != 0) {
+      wl_display_dispatch_pending(display_);
+    }
 
-      if (fds[1].revents & POLLIN) {
-        wl_display_read_events(display_);
-      } else {
+    const uint64_t timestamp_of_next_resize_ns = ApplyPendingResize();
+
+    // Batches are normally flushed on vsync, this bounds their latency when no frame is coming.
+    const uint64_t timestamp_of_next_dart_flush_ns = dart_ports_ ? dart_ports_->FlushIfDue(vsync.vblank_time_ns_) : 0;
+
+    const uint64_t timestamp_of_next_input_replay_ns = input.replayer_ ? ReplayInput() : 0;
+
+    if (benchmark_ && benchmark_->IsDone()) {
+      benchmark_->Report();
+      valid_ = false;
+    }
+
+    if (headless_ && headless_->IsDone()) {
+      dbgI("headless: all the frames dumped, exiting\n");
+      valid_ = false;
+    }
+
+    if (!valid_) {
+      if (display_) {
         wl_display_cancel_read(display_);
       }
+      break;
+    }
 
-      if (fds[3].revents & POLLIN) {
-        uint64_t result;
-        do {
-          rv = read(fds[3].fd, &result, sizeof result);
-        } while (rv == -1 && errno == EINTR);
-        if (rv == -1) {
-          dbgE(MEMWATCHTAG "problems reading event fd, errno=%d\n", errno);
-        } else {
-          HandleMemoryWatcherEvent();
-        }
-      }
+    if (display_) {
+      wl_display_flush(display_);
+    }
 
-      const bool event_loop_wakeup = fds[4].revents & POLLIN;
-      if (event_loop_wakeup) {
-        uint64_t result;
-        do {
-          rv = read(fds[4].fd, &result, sizeof result);
-        } while (rv == -1 && errno == EINTR);
-      }
-      // in case of event loop wakeup or if timeout of another event passed - flush events queue
-      if (event_loop_wakeup || ppoll_rv == 0) {
-        timestamp_of_next_platform_event_ns = event_loop_._platform_event_loop->ProcessEvents();
-      }
+    wayland_read      = false;
+    event_loop_wakeup = false;
 
-      break;
-    } while (true);
+    const int ready = reactor.RunOnce(
+        earliest_timestamp(earliest_timestamp(earliest_timestamp(timestamp_of_next_platform_event_ns, timestamp_of_next_resize_ns), timestamp_of_next_dart_flush_ns), timestamp_of_next_input_replay_ns));
 
-    wl_display_dispatch_pending(display_);
+    if (display_ && !wayland_read) {
+      wl_display_cancel_read(display_);
+    }
+
+    if (ready == -1 || failed) {
+      return false;
+    }
+
+    // in case of event loop wakeup or if the next task is due (its time passed or the previous call
+    // ran out of its budget) - flush events queue
+    if (event_loop_wakeup || (timestamp_of_next_platform_event_ns != 0 && timestamp_of_next_platform_event_ns <= FlutterEngineGetCurrentTime())) {
+      timestamp_of_next_platform_event_ns = event_loop_._platform_event_loop->ProcessEvents(event_loop_._task_budget_ns, io_pending);
+    }
+
+    if (display_) {
+      wl_display_dispatch_pending(display_);
+    }
   }
 
+  event_loop_._platform_event_loop->LogStats();
+
   return true;
 }
 
 bool WaylandDisplay::SetupEGL() {
 
-  egl_display_ = eglGetDisplay(display_);
+  egl_display_ = headless_ ? HeadlessOutput::GetEGLDisplay() : eglGetDisplay(display_);
   if (egl_display_ == EGL_NO_DISPLAY) {
     LogLastEGLError();
     dbgE("Could not access EGL display.\n");
@@ -1181,53 +1907,62 @@ bool WaylandDisplay::SetupEGL() {
     return false;
   }
 
-  EGLConfig egl_config = nullptr;
+  EGLConfig egl_config = ChooseEGLConfig(egl_display_, egl_config_policy_);
 
-  // Choose an EGL config to use for the surface and context.
-  {
-    EGLint attribs[] = {
-        // clang-format off
-      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-      EGL_SURFACE_TYPE,    EGL_WINDOW_BIT,
-      EGL_RED_SIZE,        8,
-      EGL_GREEN_SIZE,      8,
-      EGL_BLUE_SIZE,       8,
-      EGL_ALPHA_SIZE,      8,
-      EGL_DEPTH_SIZE,      0,
-      EGL_STENCIL_SIZE,    0,
-      EGL_NONE,            // termination sentinel
-        // clang-format on
-    };
+  if (egl_config == nullptr) {
+    dbgE("Error when attempting to choose an EGL surface config.\n");
+    return false;
+  }
 
-    EGLint config_count = 0;
+  LogEGLConfig(egl_display_, egl_config);
 
-    if (eglChooseConfig(egl_display_, attribs, &egl_config, 1, &config_count) != EGL_TRUE) {
+  const EGLint ctx_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+
+  // Create an EGL context with the match config.
+  {
+    egl_context_ = eglCreateContext(egl_display_, egl_config, nullptr /* share group */, ctx_attribs);
+
+    if (egl_context_ == EGL_NO_CONTEXT) {
       LogLastEGLError();
-      dbgE("Error when attempting to choose an EGL surface config.\n");
+      dbgE("Could not create an onscreen context.\n");
       return false;
     }
+  }
 
-    if (config_count == 0 || egl_config == nullptr) {
-      LogLastEGLError();
-      dbgE("No matching configs.\n");
-      return false;
+  // The engine makes the resource context current on its IO thread only, more are useful
+  // only if the engine is configured with more IO threads.
+  const auto resource_contexts = static_cast<size_t>(std::clamp(getEnv("FLUTTER_WAYLAND_RESOURCE_CONTEXTS", 1.), 0., 4.));
+
+  if (resource_contexts > 0) {
+    resource_contexts_ = std::make_unique<ResourceContextPool>(egl_display_, egl_config, egl_config_policy_, egl_context_, resource_contexts);
+
+    if (!resource_contexts_->IsValid()) {
+      dbgW("Texture uploads will be performed on the raster thread\n");
+      resource_contexts_.reset();
     }
   }
 
-  const EGLint ctx_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+  if (headless_) {
+    if (render.scale_ != 1.0 || resolution_controller_) {
+      dbgW("headless: FLUTTER_WAYLAND_RENDER_SCALE and FLUTTER_WAYLAND_DYNAMIC_RESOLUTION ignored\n");
+      render.scale_ = 1.0;
+      resolution_controller_.reset();
+    }
 
-  // Create an EGL context with the match config.
-  {
-    egl_context_ = eglCreateContext(egl_display_, egl_config, nullptr /* share group */, ctx_attribs);
+    UpdateRenderSize();
 
-    if (egl_context_ == EGL_NO_CONTEXT) {
+    egl_surface_ = headless_->CreateSurface(egl_display_, egl_config);
+
+    if (egl_surface_ == EGL_NO_SURFACE) {
       LogLastEGLError();
-      dbgE("Could not create an onscreen context.\n");
+      dbgE("Could not create the pbuffer surface.\n");
       return false;
     }
+
+    return true;
   }
 
-  if (!compositor_ || !shell_) {
+  if (!compositor_ || !(xdg_wm_base_ || shell_)) {
     dbgE("EGL setup needs missing compositor and shell connection.\n");
     return false;
   }
@@ -1239,31 +1974,67 @@ bool WaylandDisplay::SetupEGL() {
     return false;
   }
 
-  shell_surface_ = wl_shell_get_shell_surface(shell_, surface_);
-
-  if (!shell_surface_) {
-    dbgE("Could not shell surface.\n");
-    return false;
+  if (render.scale_ != 1.0 || resolution_controller_) {
+    if (viewporter_) {
+      render.viewport_ = wp_viewporter_get_viewport(viewporter_, surface_);
+    } else {
+      dbgW("wp_viewporter not available, FLUTTER_WAYLAND_RENDER_SCALE and FLUTTER_WAYLAND_DYNAMIC_RESOLUTION ignored\n");
+      render.scale_ = 1.0;
+      resolution_controller_.reset();
+    }
   }
 
-  wl_shell_surface_add_listener(shell_surface_, &kShellSurfaceListener, this);
+  if (xdg_wm_base_) {
+    xdg_surface_ = xdg_wm_base_get_xdg_surface(xdg_wm_base_, surface_);
+
+    if (!xdg_surface_) {
+      dbgE("Could not create xdg surface.\n");
+      return false;
+    }
+
+    xdg_surface_add_listener(xdg_surface_, &kXdgSurfaceListener, this);
+
+    xdg_toplevel_ = xdg_surface_get_toplevel(xdg_surface_);
+
+    if (!xdg_toplevel_) {
+      dbgE("Could not create xdg toplevel.\n");
+      return false;
+    }
+
+    xdg_toplevel_add_listener(xdg_toplevel_, &kXdgToplevelListener, this);
+
+    xdg_toplevel_set_title(xdg_toplevel_, "Flutter");
 
-  wl_shell_surface_set_title(shell_surface_, "Flutter");
+    // No buffer can be attached before the initial configure sequence is acked.
+    wl_surface_commit(surface_);
+    wl_display_roundtrip(display_);
+    ApplyPendingResize();
+  } else {
+    dbgI("xdg_wm_base not available, falling back to wl_shell\n");
+
+    shell_surface_ = wl_shell_get_shell_surface(shell_, surface_);
 
-  wl_shell_surface_set_toplevel(shell_surface_);
+    if (!shell_surface_) {
+      dbgE("Could not shell surface.\n");
+      return false;
+    }
 
-  window_ = wl_egl_window_create(surface_, screen_width_, screen_height_);
+    wl_shell_surface_add_listener(shell_surface_, &kShellSurfaceListener, this);
+
+    wl_shell_surface_set_title(shell_surface_, "Flutter");
+
+    wl_shell_surface_set_toplevel(shell_surface_);
+  }
+
+  UpdateRenderSize();
+
+  window_ = wl_egl_window_create(surface_, render.width_, render.height_);
 
   if (!window_) {
     dbgE("Could not create EGL window.\n");
     return false;
   }
 
-  const EGLint pbuffer_config_attribs[] = {EGL_HEIGHT, 64, EGL_WIDTH, 64, EGL_NONE};
-
-  resource_egl_context_ = eglCreateContext(egl_display_, egl_config, egl_context_ /* share group */, ctx_attribs);
-  resource_egl_surface_ = eglCreatePbufferSurface(egl_display_, egl_config, pbuffer_config_attribs);
-
   // Create an EGL window surface with the matched config.
   {
     const EGLint attribs[] = {EGL_NONE};
@@ -1300,6 +2071,7 @@ bool WaylandDisplay::ConfigurePlatformTaskRunner(FlutterTaskRunnerDescription *t
       std::this_thread::get_id(),
       std::bind(&WaylandDisplay::RunFlutterTask,this,std::placeholders::_1),
       event_loop_._platform_event_loop_eventfd);
+  event_loop_._platform_event_loop->SetSlowTaskThreshold(event_loop_._slow_task_ns);
 
   task_runner->struct_size = sizeof(FlutterTaskRunnerDescription);
   task_runner->user_data   = event_loop_._platform_event_loop.get();
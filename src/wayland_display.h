@@ -13,14 +13,29 @@
 #include <gdk/gdk.h>
 #include <xkbcommon/xkbcommon.h>
 #include <flutter_embedder.h>
+#include "channel_dispatcher.h"
+#include "dart_port_bridge.h"
+#include "egl_utils.h"
 #include "event_loop.h"
+#include "external_texture.h"
+#include "frame_benchmark.h"
+#include "headless_output.h"
+#include "input_recorder.h"
+#include "metrics.h"
+#include "plugin_host.h"
+#include "resolution_controller.h"
+#include "resource_context.h"
+#include "shared_blob.h"
 
+#include <future>
 #include <memory>
 #include <string>
 #include <time.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <wayland-presentation-time-client-protocol.h>
+#include <wayland-viewporter-client-protocol.h>
+#include <wayland-xdg-shell-client-protocol.h>
 #include <wayland-xwayland-keyboard-grab-client-protocol.h>
 
 #include "macros.h"
@@ -37,9 +52,32 @@ public:
 
   bool Run();
 
+  // Native texture producers (video decoders, cameras), nullptr until the engine is initialized.
+  ExternalTextureRegistry *GetExternalTextureRegistry() const {
+    return external_textures_.get();
+  }
+
+  // Native platform channel handlers, nullptr until the engine is initialized.
+  ChannelDispatcher *GetChannelDispatcher() const {
+    return channels_.get();
+  }
+
+  // High-rate native events for Dart, nullptr until the engine is initialized.
+  DartPortBridge *GetDartPortBridge() const {
+    return dart_ports_.get();
+  }
+
+  // Bulk data for Dart, nullptr until the engine is initialized or if disabled.
+  SharedBlobPool *GetSharedBlobPool() const {
+    return shared_blobs_.get();
+  }
+
 private:
   static const wl_registry_listener kRegistryListener;
   static const wl_shell_surface_listener kShellSurfaceListener;
+  static const xdg_wm_base_listener kXdgWmBaseListener;
+  static const xdg_surface_listener kXdgSurfaceListener;
+  static const xdg_toplevel_listener kXdgToplevelListener;
   static const wl_seat_listener kSeatListener;
   static const wl_output_listener kOutputListener;
   static const wl_pointer_listener kPointerListener;
@@ -52,7 +90,8 @@ private:
 
   struct zwp_xwayland_keyboard_grab_v1 *xwayland_keyboard_grab = nullptr;
 
-  bool key_handler(const uint32_t key, const uint32_t state_w, const bool is_repeat = false);
+  // time is the timestamp of the Wayland key event, the repeated ones have none.
+  bool key_handler(const uint32_t key, const uint32_t state_w, const bool is_repeat = false, const uint32_t time = 0);
   static const wl_keyboard_listener kKeyboardListener;
   wl_keyboard_keymap_format keymap_format = WL_KEYBOARD_KEYMAP_FORMAT_NO_KEYMAP;
   struct xkb_state *xkb_state             = nullptr;
@@ -60,32 +99,66 @@ private:
   struct xkb_context *xkb_context         = nullptr;
   GdkModifierType key_modifiers           = static_cast<GdkModifierType>(0);
 
+  // input session record and replay {
+  struct {
+    std::unique_ptr<InputRecorder> recorder_; // FLUTTER_WAYLAND_INPUT_RECORD
+    std::unique_ptr<InputReplayer> replayer_; // FLUTTER_WAYLAND_INPUT_REPLAY
+    bool dispatching_ = false;                // a replayed event is being dispatched
+    bool exit_        = false;                // FLUTTER_WAYLAND_INPUT_REPLAY_EXIT
+  } input;
+  bool OnInputEvent(const InputEvent &event);
+  void ReplayInputEvent(const InputEvent &event);
+  uint64_t ReplayInput();
+  // }
+
   bool valid_ = false;
   int screen_width_;
   int screen_height_;
   int physical_width_                                      = 0;
   int physical_height_                                     = 0;
-  bool window_metrix_skipped_                              = false;
   wl_display *display_                                     = nullptr;
   wl_registry *registry_                                   = nullptr;
   wl_compositor *compositor_                               = nullptr;
   wl_shell *shell_                                         = nullptr;
+  xdg_wm_base *xdg_wm_base_                                = nullptr;
   wl_seat *seat_                                           = nullptr;
   wl_output *output_                                       = nullptr;
   wp_presentation *presentation_                           = nullptr;
+  wp_viewporter *viewporter_                               = nullptr;
   zwp_xwayland_keyboard_grab_manager_v1 *kbd_grab_manager_ = nullptr;
   wl_shell_surface *shell_surface_                         = nullptr;
+  xdg_surface *xdg_surface_                                = nullptr;
+  xdg_toplevel *xdg_toplevel_                              = nullptr;
   wl_surface *surface_                                     = nullptr;
   wl_egl_window *window_                                   = nullptr;
   EGLDisplay egl_display_                                  = EGL_NO_DISPLAY;
   EGLSurface egl_surface_                                  = nullptr;
   EGLContext egl_context_                                  = EGL_NO_CONTEXT;
 
-  EGLSurface resource_egl_surface_ = nullptr;
-  EGLContext resource_egl_context_ = EGL_NO_CONTEXT;
+  std::unique_ptr<ResourceContextPool> resource_contexts_; // FLUTTER_WAYLAND_RESOURCE_CONTEXTS
 
   FlutterEngine engine_ = nullptr;
 
+  std::unique_ptr<ExternalTextureRegistry> external_textures_;
+  std::unique_ptr<ChannelDispatcher> channels_; // FLUTTER_WAYLAND_CHANNEL_WORKERS
+  std::unique_ptr<SharedBlobPool> shared_blobs_; // FLUTTER_WAYLAND_SHARED_BLOB_POOL_MB
+  std::unique_ptr<DartPortBridge> dart_ports_;   // FLUTTER_WAYLAND_DART_PORT_BATCHING
+  std::unique_ptr<PluginHost> plugins_;          // FLUTTER_WAYLAND_PLUGIN_PATH
+
+  // Engine inputs which do not depend on the Wayland connection,
+  // prepared on a separate thread while Wayland/EGL setup is in progress.
+  struct EngineAssets {
+    bool valid = false;
+    std::string icu_data_path;
+    const uint8_t *vm_snapshot_data              = nullptr;
+    const uint8_t *vm_snapshot_instructions      = nullptr;
+    const uint8_t *isolate_snapshot_data         = nullptr;
+    const uint8_t *isolate_snapshot_instructions = nullptr;
+  };
+  std::future<EngineAssets> engine_assets_;
+
+  static EngineAssets LoadEngineAssets(const std::string &bundle_path);
+
   struct {
     std::vector<long> levels;
     long current_level            = 0;
@@ -94,6 +167,57 @@ private:
     int event_fd                  = -1;
   } memory_watcher_;
 
+  // wl_output related {
+  struct {
+    uint32_t version_    = 0;
+    int32_t mode_width_  = 0; // current mode as advertised by the compositor
+    int32_t mode_height_ = 0;
+    int32_t scale_       = 1;
+    bool done_           = false;
+  } output;
+  bool WaitForOutputConfiguration(int timeout_ms);
+  void ApplyOutputMode();
+  // }
+
+  // surface size changes, coalesced and applied at most once per frame {
+  struct {
+    bool pending_             = false;
+    int32_t width_            = 0;
+    int32_t height_           = 0;
+    bool ack_needed_          = false; // xdg_surface.configure serial to be acked
+    uint32_t serial_          = 0;
+    uint64_t last_applied_ns_ = 0;
+  } resize;
+  void RequestResize(int32_t width, int32_t height);
+  uint64_t ApplyPendingResize();
+  // }
+
+  // internal render resolution, screen_width_/screen_height_ is the full one {
+  struct {
+    double scale_          = 1.0; // FLUTTER_WAYLAND_RENDER_SCALE, upscaled by the compositor (wp_viewporter)
+    int32_t width_         = 0;   // EGL window size
+    int32_t height_        = 0;
+    int32_t buffer_scale_  = 1;
+    int32_t output_scale_  = 1; // the buffer scale or the viewport destination is applied for
+    wp_viewport *viewport_ = nullptr;
+  } render;
+  bool UpdateRenderSize();
+  double SurfaceToRenderScale() const;
+  std::unique_ptr<ResolutionController> resolution_controller_; // FLUTTER_WAYLAND_DYNAMIC_RESOLUTION
+
+  std::unique_ptr<MetricsServer> metrics_server_; // FLUTTER_LAUNCHER_WAYLAND_METRICS_SOCKET
+  std::unique_ptr<FrameBenchmark> benchmark_;     // FLUTTER_WAYLAND_BENCHMARK_FRAMES
+  std::unique_ptr<HeadlessOutput> headless_;      // FLUTTER_WAYLAND_HEADLESS, no Wayland connection at all
+  void OnRenderScaleChanged();
+  // }
+
+  double pixel_ratio_      = 0.0;   // FLUTTER_WAYLAND_PIXEL_RATIO, 0 if output.scale_ should be used
+  double sent_pixel_ratio_ = 0.0;   // of the last window metrics event
+  bool opaque_             = false; // FLUTTER_WAYLAND_OPAQUE
+  EGLConfigPolicy egl_config_policy_;
+  double PixelRatio() const;
+  bool SendWindowMetrics();
+
   bool SetupEGL();
 
   bool SetupEngine(const std::string &bundle_path, const std::vector<std::string> &command_line_args);
@@ -124,6 +248,7 @@ private:
     uint32_t presentation_clk_id_     = UINT32_MAX;
     std::atomic<intptr_t> baton_      = 0;
     std::atomic<uint64_t> last_frame_ = 0;
+    std::atomic<uint64_t> baton_ns_   = 0; // when the baton arrived
     uint64_t vblank_time_ns_          = 1'000'000'000'000 / 60'000;
     enum { SOCKET_WRITER = 0, SOCKET_READER };
     int sv_[2] = {-1, -1}; // 0-index is for sending, 1-index is for reading
@@ -136,6 +261,8 @@ private:
   struct {
     std::unique_ptr<PlatformEventLoop> _platform_event_loop;
     int _platform_event_loop_eventfd = -1;
+    uint64_t _task_budget_ns         = 0; // FLUTTER_WAYLAND_TASK_BUDGET_US, 0 runs all the expired tasks at once
+    uint64_t _slow_task_ns           = 0; // FLUTTER_WAYLAND_SLOW_TASK_MS
   } event_loop_;
 
   FLWAY_DISALLOW_COPY_AND_ASSIGN(WaylandDisplay)
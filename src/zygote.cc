@@ -0,0 +1,241 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include <flutter_embedder.h>
+
+#include "debug.h"
+#include "startup_trace.h"
+#include "utils.h"
+#include "zygote.h"
+
+#define ZYGOTETAG "zygote: "
+
+namespace flutter {
+
+// Maps the whole file and faults it in, so every child finds it in the page cache.
+// The mapping is intentionally never released.
+static void PreloadFile(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1) {
+    dbgW(ZYGOTETAG "Could not open %s (errno: %d)\n", path.c_str(), errno);
+    return;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *const addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+
+    if (addr == MAP_FAILED) {
+      dbgW(ZYGOTETAG "Could not map %s (errno: %d)\n", path.c_str(), errno);
+    } else {
+      dbgI(ZYGOTETAG "Preloaded %s (%jd bytes)\n", path.c_str(), static_cast<intmax_t>(st.st_size));
+    }
+  }
+
+  close(fd);
+}
+
+static int CreateListeningSocket(const std::string &socket_path) {
+  struct sockaddr_un addr = {};
+  addr.sun_family         = AF_UNIX;
+
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    dbgE(ZYGOTETAG "Socket path too long: %s\n", socket_path.c_str());
+    return -1;
+  }
+
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+  const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+  if (fd == -1) {
+    dbgE(ZYGOTETAG "socket() failed (errno: %d)\n", errno);
+    return -1;
+  }
+
+  unlink(socket_path.c_str());
+
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 || listen(fd, 8) == -1) {
+    dbgE(ZYGOTETAG "Could not listen on %s (errno: %d)\n", socket_path.c_str(), errno);
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static void ReapChildren(const int signal_fd) {
+  struct signalfd_siginfo si;
+
+  while (read(signal_fd, &si, sizeof(si)) == sizeof(si)) {
+  }
+
+  int status;
+  pid_t pid;
+
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    if (WIFEXITED(status)) {
+      dbgI(ZYGOTETAG "child %d exited with status %d\n", pid, WEXITSTATUS(status));
+    } else if (WIFSIGNALED(status)) {
+      dbgW(ZYGOTETAG "child %d killed by signal %d\n", pid, WTERMSIG(status));
+    }
+  }
+}
+
+// Returns the pid of the forked child to the parent, 0 to the child and -1 on error.
+static pid_t HandleLaunchRequest(const int conn_fd, std::vector<std::string> &args) {
+  std::vector<char> request(64 * 1024);
+  ssize_t rv;
+
+  do {
+    rv = recv(conn_fd, request.data(), request.size(), 0);
+  } while (rv == -1 && errno == EINTR);
+
+  if (rv <= 0) {
+    dbgE(ZYGOTETAG "Could not read launch request (rv: %zd, errno: %d)\n", rv, errno);
+    return -1;
+  }
+
+  const uint64_t request_time_ns = FlutterEngineGetCurrentTime();
+
+  std::vector<std::string> launch_args = {args[0]};
+
+  for (ssize_t pos = 0; pos < rv;) {
+    const char *const arg = request.data() + pos;
+    const size_t len      = strnlen(arg, rv - pos);
+    launch_args.emplace_back(arg, len);
+    pos += len + 1;
+  }
+
+  if (launch_args.size() < 2 || launch_args[1].empty()) {
+    dbgE(ZYGOTETAG "Launch request without asset bundle path\n");
+    return -1;
+  }
+
+  const pid_t pid = fork();
+
+  if (pid == -1) {
+    dbgE(ZYGOTETAG "fork() failed (errno: %d)\n", errno);
+    return -1;
+  }
+
+  if (pid == 0) {
+    // Launch-to-first-frame is measured from the moment the request arrived.
+    StartupTrace::Instance().SetOrigin(request_time_ns);
+    args = std::move(launch_args);
+    return 0;
+  }
+
+  dbgI(ZYGOTETAG "launched %s as pid %d\n", launch_args[1].c_str(), pid);
+
+  const std::string reply = std::to_string(pid);
+
+  if (send(conn_fd, reply.c_str(), reply.size(), MSG_NOSIGNAL) == -1) {
+    dbgW(ZYGOTETAG "Could not reply to the launch request (errno: %d)\n", errno);
+  }
+
+  return pid;
+}
+
+bool RunZygote(const std::string &socket_path, std::vector<std::string> &args) {
+  // The engine library has been mapped and relocated by the dynamic linker already, so only the data
+  // which would be otherwise read from the storage on each launch needs to be warmed up here.
+  // Neither EGL, Wayland nor the engine instance itself are safe to be shared with the forked children.
+  const auto icu_data_path = GetICUDataPath();
+
+  if (icu_data_path != "") {
+    PreloadFile(icu_data_path);
+  }
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+
+  if (sigprocmask(SIG_BLOCK, &mask, nullptr) == -1) {
+    dbgE(ZYGOTETAG "sigprocmask() failed (errno: %d)\n", errno);
+    return false;
+  }
+
+  const int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+  if (signal_fd == -1) {
+    dbgE(ZYGOTETAG "signalfd() failed (errno: %d)\n", errno);
+    return false;
+  }
+
+  const int listen_fd = CreateListeningSocket(socket_path);
+
+  if (listen_fd == -1) {
+    close(signal_fd);
+    return false;
+  }
+
+  dbgI(ZYGOTETAG "waiting for launch requests on %s\n", socket_path.c_str());
+
+  while (true) {
+    struct pollfd fds[2] = {
+        {.fd = listen_fd, .events = POLLIN, .revents = 0},
+        {.fd = signal_fd, .events = POLLIN, .revents = 0},
+    };
+
+    const int rv = poll(&fds[0], std::size(fds), -1);
+
+    if (rv == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      dbgE(ZYGOTETAG "poll() failed (errno: %d)\n", errno);
+      break;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      ReapChildren(signal_fd);
+    }
+
+    if (fds[0].revents & POLLIN) {
+      const int conn_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+
+      if (conn_fd == -1) {
+        dbgW(ZYGOTETAG "accept4() failed (errno: %d)\n", errno);
+        continue;
+      }
+
+      const pid_t pid = HandleLaunchRequest(conn_fd, args);
+      close(conn_fd);
+
+      if (pid == 0) {
+        close(listen_fd);
+        close(signal_fd);
+        sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+        return true;
+      }
+    }
+  }
+
+  close(listen_fd);
+  close(signal_fd);
+  unlink(socket_path.c_str());
+
+  return false;
+}
+
+} // namespace flutter
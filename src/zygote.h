@@ -0,0 +1,23 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace flutter {
+
+// Pre-warmed launcher (zygote) mode.
+//
+// Warms up everything which is safe to be shared across fork() (the already linked engine library, ICU data)
+// and then waits for launch requests on the SOCK_SEQPACKET unix socket bound at socket_path. Each request
+// is a single packet of NUL-separated arguments (<asset_bundle_path> [<flutter_flags>...]), the reply
+// is the decimal pid of the child which serves the request.
+//
+// The zygote itself never returns unless an error occurs (false is returned). It returns true only
+// in the forked child, with args set to the launch arguments (args[0] is preserved).
+bool RunZygote(const std::string &socket_path, std::vector<std::string> &args);
+
+} // namespace flutter
@@ -0,0 +1,194 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "compositor_harness.h"
+
+namespace flutter::testing {
+
+static uint64_t NowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1'000 + ts.tv_nsec / 1'000'000;
+}
+
+// Sends the launch request for the bundle to the zygote listening on socket_path, returns the connection
+// (which gets the reply) or -1 if the zygote is not listening yet.
+static int RequestLaunch(const std::string &socket_path, const std::string &bundle_path) {
+  struct sockaddr_un addr = {};
+  addr.sun_family         = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+  const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+  if (fd == -1) {
+    return -1;
+  }
+
+  if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1 || send(fd, bundle_path.c_str(), bundle_path.size() + 1, MSG_NOSIGNAL) == -1) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+double CompositorRun::Stat(const std::string &prefix, const std::string &key) const {
+  std::istringstream lines(output);
+  std::string line;
+  double value = NAN;
+
+  while (std::getline(lines, line)) {
+    if (line.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+
+    const auto pos = line.find(" " + key + " ", prefix.size() - 1);
+
+    if (pos != std::string::npos) {
+      value = strtod(line.c_str() + pos + key.size() + 2, nullptr);
+    }
+  }
+
+  return value;
+}
+
+CompositorRun RunCompositor(const CompositorRunOptions &options) {
+  CompositorRun run;
+
+  char dir[] = "/tmp/flutter-wayland-test-XXXXXX";
+
+  if (mkdtemp(dir) == nullptr) {
+    run.output = "could not create the test directory\n";
+    return run;
+  }
+
+  const std::string script_path = std::string(dir) + "/script";
+  const std::string zygote_path = std::string(dir) + "/zygote";
+  std::ofstream(script_path) << options.script;
+
+  int pipe_fds[2];
+
+  if (pipe2(pipe_fds, O_CLOEXEC) == -1) {
+    run.output = "could not create the output pipe\n";
+    return run;
+  }
+
+  const pid_t pid = fork();
+
+  if (pid == 0) {
+    // Killed as a group on timeout.
+    setpgid(0, 0);
+
+    dup2(pipe_fds[1], STDOUT_FILENO);
+    dup2(pipe_fds[1], STDERR_FILENO);
+
+    // The sockets of the compositor and of the launcher (metrics, zygote, ...) go to the test directory.
+    setenv("XDG_RUNTIME_DIR", dir, 1);
+    setenv("LD_LIBRARY_PATH", ENGINE_STUB_DIR, 1);
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+    setenv("FLUTTER_LAUNCHER_WAYLAND_DEBUG", "info", 0);
+
+    for (const auto &[name, value] : options.env) {
+      setenv(name.c_str(), value.c_str(), 1);
+    }
+
+    if (options.zygote) {
+      setenv("FLUTTER_LAUNCHER_WAYLAND_ZYGOTE_SOCKET", zygote_path.c_str(), 1);
+    }
+
+    std::vector<const char *> argv = {TEST_COMPOSITOR_PATH, "-m", options.mode.c_str(), "-S", script_path.c_str()};
+
+    if (options.wl_shell) {
+      argv.push_back("-l");
+    }
+
+    // The stub engine needs no assets, the test directory serves as the bundle. The zygote gets
+    // it with the launch request.
+    argv.insert(argv.end(), {"--", LAUNCHER_PATH});
+
+    if (!options.zygote) {
+      argv.push_back(dir);
+    }
+
+    argv.push_back(nullptr);
+
+    execv(argv[0], const_cast<char *const *>(argv.data()));
+    fprintf(stderr, "could not execute %s (errno: %d)\n", argv[0], errno);
+    _exit(127);
+  }
+
+  close(pipe_fds[1]);
+
+  const uint64_t deadline_ms = NowMs() + options.timeout_s * 1'000;
+  int zygote_fd               = -1;
+
+  while (true) {
+    const uint64_t now_ms = NowMs();
+
+    if (now_ms >= deadline_ms) {
+      run.timed_out = true;
+      kill(-pid, SIGKILL);
+      break;
+    }
+
+    // Retried until the zygote listens.
+    if (options.zygote && zygote_fd == -1) {
+      zygote_fd = RequestLaunch(zygote_path, dir);
+    }
+
+    const bool waiting_for_zygote = options.zygote && zygote_fd == -1;
+    struct pollfd pfd             = {.fd = pipe_fds[0], .events = POLLIN, .revents = 0};
+
+    if (poll(&pfd, 1, waiting_for_zygote ? 10 : static_cast<int>(deadline_ms - now_ms)) <= 0) {
+      continue;
+    }
+
+    char buffer[4096];
+    const ssize_t size = read(pipe_fds[0], buffer, sizeof(buffer));
+
+    if (size <= 0) {
+      break;
+    }
+
+    run.output.append(buffer, size);
+  }
+
+  close(pipe_fds[0]);
+
+  if (zygote_fd != -1) {
+    close(zygote_fd);
+  }
+
+  int status;
+  waitpid(pid, &status, 0);
+
+  // The launcher might still be around if the compositor got killed.
+  kill(-pid, SIGKILL);
+
+  run.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+  std::error_code error;
+  std::filesystem::remove_all(dir, error);
+
+  return run;
+}
+
+} // namespace flutter::testing
@@ -0,0 +1,40 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace flutter::testing {
+
+// A run of flutter-wayland-test-compositor with flutter-launcher-wayland on the stub engine as its
+// client (see tools/), software rendered by Mesa into wl_shm buffers.
+struct CompositorRunOptions {
+  std::string script;                                   // test compositor script, one command per line
+  std::string mode = "1280x720@60000";                  // of the output
+  bool wl_shell    = false;                             // wl_shell instead of xdg_wm_base
+  bool zygote      = false;                             // the launcher runs as a zygote, the harness requests the launch
+  std::vector<std::pair<std::string, std::string>> env; // of the launcher (FLUTTER_ENGINE_STUB_*, ...)
+  int timeout_s = 60;                                   // the processes get killed after that
+};
+
+struct CompositorRun {
+  int status     = -1;    // of the compositor: 1 if an expectation failed, otherwise of the launcher
+  bool timed_out = false; // the processes had to be killed
+  std::string output;     // stdout and stderr of all the processes
+
+  // Number following key on the last output line starting with prefix, NaN if there is none,
+  // e.g. Stat("test-compositor: ", "presented:").
+  double Stat(const std::string &prefix, const std::string &key) const;
+
+  bool Contains(const std::string &text) const {
+    return output.find(text) != std::string::npos;
+  }
+};
+
+CompositorRun RunCompositor(const CompositorRunOptions &options);
+
+} // namespace flutter::testing
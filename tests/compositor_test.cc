@@ -0,0 +1,196 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "compositor_harness.h"
+
+namespace flutter::testing {
+
+static const char kCompositor[] = "test-compositor: ";
+static const char kStub[]       = "engine-stub: ";
+
+// The stub engine needs 6ms per frame, far less than a 60Hz refresh period: every vblank should
+// present exactly one frame, none should be superseded before it is shown.
+TEST(CompositorTest, VsyncPacing) {
+  const auto run = RunCompositor({
+      .script = "",
+      .env    = {{"FLUTTER_ENGINE_STUB_FRAMES", "180"}, {"FLUTTER_ENGINE_STUB_BUILD_US", "2000"}, {"FLUTTER_ENGINE_STUB_RASTER_US", "4000"}},
+  });
+
+  ASSERT_EQ(run.status, 0) << run.output;
+
+  const double presented = run.Stat(kCompositor, "presented:");
+  const double fps       = run.Stat(kStub, "fps:");
+
+  EXPECT_GE(presented, 170) << run.output;
+  EXPECT_EQ(run.Stat(kCompositor, "superseded:"), 0) << run.output;
+  EXPECT_LE(run.Stat(kCompositor, "idle:"), presented / 20) << run.output;
+  EXPECT_NEAR(fps, 60, 3) << run.output;
+
+  RecordProperty("fps", std::to_string(fps));
+}
+
+// The frames follow the output refresh rate.
+TEST(CompositorTest, VsyncPacingFollowsTheMode) {
+  const auto run = RunCompositor({
+      .script = "",
+      .mode   = "1280x720@30000",
+      .env    = {{"FLUTTER_ENGINE_STUB_FRAMES", "90"}},
+  });
+
+  ASSERT_EQ(run.status, 0) << run.output;
+  EXPECT_NEAR(run.Stat(kStub, "fps:"), 30, 2) << run.output;
+}
+
+// The first frame has the size of the output, every configure reaches the buffers within the next
+// frames (the compositor fails the run otherwise).
+TEST(CompositorTest, Resize) {
+  const auto run = RunCompositor({
+      .script = "frames 10\n"
+                "expect-size 1280 720\n"
+                "configure 800 600\n"
+                "frames 10\n"
+                "expect-size 800 600\n"
+                "configure 1024 768\n"
+                "frames 10\n"
+                "expect-size 1024 768\n",
+      .env    = {{"FLUTTER_ENGINE_STUB_FRAMES", "120"}},
+  });
+
+  EXPECT_EQ(run.status, 0) << run.output;
+  EXPECT_FALSE(run.Contains("FAILED")) << run.output;
+}
+
+// With a render scale the surface is scaled by a viewport, whose destination follows the output
+// scale even though the buffer size stays the same, and so do the window metrics.
+TEST(CompositorTest, OutputScaleWithViewport) {
+  const auto run = RunCompositor({
+      .script = "frames 10\n"
+                "expect-size 640 360\n"
+                "expect-destination 1280 720\n"
+                "mode 1280 720 60000 2\n"
+                "frames 10\n"
+                "expect-size 640 360\n"
+                "expect-destination 640 360\n",
+      .env    = {{"FLUTTER_ENGINE_STUB_FRAMES", "60"}, {"FLUTTER_WAYLAND_RENDER_SCALE", "0.5"}},
+  });
+
+  EXPECT_EQ(run.status, 0) << run.output;
+  EXPECT_FALSE(run.Contains("FAILED")) << run.output;
+  EXPECT_EQ(run.Stat(kStub, "window metrics:"), 2) << run.output;
+}
+
+// FLUTTER_WAYLAND_OPAQUE: the opaque region covers the whole surface, so the compositor has nothing
+// to blend, with a viewport too. Without it every pixel is blended.
+TEST(CompositorTest, OpaqueRegion) {
+  constexpr double kOutputPixels = 1280 * 720;
+
+  for (const char *render_scale : {"1", "0.5"}) {
+    for (const bool opaque : {false, true}) {
+      const auto run = RunCompositor({
+          .script = "frames 10\n",
+          .env    = {{"FLUTTER_ENGINE_STUB_FRAMES", "30"}, {"FLUTTER_WAYLAND_RENDER_SCALE", render_scale}, {"FLUTTER_WAYLAND_OPAQUE", opaque ? "1" : "0"}},
+      });
+
+      ASSERT_EQ(run.status, 0) << run.output;
+      EXPECT_EQ(run.Stat(kCompositor, "blended px/frame:"), opaque ? 0 : kOutputPixels) << run.output;
+      EXPECT_EQ(run.Stat(kCompositor, "opaque px/frame:"), opaque ? kOutputPixels : 0) << run.output;
+    }
+  }
+}
+
+// The launcher waits for the output mode and the initial configure, so the engine lays out the first
+// frame only once, at its final size.
+TEST(CompositorTest, OneWindowMetricsEventAtStartup) {
+  for (const bool wl_shell : {false, true}) {
+    const auto run = RunCompositor({
+        .script   = "frames 10\n",
+        .wl_shell = wl_shell,
+        .env      = {{"FLUTTER_ENGINE_STUB_FRAMES", "30"}},
+    });
+
+    ASSERT_EQ(run.status, 0) << run.output;
+    EXPECT_EQ(run.Stat(kStub, "startup window metrics:"), 1) << run.output;
+    EXPECT_EQ(run.Stat(kStub, "window metrics:"), 1) << run.output;
+  }
+}
+
+// A burst of key taps sent back to back: all of them have to reach the engine, and quickly.
+TEST(CompositorTest, InputThroughput) {
+  constexpr int kTaps = 500;
+
+  const auto run = RunCompositor({
+      .script = "frames 10\n"
+                "burst " + std::to_string(kTaps) + " 30\n",
+      .env    = {{"FLUTTER_ENGINE_STUB_FRAMES", "120"}},
+  });
+
+  ASSERT_EQ(run.status, 0) << run.output;
+
+  const double key_events = run.Stat(kStub, "key events:");
+  const double span_ms    = run.Stat(kStub, "key span:");
+
+  EXPECT_EQ(run.Stat(kCompositor, "input events:"), 2 * kTaps) << run.output;
+  EXPECT_EQ(key_events, 2 * kTaps) << run.output;
+  // Well below the 2s the stub runs for.
+  EXPECT_LT(span_ms, 500) << run.output;
+
+  RecordProperty("key_events_per_second", std::to_string(key_events * 1e3 / std::max(span_ms, 1.)));
+}
+
+// Button clicks while the platform thread is half busy with 2ms tasks: the pending input ends the run
+// of platform tasks, so the events reach the engine after a task at most (plus the 1ms resolution of
+// the Wayland timestamps).
+TEST(CompositorTest, InputLatencyUnderPlatformTaskLoad) {
+  constexpr int kClicks = 40;
+
+  std::string script = "frames 10\n"
+                       "pointer 100 100\n";
+
+  for (int i = 0; i < kClicks; i++) {
+    // Not a multiple of the 4ms task period, so that the clicks land at every phase of it.
+    script += "button left press\n"
+              "wait 5\n"
+              "button left release\n"
+              "wait 6\n";
+  }
+
+  const auto run = RunCompositor({
+      .script = script,
+      .env    = {{"FLUTTER_ENGINE_STUB_FRAMES", "120"}, {"FLUTTER_ENGINE_STUB_TASK_HZ", "250"}, {"FLUTTER_ENGINE_STUB_TASK_US", "2000"}},
+  });
+
+  ASSERT_EQ(run.status, 0) << run.output;
+  EXPECT_GE(run.Stat(kStub, "pointer events:"), 2 * kClicks) << run.output;
+
+  const double latency_us = run.Stat(kStub, "pointer latency avg:");
+
+  EXPECT_LT(latency_us, 2000 + 1000 + 1000) << run.output;
+
+  RecordProperty("input_latency_us", std::to_string(latency_us));
+}
+
+// Without xdg_wm_base the launcher falls back to wl_shell, which has no initial configure.
+TEST(CompositorTest, WlShell) {
+  const auto run = RunCompositor({
+      .script   = "frames 10\n"
+                  "expect-size 1280 720\n"
+                  "configure 800 600\n"
+                  "frames 10\n"
+                  "expect-size 800 600\n",
+      .wl_shell = true,
+      .env      = {{"FLUTTER_ENGINE_STUB_FRAMES", "60"}},
+  });
+
+  EXPECT_EQ(run.status, 0) << run.output;
+  EXPECT_TRUE(run.Contains("falling back to wl_shell")) << run.output;
+  EXPECT_FALSE(run.Contains("FAILED")) << run.output;
+  EXPECT_GE(run.Stat(kCompositor, "presented:"), 50) << run.output;
+}
+
+} // namespace flutter::testing
@@ -0,0 +1,207 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// High-rate native events (say a remote control or a sensor) delivered to Dart through a platform
+// channel (a StandardMethodCodec call per event) against the Dart port fast path (DartPortBridge),
+// unbatched and batched per frame. Each iteration is one frame holding the given number of events.
+//
+// BM_Send*: the native side, items per second are the events per second a thread can produce.
+// BM_Receive*: the UI thread side, the decoding the framework does before the events reach the app
+// (done here with the C++ codec, Dart's costs more but scales the same), and the UI isolate wakeups
+// per event, each of which also costs a message loop turn and a microtask checkpoint in Dart.
+// Unbatched port events arrive as plain ints: no decoding, one wakeup per event.
+// The engine is the stub one, which models the copy of the platform messages only.
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "channel_dispatcher.h"
+#include "dart_port_bridge.h"
+#include "standard_codec.h"
+#include "stub_engine.h"
+
+namespace flutter::testing {
+
+static constexpr char kChannel[] = "flutter-wayland/benchmark";
+static const std::string kTopic  = "benchmark";
+
+// A bridge with a port registered for kTopic, the way Dart registers it.
+class RegisteredBridge {
+public:
+  explicit RegisteredBridge(bool batching)
+      : notify_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+      , channels_(GetStubEngine(), 0, 0)
+      , bridge_(GetStubEngine(), channels_, batching, notify_fd_) {
+    StandardMap arguments(2);
+    arguments[0] = {StandardValue{std::string_view("topic")}, StandardValue{std::string_view(kTopic)}};
+    arguments[1] = {StandardValue{std::string_view("port")}, StandardValue{int64_t(42)}};
+
+    StandardMessageWriter writer;
+    StandardMethodCodec::EncodeMethodCall(writer, "register", StandardValue{std::move(arguments)});
+
+    FlutterPlatformMessageResponseHandle *handle = nullptr;
+    FlutterPlatformMessageCreateResponseHandle(GetStubEngine(), nullptr, nullptr, &handle);
+
+    const FlutterPlatformMessage message = {
+        .struct_size     = sizeof(FlutterPlatformMessage),
+        .channel         = DartPortBridge::kChannel,
+        .message         = writer.data(),
+        .message_size    = writer.size(),
+        .response_handle = handle,
+    };
+
+    channels_.OnPlatformMessage(&message);
+  }
+
+  ~RegisteredBridge() {
+    close(notify_fd_);
+  }
+
+  DartPortBridge &bridge() {
+    return bridge_;
+  }
+
+  // The platform thread, woken up by the first event of a batch.
+  void Flush() {
+    uint64_t value;
+    if (read(notify_fd_, &value, sizeof(value)) == sizeof(value)) {
+      bridge_.Flush();
+    }
+  }
+
+private:
+  const int notify_fd_;
+  ChannelDispatcher channels_;
+  DartPortBridge bridge_;
+};
+
+static void EncodeChannelEvent(StandardMessageWriter &writer, int64_t value) {
+  StandardMethodCodec::EncodeMethodCall(writer, "event", StandardValue{value});
+}
+
+static void SetEventCounters(benchmark::State &state, int64_t events_per_frame, double wakeups_per_frame) {
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * events_per_frame);
+  state.counters["ui_wakeups/event"] = wakeups_per_frame / events_per_frame;
+}
+
+static void BM_SendPlatformChannel(benchmark::State &state) {
+  const int64_t events = state.range(0);
+  ChannelDispatcher channels(GetStubEngine(), 0, 0);
+  StandardMessageWriter writer;
+  int64_t value = 0;
+
+  for (auto _ : state) {
+    for (int64_t i = 0; i < events; i++) {
+      writer.Reset();
+      EncodeChannelEvent(writer, value++);
+
+      if (!channels.Send(kChannel, writer.data(), writer.size())) {
+        state.SkipWithError("could not send the message");
+        return;
+      }
+    }
+  }
+
+  SetEventCounters(state, events, events);
+}
+
+static void BM_SendDartPort(benchmark::State &state) {
+  const int64_t events = state.range(0);
+  RegisteredBridge registered(false);
+  int64_t value = 0;
+
+  for (auto _ : state) {
+    for (int64_t i = 0; i < events; i++) {
+      if (!registered.bridge().Post(kTopic, value++)) {
+        state.SkipWithError("could not post the event");
+        return;
+      }
+    }
+  }
+
+  SetEventCounters(state, events, events);
+}
+
+static void BM_SendDartPortBatched(benchmark::State &state) {
+  const int64_t events = state.range(0);
+  RegisteredBridge registered(true);
+  int64_t value = 0;
+
+  for (auto _ : state) {
+    for (int64_t i = 0; i < events; i++) {
+      if (!registered.bridge().Post(kTopic, value++)) {
+        state.SkipWithError("could not post the event");
+        return;
+      }
+    }
+
+    // Before the vsync is delivered.
+    registered.Flush();
+  }
+
+  SetEventCounters(state, events, 1);
+}
+
+// The framework's MethodChannel: a message and a method call decoded per event.
+static void BM_ReceivePlatformChannel(benchmark::State &state) {
+  const int64_t events = state.range(0);
+  StandardMessageWriter writer;
+  EncodeChannelEvent(writer, int64_t(1) << 40);
+
+  for (auto _ : state) {
+    for (int64_t i = 0; i < events; i++) {
+      StandardMessageReader reader(writer.data(), writer.size());
+      std::string_view method;
+      StandardValue value;
+
+      if (!StandardMethodCodec::DecodeMethodCall(reader, &method, &value)) {
+        state.SkipWithError("could not decode");
+        return;
+      }
+
+      benchmark::DoNotOptimize(value);
+    }
+  }
+
+  SetEventCounters(state, events, events);
+}
+
+// A Uint8List of the frame's values back to back, as the bridge batches them.
+static void BM_ReceiveDartPortBatched(benchmark::State &state) {
+  const int64_t events = state.range(0);
+  StandardMessageWriter writer;
+
+  for (int64_t i = 0; i < events; i++) {
+    writer.WriteInt(int64_t(1) << 40);
+  }
+
+  for (auto _ : state) {
+    StandardMessageReader reader(writer.data(), writer.size());
+
+    while (!reader.AtEnd()) {
+      StandardValue value;
+
+      if (!reader.Read(&value)) {
+        state.SkipWithError("could not decode");
+        return;
+      }
+
+      benchmark::DoNotOptimize(value);
+    }
+  }
+
+  SetEventCounters(state, events, 1);
+}
+
+BENCHMARK(BM_SendPlatformChannel)->ArgName("events")->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(BM_SendDartPort)->ArgName("events")->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(BM_SendDartPortBatched)->ArgName("events")->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(BM_ReceivePlatformChannel)->ArgName("events")->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(BM_ReceiveDartPortBatched)->ArgName("events")->Arg(1)->Arg(16)->Arg(256);
+
+} // namespace flutter::testing
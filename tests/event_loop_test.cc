@@ -0,0 +1,144 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "event_loop.h"
+#include "reactor.h"
+
+namespace flutter::testing {
+
+static constexpr uint64_t kVsyncPeriodNs = 4'000'000;
+static constexpr uint64_t kTaskNs        = 500'000;   // of every flooding task
+static constexpr uint64_t kSlackNs       = 3'000'000; // scheduling noise of a loaded test machine
+static constexpr size_t kQueueDepth      = 200;       // expired tasks kept in the queue
+static constexpr size_t kVsyncs          = 200;
+
+static void Spin(uint64_t duration_ns) {
+  const uint64_t start = FlutterEngineGetCurrentTime();
+  while (FlutterEngineGetCurrentTime() - start < duration_ns) {
+  }
+}
+
+// The platform thread of WaylandDisplay::Run() with a vsync timer as its only I/O, while another
+// thread floods the event loop with engine and background tasks. Returns the 95th percentile of the
+// delays between a vsync and its dispatch: the worst one is up to the scheduler of a loaded machine.
+static uint64_t VsyncLatency(uint64_t budget_ns, bool yield_to_io) {
+  const int notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  const int vsync_fd  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  std::atomic<size_t> pending = 0;
+  PlatformEventLoop loop(
+      std::this_thread::get_id(),
+      [&pending](const FlutterTask *) {
+        Spin(kTaskNs);
+        pending--;
+      },
+      notify_fd);
+
+  std::atomic<bool> stop = false;
+  std::thread flood([&loop, &pending, &stop] {
+    // Tops the queue up in bursts, so that it preempts the platform thread of a single core
+    // machine briefly.
+    for (; !stop; usleep(1000)) {
+      for (; pending < kQueueDepth; pending++) {
+        loop.PostTask(FlutterTask{}, FlutterEngineGetCurrentTime());
+        loop.PostBackgroundTask([] { Spin(kTaskNs / 10); });
+      }
+    }
+  });
+
+  // Let the queue fill up before the first vsync.
+  while (pending < kQueueDepth) {
+    usleep(100);
+  }
+
+  const uint64_t first_vsync_ns = FlutterEngineGetCurrentTime() + kVsyncPeriodNs;
+  const itimerspec spec         = {
+      .it_interval = {.tv_sec = 0, .tv_nsec = kVsyncPeriodNs},
+      .it_value    = {.tv_sec = static_cast<time_t>(first_vsync_ns / 1'000'000'000), .tv_nsec = static_cast<long>(first_vsync_ns % 1'000'000'000)},
+  };
+  timerfd_settime(vsync_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+
+  Reactor reactor;
+  std::vector<uint64_t> latencies;
+  uint64_t vsyncs  = 0;
+  bool loop_wakeup = false;
+  uint64_t next_ns = 0;
+
+  reactor.Add(vsync_fd, EPOLLIN, [&](uint32_t) {
+    uint64_t expirations;
+    if (read(vsync_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+      return;
+    }
+
+    // Measured from the oldest expiration not dispatched yet.
+    latencies.push_back(FlutterEngineGetCurrentTime() - (first_vsync_ns + vsyncs * kVsyncPeriodNs));
+    vsyncs += expirations;
+  });
+
+  reactor.Add(notify_fd, EPOLLIN, [&](uint32_t) {
+    uint64_t value;
+    loop_wakeup = read(notify_fd, &value, sizeof(value)) == sizeof(value);
+  });
+
+  const std::function<bool()> io_pending = [vsync_fd]() {
+    struct pollfd fd = {.fd = vsync_fd, .events = POLLIN, .revents = 0};
+    return poll(&fd, 1, 0) > 0;
+  };
+
+  while (vsyncs < kVsyncs) {
+    loop_wakeup = false;
+
+    if (reactor.RunOnce(next_ns) == -1) {
+      break;
+    }
+
+    if (loop_wakeup || (next_ns != 0 && next_ns <= FlutterEngineGetCurrentTime())) {
+      next_ns = loop.ProcessEvents(budget_ns, yield_to_io ? io_pending : nullptr);
+    }
+  }
+
+  stop = true;
+  flood.join();
+
+  reactor.Remove(vsync_fd);
+  reactor.Remove(notify_fd);
+  close(vsync_fd);
+  close(notify_fd);
+
+  std::sort(latencies.begin(), latencies.end());
+
+  return latencies[latencies.size() * 95 / 100];
+}
+
+// FLUTTER_WAYLAND_TASK_BUDGET_US=0: the whole backlog runs before the vsync is looked at, which is
+// what the other tests guard against (and shows the flood does saturate the loop).
+TEST(EventLoopTest, FloodDelaysVsyncWithoutBudget) {
+  EXPECT_GT(VsyncLatency(0, false), 10 * kTaskNs + kSlackNs);
+}
+
+// The default: the pending vsync ends the run of tasks after the current one.
+TEST(EventLoopTest, FloodDelaysVsyncByATaskAtMost) {
+  EXPECT_LE(VsyncLatency(4'000'000, true), kTaskNs + kSlackNs);
+}
+
+// Without the I/O check, by the budget and the task overrunning it at most.
+TEST(EventLoopTest, FloodDelaysVsyncByTheBudgetAtMost) {
+  constexpr uint64_t kBudgetNs = 2'000'000;
+
+  EXPECT_LE(VsyncLatency(kBudgetNs, false), kBudgetNs + kTaskNs + kSlackNs);
+}
+
+} // namespace flutter::testing
@@ -0,0 +1,214 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Synthetic 1080p60 producer of an external texture (see ExternalTextureRegistry): a producer thread
+// submits a frame every 16.7ms, the benchmark thread plays the raster thread and populates the texture
+// on a 60Hz vsync grid offset by half a period. Each iteration is one vsync, its (manual) time is the
+// submit-to-populate latency of the frame shown, half a period of which is the phase offset. Also reported:
+// the bytes copied per shown frame, the vsyncs without a new frame and the frames the producer had to skip.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "external_texture.h"
+#include "surfaceless_egl.h"
+
+namespace flutter::testing {
+
+static constexpr size_t kWidth       = 1920;
+static constexpr size_t kHeight      = 1080;
+static constexpr size_t kPoolSize    = 3;
+static constexpr auto kFramePeriod   = std::chrono::nanoseconds(16'666'667);
+static constexpr uint64_t kFrameSize = kWidth * kHeight * 4;
+
+using Clock = std::chrono::steady_clock;
+
+// Submits a frame on every tick of the 60Hz grid until stopped.
+class Producer {
+public:
+  template <typename Produce>
+  explicit Producer(Produce produce)
+      : thread_([this, produce] {
+        for (auto tick = Clock::now(); !stop_; tick += kFramePeriod) {
+          std::this_thread::sleep_until(tick);
+
+          if (produce()) {
+            submitted_ns_ = FlutterEngineGetCurrentTime();
+          } else {
+            stalls_++;
+          }
+        }
+      }) {
+  }
+
+  ~Producer() {
+    stop_ = true;
+    thread_.join();
+  }
+
+  // Of the most recent frame, 0 if none.
+  uint64_t submitted_ns() const {
+    return submitted_ns_;
+  }
+
+  // Frames skipped because the whole pool was in use.
+  uint64_t stalls() const {
+    return stalls_;
+  }
+
+private:
+  std::atomic<bool> stop_             = false;
+  std::atomic<uint64_t> submitted_ns_ = 0;
+  std::atomic<uint64_t> stalls_       = 0;
+  std::thread thread_;
+};
+
+// The raster thread side: populates the texture on the vsync grid and reports the latency of every
+// new frame as the iteration time.
+static void Consume(benchmark::State &state, ExternalTextureRegistry &registry, int64_t texture_id, const Producer &producer, uint64_t bytes_per_upload) {
+  uint64_t shown_ns = 0;
+  uint64_t shown    = 0;
+  uint64_t repeated = 0;
+  auto vsync        = Clock::now() + kFramePeriod / 2;
+
+  for (auto _ : state) {
+    std::this_thread::sleep_until(vsync);
+    vsync += kFramePeriod;
+
+    // A frame submitted in between is attributed the previous timestamp: the latency is never underestimated.
+    const uint64_t submitted_ns = producer.submitted_ns();
+
+    FlutterOpenGLTexture texture;
+
+    if (submitted_ns == shown_ns || !registry.Populate(texture_id, kWidth, kHeight, &texture)) {
+      repeated++;
+      state.SetIterationTime(0);
+      continue;
+    }
+
+    glFinish();
+
+    state.SetIterationTime((FlutterEngineGetCurrentTime() - submitted_ns) / 1e9);
+    shown_ns = submitted_ns;
+    shown++;
+  }
+
+  state.counters["shown"]             = shown;
+  state.counters["repeated"]          = repeated;
+  state.counters["producer_stalls"]   = producer.stalls();
+  state.counters["copied_MiB/frame"]  = bytes_per_upload / (1024.0 * 1024.0);
+  state.counters["copied_MiB/second"] = benchmark::Counter(shown * bytes_per_upload / (1024.0 * 1024.0), benchmark::Counter::kIsRate);
+}
+
+// Software decoder: writes every frame into a pool buffer (the decode itself, no copy), which the
+// raster thread uploads (one copy).
+static void BM_ExternalTextureShm1080p60(benchmark::State &state) {
+  const PbufferContext pbuffer({}, 1, 1);
+
+  if (!pbuffer.IsValid()) {
+    state.SkipWithError("no surfaceless EGL context");
+    return;
+  }
+
+  ExternalTextureRegistry registry(nullptr);
+  const int64_t texture_id = registry.RegisterTexture(kWidth, kHeight, kPoolSize);
+
+  if (texture_id == -1) {
+    state.SkipWithError("could not register the texture");
+    return;
+  }
+
+  uint8_t frame = 0;
+
+  {
+    const Producer producer([&registry, texture_id, &frame] {
+      auto *const buffer = registry.AcquireBuffer(texture_id);
+
+      if (buffer == nullptr) {
+        return false;
+      }
+
+      memset(buffer->data, frame++, buffer->size);
+
+      return registry.SubmitBuffer(texture_id, buffer);
+    });
+
+    Consume(state, registry, texture_id, producer, kFrameSize);
+  }
+
+  registry.UnregisterTexture(texture_id);
+}
+
+// Hardware decoder: hands over EGLImages (textures of the same context here, dmabufs on a real
+// device), which are bound without any copy.
+static void BM_ExternalTextureEGLImage1080p60(benchmark::State &state) {
+  const PbufferContext pbuffer({}, 1, 1);
+
+  if (!pbuffer.IsValid()) {
+    state.SkipWithError("no surfaceless EGL context");
+    return;
+  }
+
+  auto create_image  = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(eglGetProcAddress("eglCreateImageKHR"));
+  auto destroy_image = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(eglGetProcAddress("eglDestroyImageKHR"));
+
+  if (create_image == nullptr || destroy_image == nullptr || !HasEGLExtension(pbuffer.display(), "EGL_KHR_gl_texture_2D_image")) {
+    state.SkipWithError("EGL_KHR_gl_texture_2D_image is not supported");
+    return;
+  }
+
+  struct Image {
+    GLuint name       = 0;
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    std::atomic<bool> in_use;
+  } images[kPoolSize];
+
+  for (auto &image : images) {
+    glGenTextures(1, &image.name);
+    glBindTexture(GL_TEXTURE_2D, image.name);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, kWidth, kHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    image.image  = create_image(pbuffer.display(), eglGetCurrentContext(), EGL_GL_TEXTURE_2D_KHR, reinterpret_cast<EGLClientBuffer>(static_cast<uintptr_t>(image.name)), nullptr);
+    image.in_use = false;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  ExternalTextureRegistry registry(nullptr);
+  const int64_t texture_id = registry.RegisterTexture(kWidth, kHeight, 0);
+
+  {
+    const Producer producer([&registry, texture_id, &images] {
+      for (auto &image : images) {
+        if (!image.in_use) {
+          image.in_use = true;
+          return registry.SubmitEGLImage(texture_id, image.image, kWidth, kHeight, [&image] { image.in_use = false; });
+        }
+      }
+
+      return false;
+    });
+
+    Consume(state, registry, texture_id, producer, 0);
+  }
+
+  registry.UnregisterTexture(texture_id);
+
+  for (auto &image : images) {
+    destroy_image(pbuffer.display(), image.image);
+    glDeleteTextures(1, &image.name);
+  }
+}
+
+BENCHMARK(BM_ExternalTextureShm1080p60)->UseManualTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ExternalTextureEGLImage1080p60)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+} // namespace flutter::testing
@@ -0,0 +1,124 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Fill throughput per surface format (see FLUTTER_WAYLAND_EGL_FORMAT): full screen blended quads into
+// a 1080p pbuffer of the config ChooseEGLConfig() picks, on Mesa's surfaceless platform. Run with
+// LIBGL_ALWAYS_SOFTWARE=1 for comparable numbers without a GPU, where the bandwidth is the CPU's.
+
+#include <GLES2/gl2.h>
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "surfaceless_egl.h"
+
+namespace flutter::testing {
+
+static constexpr EGLint kWidth  = 1920;
+static constexpr EGLint kHeight = 1080;
+static constexpr int kLayers    = 4; // quads per frame
+
+static GLuint CompileProgram() {
+  static const char kVertexShader[] =
+      "attribute vec2 position;\n"
+      "void main() { gl_Position = vec4(position, 0.0, 1.0); }\n";
+  static const char kFragmentShader[] =
+      "precision mediump float;\n"
+      "uniform vec4 color;\n"
+      "void main() { gl_FragColor = color; }\n";
+
+  auto compile = [](GLenum type, const char *source) {
+    const GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    return shader;
+  };
+
+  const GLuint program = glCreateProgram();
+  glAttachShader(program, compile(GL_VERTEX_SHADER, kVertexShader));
+  glAttachShader(program, compile(GL_FRAGMENT_SHADER, kFragmentShader));
+  glBindAttribLocation(program, 0, "position");
+  glLinkProgram(program);
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+  return linked == GL_TRUE ? program : 0;
+}
+
+static void BM_Fill(benchmark::State &state, EGLConfigPolicy::Format format, EGLint stencil_size, EGLint samples) {
+  EGLConfigPolicy policy;
+  policy.format       = format;
+  policy.stencil_size = stencil_size;
+  policy.samples      = samples;
+
+  const PbufferContext pbuffer(policy, kWidth, kHeight);
+
+  if (!pbuffer.IsValid()) {
+    state.SkipWithError("no pbuffer context of the format");
+    return;
+  }
+
+  const GLuint program = CompileProgram();
+
+  if (program == 0) {
+    state.SkipWithError("could not link the program");
+    return;
+  }
+
+  static const GLfloat kQuad[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+
+  glUseProgram(program);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, kQuad);
+  glEnableVertexAttribArray(0);
+  glViewport(0, 0, kWidth, kHeight);
+  // Blending reads the framebuffer back, like the translucent layers of a real UI.
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  const GLint color = glGetUniformLocation(program, "color");
+
+  auto draw_frame = [color] {
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    for (int i = 0; i < kLayers; i++) {
+      glUniform4f(color, i / static_cast<float>(kLayers), 0.5f, 0.25f, 0.5f);
+      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    glFinish();
+  };
+
+  // The first frame compiles the shaders (llvmpipe generates code per pipeline state).
+  draw_frame();
+
+  for (auto _ : state) {
+    draw_frame();
+  }
+
+  EGLint red, green, blue, alpha, buffer_size;
+  eglGetConfigAttrib(pbuffer.display(), pbuffer.config(), EGL_RED_SIZE, &red);
+  eglGetConfigAttrib(pbuffer.display(), pbuffer.config(), EGL_GREEN_SIZE, &green);
+  eglGetConfigAttrib(pbuffer.display(), pbuffer.config(), EGL_BLUE_SIZE, &blue);
+  eglGetConfigAttrib(pbuffer.display(), pbuffer.config(), EGL_ALPHA_SIZE, &alpha);
+  eglGetConfigAttrib(pbuffer.display(), pbuffer.config(), EGL_BUFFER_SIZE, &buffer_size);
+
+  const int64_t pixels = static_cast<int64_t>(state.iterations()) * kWidth * kHeight * (kLayers + 1);
+
+  // Color buffer bytes written (the clear and every layer), the bandwidth the format costs.
+  state.SetItemsProcessed(pixels);
+  state.SetBytesProcessed(pixels * ((buffer_size + 7) / 8));
+  state.SetLabel(std::to_string(red) + std::to_string(green) + std::to_string(blue) + std::to_string(alpha));
+
+  glDeleteProgram(program);
+}
+
+BENCHMARK_CAPTURE(BM_Fill, argb8888, EGLConfigPolicy::Format::kARGB8888, 0, 0)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Fill, xrgb8888, EGLConfigPolicy::Format::kXRGB8888, 0, 0)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Fill, rgb565, EGLConfigPolicy::Format::kRGB565, 0, 0)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Fill, argb8888_stencil8, EGLConfigPolicy::Format::kARGB8888, 8, 0)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Fill, argb8888_msaa4, EGLConfigPolicy::Format::kARGB8888, 0, 4)->Unit(benchmark::kMillisecond);
+
+} // namespace flutter::testing
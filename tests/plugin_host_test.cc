@@ -0,0 +1,100 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "channel_dispatcher.h"
+#include "event_loop.h"
+#include "plugin_host.h"
+#include "stub_engine.h"
+
+namespace flutter::testing {
+
+// Messages handed to the worker of a plugin (tests/test_plugin.cc), which is busy with the first
+// one, are still handled on teardown and reach a live plugin host.
+TEST(PluginHostTest, TeardownRunsQueuedWorkerMessages) {
+  char directory[] = "/tmp/plugin-host-test-XXXXXX";
+  ASSERT_NE(mkdtemp(directory), nullptr);
+
+  const std::string manifest = std::string(directory) + "/test.plugin";
+  std::ofstream(manifest) << "library=" TEST_PLUGIN_PATH "\n"
+                             "channels=test/slow\n"
+                             "thread=worker\n";
+
+  const int notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  PlatformEventLoop loop(std::this_thread::get_id(), [](const FlutterTask *) {}, notify_fd);
+
+  auto channels = std::make_unique<ChannelDispatcher>(GetStubEngine(), 1, 16);
+  auto plugins  = std::make_unique<PluginHost>(*channels, loop);
+  plugins->Scan(directory);
+
+  constexpr int kMessages = 4;
+  const uint8_t payload[] = {1, 2, 3};
+
+  for (int i = 0; i < kMessages; i++) {
+    FlutterPlatformMessageResponseHandle *handle = nullptr;
+    FlutterPlatformMessageCreateResponseHandle(GetStubEngine(), nullptr, nullptr, &handle);
+
+    const FlutterPlatformMessage message = {
+        .struct_size     = sizeof(FlutterPlatformMessage),
+        .channel         = "test/slow",
+        .message         = payload,
+        .message_size    = sizeof(payload),
+        .response_handle = handle,
+    };
+
+    channels->OnPlatformMessage(&message);
+  }
+
+  // As in ~WaylandDisplay.
+  channels->Shutdown();
+  plugins.reset();
+  channels.reset();
+
+  void *const library = dlopen(TEST_PLUGIN_PATH, RTLD_NOW | RTLD_NOLOAD);
+  ASSERT_NE(library, nullptr);
+
+  const auto handled = reinterpret_cast<int (*)()>(dlsym(library, "test_plugin_handled"));
+  ASSERT_NE(handled, nullptr);
+  EXPECT_EQ(handled(), kMessages);
+
+  dlclose(library);
+  close(notify_fd);
+  unlink(manifest.c_str());
+  rmdir(directory);
+}
+
+// Once shut down, messages for the worker handlers are rejected (answered with an empty reply).
+TEST(ChannelDispatcherTest, RejectsWorkerMessagesAfterShutdown) {
+  ChannelDispatcher channels(GetStubEngine(), 1, 16);
+  int handled = 0;
+
+  channels.SetHandler(
+      "test/worker", [&handled](const uint8_t *, size_t, ChannelDispatcher::Responder) { handled++; }, ChannelDispatcher::ThreadPolicy::kWorker);
+  channels.Shutdown();
+
+  const FlutterPlatformMessage message = {
+      .struct_size     = sizeof(FlutterPlatformMessage),
+      .channel         = "test/worker",
+      .message         = nullptr,
+      .message_size    = 0,
+      .response_handle = nullptr,
+  };
+
+  channels.OnPlatformMessage(&message);
+
+  EXPECT_EQ(handled, 0);
+}
+
+} // namespace flutter::testing
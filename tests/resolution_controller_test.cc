@@ -0,0 +1,191 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "resolution_controller.h"
+
+namespace flutter::testing {
+
+static constexpr uint64_t kRefreshNs = 16'666'667;
+
+// Feeds one evaluation window whose first missed_frames frames are a vblank late, returns the number
+// of scale changes.
+static int Window(ResolutionController &controller, size_t missed_frames, size_t window_frames = ResolutionController::Config().window_frames) {
+  int changes = 0;
+
+  for (size_t i = 0; i < window_frames; i++) {
+    changes += controller.OnFramePresented(i < missed_frames ? 2 * kRefreshNs : kRefreshNs, kRefreshNs);
+  }
+
+  return changes;
+}
+
+static int CleanWindows(ResolutionController &controller, size_t count) {
+  int changes = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    changes += Window(controller, 0);
+  }
+
+  return changes;
+}
+
+TEST(ResolutionControllerTest, StaysAtMaxScaleWithoutMisses) {
+  ResolutionController controller({});
+
+  EXPECT_EQ(CleanWindows(controller, 20), 0);
+  EXPECT_EQ(controller.Scale(), 1.0);
+}
+
+TEST(ResolutionControllerTest, StepsDownAtTheEndOfAWindowWithTooManyMisses) {
+  ResolutionController controller({});
+
+  // 4 of 30 frames late: above the 0.1 ratio.
+  for (size_t i = 0; i < 29; i++) {
+    EXPECT_FALSE(controller.OnFramePresented(i < 4 ? 2 * kRefreshNs : kRefreshNs, kRefreshNs));
+  }
+
+  EXPECT_TRUE(controller.OnFramePresented(kRefreshNs, kRefreshNs));
+  EXPECT_EQ(controller.Scale(), 0.875);
+}
+
+TEST(ResolutionControllerTest, ToleratesMissesUpToTheRatio) {
+  ResolutionController controller({});
+
+  // 3 of 30 frames late: exactly the 0.1 ratio.
+  EXPECT_EQ(Window(controller, 3), 0);
+  EXPECT_EQ(controller.Scale(), 1.0);
+}
+
+TEST(ResolutionControllerTest, CountsEveryMissedVblank) {
+  ResolutionController controller({});
+
+  // Only two late frames, but 3 vblanks late each.
+  EXPECT_FALSE(controller.OnFramePresented(4 * kRefreshNs, kRefreshNs));
+  EXPECT_FALSE(controller.OnFramePresented(4 * kRefreshNs, kRefreshNs));
+  EXPECT_EQ(Window(controller, 0, 28), 1);
+  EXPECT_EQ(controller.Scale(), 0.875);
+}
+
+TEST(ResolutionControllerTest, IgnoresIdleGaps) {
+  ResolutionController controller({});
+
+  // Nothing was animating: these are not frames at all, so they neither miss nor fill the window.
+  for (int i = 0; i < 100; i++) {
+    EXPECT_FALSE(controller.OnFramePresented(6 * kRefreshNs, kRefreshNs));
+  }
+
+  EXPECT_EQ(Window(controller, 4, 29), 0);
+  EXPECT_TRUE(controller.OnFramePresented(kRefreshNs, kRefreshNs));
+}
+
+TEST(ResolutionControllerTest, CountsDiscardedFramesAsMisses) {
+  ResolutionController controller({});
+
+  for (int i = 0; i < 4; i++) {
+    EXPECT_FALSE(controller.OnFrameDiscarded());
+  }
+
+  EXPECT_EQ(Window(controller, 0, 26), 1);
+  EXPECT_EQ(controller.Scale(), 0.875);
+}
+
+TEST(ResolutionControllerTest, StepsDownToTheMinimumOnly) {
+  ResolutionController controller({});
+
+  for (double expected : {0.875, 0.75, 0.625, 0.5}) {
+    EXPECT_EQ(Window(controller, 30), 1);
+    EXPECT_EQ(controller.Scale(), expected);
+  }
+
+  EXPECT_EQ(Window(controller, 30), 0);
+  EXPECT_EQ(controller.Scale(), 0.5);
+}
+
+TEST(ResolutionControllerTest, StepsUpAfterConsecutiveCleanWindows) {
+  ResolutionController controller({});
+
+  Window(controller, 30);
+  Window(controller, 30);
+  ASSERT_EQ(controller.Scale(), 0.75);
+
+  EXPECT_EQ(CleanWindows(controller, 3), 0);
+  EXPECT_EQ(CleanWindows(controller, 1), 1);
+  EXPECT_EQ(controller.Scale(), 0.875);
+
+  EXPECT_EQ(CleanWindows(controller, 4), 1);
+  EXPECT_EQ(controller.Scale(), 1.0);
+
+  // Never above the maximum.
+  EXPECT_EQ(CleanWindows(controller, 20), 0);
+  EXPECT_EQ(controller.Scale(), 1.0);
+}
+
+// Hysteresis: a window with a few misses (not enough for a step down) restarts the clean streak.
+TEST(ResolutionControllerTest, MissesBelowTheRatioRestartTheCleanStreak) {
+  ResolutionController controller({});
+
+  Window(controller, 30);
+  ASSERT_EQ(controller.Scale(), 0.875);
+
+  EXPECT_EQ(CleanWindows(controller, 3), 0);
+  EXPECT_EQ(Window(controller, 1), 0);
+  EXPECT_EQ(CleanWindows(controller, 3), 0);
+  EXPECT_EQ(controller.Scale(), 0.875);
+
+  EXPECT_EQ(CleanWindows(controller, 1), 1);
+  EXPECT_EQ(controller.Scale(), 1.0);
+}
+
+// Oscillation between two scales: each failed step up doubles the clean streak needed for the next one.
+TEST(ResolutionControllerTest, BacksOffAfterAFailedStepUp) {
+  ResolutionController controller({});
+
+  Window(controller, 30);
+  size_t required = 4;
+
+  for (int cycle = 0; cycle < 3; cycle++) {
+    ASSERT_EQ(controller.Scale(), 0.875);
+
+    EXPECT_EQ(CleanWindows(controller, required - 1), 0) << "cycle " << cycle;
+    EXPECT_EQ(CleanWindows(controller, 1), 1) << "cycle " << cycle;
+    EXPECT_EQ(controller.Scale(), 1.0);
+
+    // Too expensive again.
+    EXPECT_EQ(Window(controller, 30), 1);
+    required *= 2;
+  }
+}
+
+TEST(ResolutionControllerTest, BackoffIsCapped) {
+  ResolutionController::Config config;
+  config.max_backoff_shift = 1;
+  ResolutionController controller(config);
+
+  Window(controller, 30);
+
+  for (int cycle = 0; cycle < 4; cycle++) {
+    EXPECT_EQ(CleanWindows(controller, cycle == 0 ? 4 : 8), 1) << "cycle " << cycle;
+    EXPECT_EQ(Window(controller, 30), 1);
+  }
+}
+
+// A step down which does not follow a step up keeps the current patience.
+TEST(ResolutionControllerTest, NoBackoffForAStepDownLater) {
+  ResolutionController controller({});
+
+  Window(controller, 30);
+  CleanWindows(controller, 4);
+  ASSERT_EQ(controller.Scale(), 1.0);
+
+  // The step up held for a while before the load increased.
+  CleanWindows(controller, 2);
+  EXPECT_EQ(Window(controller, 30), 1);
+
+  EXPECT_EQ(CleanWindows(controller, 4), 1);
+  EXPECT_EQ(controller.Scale(), 1.0);
+}
+
+} // namespace flutter::testing
@@ -0,0 +1,110 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Transfer of 1 KiB to 16 MiB payloads from native code to Dart: as a plain platform message
+// (FlutterEngineSendPlatformMessage, the engine copies it) against a shared blob (SharedBlobPool, only
+// the handle is sent, Dart acquires and releases it through FFI and the platform thread reclaims it).
+// Both produce the payload in place and leave reading it to Dart, which costs the same either way.
+// The engine is the stub one, which models the engine's own copy of the message only.
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "channel_dispatcher.h"
+#include "shared_blob.h"
+#include "stub_engine.h"
+
+namespace flutter::testing {
+
+static constexpr char kChannel[] = "flutter-wayland/benchmark";
+
+static void BM_PlatformMessage(benchmark::State &state) {
+  const FlutterEngine engine = GetStubEngine();
+  const size_t size          = state.range(0);
+  std::vector<uint8_t> payload(size);
+  uint8_t fill = 0;
+
+  for (auto _ : state) {
+    memset(payload.data(), fill++, size);
+
+    const FlutterPlatformMessage message = {
+        .struct_size     = sizeof(FlutterPlatformMessage),
+        .channel         = kChannel,
+        .message         = payload.data(),
+        .message_size    = size,
+        .response_handle = nullptr,
+    };
+
+    if (FlutterEngineSendPlatformMessage(engine, &message) != kSuccess) {
+      state.SkipWithError("could not send the message");
+      break;
+    }
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+}
+
+static void BM_SharedBlob(benchmark::State &state) {
+  const size_t size   = state.range(0);
+  const int notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  SharedBlobPool pool(64 << 20, notify_fd);
+  ChannelDispatcher channels(GetStubEngine(), 0, 0);
+  uint8_t fill = 0;
+
+  if (!pool.IsValid()) {
+    state.SkipWithError("could not create the pool");
+    close(notify_fd);
+    return;
+  }
+
+  for (auto _ : state) {
+    SharedBlobPool::Blob blob;
+
+    if (!pool.Allocate(size, &blob)) {
+      state.SkipWithError("could not allocate the blob");
+      break;
+    }
+
+    memset(blob.data, fill++, size);
+
+    if (!pool.Send(channels, kChannel, blob)) {
+      state.SkipWithError("could not send the handle");
+      break;
+    }
+
+    // Dart, with the reference it got together with the handle.
+    const uint8_t *data;
+    uint64_t data_size;
+
+    if (flutter_wayland_blob_acquire(blob.handle, &data, &data_size) != 1) {
+      state.SkipWithError("could not acquire the blob");
+      break;
+    }
+
+    benchmark::DoNotOptimize(data);
+    flutter_wayland_blob_release(blob.handle);
+    flutter_wayland_blob_release(blob.handle);
+
+    // The platform thread, woken up by the last release.
+    uint64_t value;
+    if (read(notify_fd, &value, sizeof(value)) == sizeof(value)) {
+      pool.Reclaim();
+    }
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+
+  close(notify_fd);
+}
+
+BENCHMARK(BM_PlatformMessage)->RangeMultiplier(4)->Range(1 << 10, 16 << 20);
+BENCHMARK(BM_SharedBlob)->RangeMultiplier(4)->Range(1 << 10, 16 << 20);
+
+} // namespace flutter::testing
@@ -0,0 +1,119 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// StandardMessageCodec encode and decode throughput on typical channel messages: a small method
+// call (a key event), a 1 MiB Uint8List (an image) and a list of 1000 small maps (a JSON like model).
+// The writer is reused across iterations the way the channel handlers reuse theirs.
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "standard_codec.h"
+
+namespace flutter::testing {
+
+enum Message { kKeyEvent, kBlob, kRecords };
+
+static void EncodeMessage(StandardMessageWriter &writer, Message message) {
+  static const std::vector<uint8_t> blob(1024 * 1024, 0x5a);
+
+  switch (message) {
+  case kKeyEvent:
+    writer.BeginMap(6);
+    writer.WriteString("type");
+    writer.WriteString("keydown");
+    writer.WriteString("keymap");
+    writer.WriteString("linux");
+    writer.WriteString("toolkit");
+    writer.WriteString("gtk");
+    writer.WriteString("scanCode");
+    writer.WriteInt(38);
+    writer.WriteString("keyCode");
+    writer.WriteInt(97);
+    writer.WriteString("modifiers");
+    writer.WriteInt(0);
+    break;
+  case kBlob:
+    writer.WriteUint8List(blob);
+    break;
+  case kRecords:
+    writer.BeginList(1000);
+    for (int i = 0; i < 1000; i++) {
+      writer.BeginMap(4);
+      writer.WriteString("id");
+      writer.WriteInt(int64_t(i) << 33);
+      writer.WriteString("title");
+      writer.WriteString("Channel " + std::to_string(i));
+      writer.WriteString("position");
+      writer.WriteDouble(i * 0.5);
+      writer.WriteString("favorite");
+      writer.WriteBool(i % 3 == 0);
+    }
+    break;
+  }
+}
+
+static void BM_Encode(benchmark::State &state) {
+  const auto message = static_cast<Message>(state.range(0));
+  StandardMessageWriter writer;
+
+  for (auto _ : state) {
+    writer.Reset();
+    EncodeMessage(writer, message);
+    benchmark::DoNotOptimize(writer.data());
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * writer.size());
+}
+
+static void BM_Decode(benchmark::State &state) {
+  StandardMessageWriter writer;
+  EncodeMessage(writer, static_cast<Message>(state.range(0)));
+
+  for (auto _ : state) {
+    StandardMessageReader reader(writer.data(), writer.size());
+    StandardValue value;
+
+    if (!reader.Read(&value)) {
+      state.SkipWithError("could not decode");
+      break;
+    }
+
+    benchmark::DoNotOptimize(value);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * writer.size());
+}
+
+// Decoded values written back, e.g. the replies which echo their arguments.
+static void BM_ReEncode(benchmark::State &state) {
+  StandardMessageWriter source;
+  EncodeMessage(source, static_cast<Message>(state.range(0)));
+
+  StandardMessageReader reader(source.data(), source.size());
+  StandardValue value;
+
+  if (!reader.Read(&value)) {
+    state.SkipWithError("could not decode");
+    return;
+  }
+
+  StandardMessageWriter writer;
+
+  for (auto _ : state) {
+    writer.Reset();
+    writer.Write(value);
+    benchmark::DoNotOptimize(writer.data());
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * writer.size());
+}
+
+BENCHMARK(BM_Encode)->ArgName("message")->Arg(kKeyEvent)->Arg(kBlob)->Arg(kRecords);
+BENCHMARK(BM_Decode)->ArgName("message")->Arg(kKeyEvent)->Arg(kBlob)->Arg(kRecords);
+BENCHMARK(BM_ReEncode)->ArgName("message")->Arg(kKeyEvent)->Arg(kBlob)->Arg(kRecords);
+
+} // namespace flutter::testing
@@ -0,0 +1,372 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "standard_codec.h"
+
+namespace flutter::testing {
+
+// Structural equality, doubles compared bit for bit (NaNs included).
+static bool Same(const StandardValue &a, const StandardValue &b);
+
+template <typename T> static bool Same(const T &a, const T &b) {
+  return a == b;
+}
+
+static bool Same(std::monostate, std::monostate) {
+  return true;
+}
+
+static bool Same(double a, double b) {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool Same(const StandardLargeInt &a, const StandardLargeInt &b) {
+  return a.hex == b.hex;
+}
+
+template <typename T> static bool Same(std::span<const T> a, std::span<const T> b) {
+  return a.size() == b.size() && memcmp(a.data(), b.data(), a.size_bytes()) == 0;
+}
+
+static bool Same(const StandardList &a, const StandardList &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a.size(); i++) {
+    if (!Same(a[i], b[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool Same(const StandardMap &a, const StandardMap &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < a.size(); i++) {
+    if (!Same(a[i].key, b[i].key) || !Same(a[i].value, b[i].value)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool Same(const StandardValue &a, const StandardValue &b) {
+  if (a.value.index() != b.value.index()) {
+    return false;
+  }
+
+  return std::visit(
+      [&b](const auto &x) {
+        using T = std::decay_t<decltype(x)>;
+        return Same(x, std::get<T>(b.value));
+      },
+      a.value);
+}
+
+// Random value trees over every type of the codec. The strings and typed data the values point to
+// live as long as the generator.
+class RandomValues {
+public:
+  explicit RandomValues(uint64_t seed)
+      : rng_(seed) {
+  }
+
+  StandardValue Next(size_t depth = 0) {
+    StandardValue value;
+
+    switch (Uniform(0, depth < kMaxDepth ? 14 : 12)) {
+    case 0:
+      break;
+    case 1:
+      value.value = Uniform(0, 1) == 1;
+      break;
+    case 2:
+      value.value = static_cast<int32_t>(rng_());
+      break;
+    case 3:
+      value.value = static_cast<int64_t>(rng_());
+      break;
+    case 4: {
+      // Any bit pattern, NaNs and denormals included.
+      const uint64_t bits = rng_();
+      double v;
+      memcpy(&v, &bits, sizeof(v));
+      value.value = v;
+      break;
+    }
+    case 5: {
+      static const char kHexDigits[] = "0123456789abcdef";
+      auto &hex = strings_.emplace_back(Uniform(1, 40), '0');
+      for (auto &c : hex) {
+        c = kHexDigits[Uniform(0, 15)];
+      }
+      value.value = StandardLargeInt{hex};
+      break;
+    }
+    case 6: {
+      auto &string = strings_.emplace_back(Length(), '\0');
+      for (auto &c : string) {
+        c = static_cast<char>(Uniform(0, 255));
+      }
+      value.value = std::string_view(string);
+      break;
+    }
+    case 7:
+      value.value = TypedList<uint8_t>();
+      break;
+    case 8:
+      value.value = TypedList<int32_t>();
+      break;
+    case 9:
+      value.value = TypedList<int64_t>();
+      break;
+    case 10:
+      value.value = TypedList<float>();
+      break;
+    case 11:
+      value.value = TypedList<double>();
+      break;
+    case 12:
+      value.value = std::string_view("a key");
+      break;
+    case 13: {
+      StandardList list(Uniform(0, 6));
+      for (auto &item : list) {
+        item = Next(depth + 1);
+      }
+      value.value = std::move(list);
+      break;
+    }
+    case 14: {
+      StandardMap map(Uniform(0, 6));
+      for (auto &entry : map) {
+        entry.key   = Next(depth + 1);
+        entry.value = Next(depth + 1);
+      }
+      value.value = std::move(map);
+      break;
+    }
+    }
+
+    return value;
+  }
+
+  size_t Uniform(size_t min, size_t max) {
+    return std::uniform_int_distribution<size_t>(min, max)(rng_);
+  }
+
+private:
+  static constexpr size_t kMaxDepth = 4;
+
+  // Mostly short, sometimes past the one (254) and the two (65535) byte size encodings.
+  size_t Length() {
+    switch (Uniform(0, 20)) {
+    case 0:
+      return Uniform(254, 1000);
+    case 1:
+      return Uniform(65536, 70000);
+    default:
+      return Uniform(0, 32);
+    }
+  }
+
+  template <typename T> std::span<const T> TypedList() {
+    const size_t size = Length() / sizeof(T);
+    auto &storage     = storage_.emplace_back((size * sizeof(T) + 7) / 8);
+
+    for (auto &word : storage) {
+      word = rng_();
+    }
+
+    return std::span<const T>(reinterpret_cast<const T *>(storage.data()), size);
+  }
+
+  std::mt19937_64 rng_;
+  std::deque<std::string> strings_;
+  std::deque<std::vector<uint64_t>> storage_;
+};
+
+static std::vector<uint8_t> Encode(const StandardValue &value) {
+  StandardMessageWriter writer;
+  writer.Write(value);
+  return std::vector<uint8_t>(writer.data(), writer.data() + writer.size());
+}
+
+// Encoding a value and decoding it back gives the same value, and encoding that one gives the same bytes.
+TEST(StandardCodecTest, RoundTripsRandomValues) {
+  RandomValues values(0x5eed);
+
+  for (int i = 0; i < 2000; i++) {
+    const StandardValue value = values.Next();
+    const auto bytes          = Encode(value);
+
+    StandardMessageReader reader(bytes.data(), bytes.size());
+    StandardValue decoded;
+
+    ASSERT_TRUE(reader.Read(&decoded)) << "value " << i;
+    ASSERT_TRUE(reader.AtEnd()) << "value " << i;
+    ASSERT_TRUE(Same(value, decoded)) << "value " << i;
+    ASSERT_EQ(Encode(decoded), bytes) << "value " << i;
+  }
+}
+
+// Arbitrary damage to valid messages never crashes the reader, and whatever it accepts round-trips.
+TEST(StandardCodecTest, DecodesMutatedMessagesSafely) {
+  RandomValues values(0xf022);
+  size_t accepted = 0;
+
+  for (int i = 0; i < 5000; i++) {
+    auto bytes = Encode(values.Next());
+
+    switch (values.Uniform(0, 2)) {
+    case 0:
+      bytes.resize(values.Uniform(0, bytes.size()));
+      break;
+    case 1:
+      for (size_t flips = values.Uniform(1, 4); flips > 0 && !bytes.empty(); flips--) {
+        bytes[values.Uniform(0, bytes.size() - 1)] = static_cast<uint8_t>(values.Uniform(0, 255));
+      }
+      break;
+    case 2:
+      bytes.insert(bytes.begin() + values.Uniform(0, bytes.size()), static_cast<uint8_t>(values.Uniform(0, 255)));
+      break;
+    }
+
+    StandardMessageReader reader(bytes.data(), bytes.size());
+    StandardValue decoded;
+
+    if (!reader.Read(&decoded)) {
+      continue;
+    }
+
+    accepted++;
+
+    // Not necessarily the same bytes: the padding and the size encodings are normalized.
+    const auto normalized = Encode(decoded);
+    StandardMessageReader normalized_reader(normalized.data(), normalized.size());
+    StandardValue redecoded;
+
+    ASSERT_TRUE(normalized_reader.Read(&redecoded)) << "message " << i;
+    ASSERT_TRUE(normalized_reader.AtEnd()) << "message " << i;
+    ASSERT_TRUE(Same(decoded, redecoded)) << "message " << i;
+  }
+
+  EXPECT_GT(accepted, 0u);
+}
+
+TEST(StandardCodecTest, KeepsLargeIntsApartFromStrings) {
+  const uint8_t message[] = {5 /* kLargeInt */, 3, '1', 'f', 'f'};
+
+  StandardMessageReader reader(message, sizeof(message));
+  StandardValue value;
+
+  ASSERT_TRUE(reader.Read(&value));
+  ASSERT_NE(value.Get<StandardLargeInt>(), nullptr);
+  EXPECT_EQ(value.Get<StandardLargeInt>()->hex, "1ff");
+  EXPECT_EQ(value.Get<std::string_view>(), nullptr);
+
+  EXPECT_EQ(Encode(value), std::vector<uint8_t>(std::begin(message), std::end(message)));
+}
+
+TEST(StandardCodecTest, KeepsTheIntegerWidth) {
+  StandardMessageWriter writer;
+  writer.WriteInt(1);
+  writer.WriteInt(int64_t(1) << 40);
+  writer.Write(StandardValue{int64_t(1)});
+
+  StandardMessageReader reader(writer.data(), writer.size());
+  StandardValue values[3];
+
+  for (auto &value : values) {
+    ASSERT_TRUE(reader.Read(&value));
+  }
+
+  EXPECT_NE(values[0].Get<int32_t>(), nullptr);
+  EXPECT_NE(values[1].Get<int64_t>(), nullptr);
+  EXPECT_NE(values[2].Get<int64_t>(), nullptr);
+}
+
+TEST(StandardCodecTest, RejectsTooDeepNesting) {
+  std::vector<uint8_t> message;
+
+  for (int i = 0; i < 1000; i++) {
+    message.insert(message.end(), {12 /* kList */, 1});
+  }
+
+  message.push_back(0);
+
+  StandardMessageReader reader(message.data(), message.size());
+  StandardValue value;
+
+  EXPECT_FALSE(reader.Read(&value));
+}
+
+TEST(StandardCodecTest, RoundTripsMethodCalls) {
+  RandomValues values(0xca11);
+
+  for (int i = 0; i < 500; i++) {
+    const StandardValue arguments = values.Next();
+
+    StandardMessageWriter writer;
+    StandardMethodCodec::EncodeMethodCall(writer, "method", arguments);
+
+    StandardMessageReader reader(writer.data(), writer.size());
+    std::string_view method;
+    StandardValue decoded;
+
+    ASSERT_TRUE(StandardMethodCodec::DecodeMethodCall(reader, &method, &decoded)) << "call " << i;
+    EXPECT_EQ(method, "method");
+    ASSERT_TRUE(Same(arguments, decoded)) << "call " << i;
+  }
+}
+
+TEST(StandardCodecTest, RoundTripsEnvelopes) {
+  RandomValues values(0xe4e1);
+
+  for (int i = 0; i < 500; i++) {
+    const StandardValue payload = values.Next();
+    const bool error            = i % 2 == 1;
+
+    StandardMessageWriter writer;
+
+    if (error) {
+      StandardMethodCodec::EncodeErrorEnvelope(writer, "code", "message", payload);
+    } else {
+      StandardMethodCodec::EncodeSuccessEnvelope(writer, payload);
+    }
+
+    StandardMessageReader reader(writer.data(), writer.size());
+    StandardValue result;
+    StandardMethodError method_error;
+    bool is_error;
+
+    ASSERT_TRUE(StandardMethodCodec::DecodeEnvelope(reader, &result, &method_error, &is_error)) << "envelope " << i;
+    ASSERT_EQ(is_error, error);
+
+    if (error) {
+      EXPECT_EQ(method_error.code, "code");
+      EXPECT_EQ(method_error.message, "message");
+      ASSERT_TRUE(Same(payload, method_error.details)) << "envelope " << i;
+    } else {
+      ASSERT_TRUE(Same(payload, result)) << "envelope " << i;
+    }
+  }
+}
+
+} // namespace flutter::testing
@@ -0,0 +1,44 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cstdio>
+
+#include "stub_engine.h"
+
+namespace flutter::testing {
+
+FlutterEngine GetStubEngine() {
+  static const FlutterEngine engine = [] {
+    static FlutterTaskRunnerDescription platform_task_runner = {};
+    platform_task_runner.struct_size                          = sizeof(FlutterTaskRunnerDescription);
+    platform_task_runner.runs_task_on_current_thread_callback = [](void *) { return true; };
+    platform_task_runner.post_task_callback                   = [](FlutterTask, uint64_t, void *) {};
+    platform_task_runner.identifier                           = 1;
+
+    static FlutterCustomTaskRunners custom_task_runners = {};
+    custom_task_runners.struct_size                     = sizeof(FlutterCustomTaskRunners);
+    custom_task_runners.platform_task_runner            = &platform_task_runner;
+
+    FlutterRendererConfig config = {};
+    config.type                  = kOpenGL;
+
+    FlutterProjectArgs args  = {};
+    args.struct_size         = sizeof(FlutterProjectArgs);
+    args.vsync_callback      = [](void *, intptr_t) {};
+    args.custom_task_runners = &custom_task_runners;
+
+    FlutterEngine engine = nullptr;
+
+    if (FlutterEngineInitialize(FLUTTER_ENGINE_VERSION, &config, &args, nullptr, &engine) != kSuccess) {
+      fprintf(stderr, "could not initialize the stub engine\n");
+      return static_cast<FlutterEngine>(nullptr);
+    }
+
+    return engine;
+  }();
+
+  return engine;
+}
+
+} // namespace flutter::testing
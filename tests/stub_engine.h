@@ -0,0 +1,16 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+namespace flutter::testing {
+
+// Stub engine (tools/flutter_engine_stub.cc) which is initialized but not running: it produces no
+// frames, platform tasks nor messages on its own, it only takes the embedder API calls. Platform
+// tasks it posts (replies) are dropped.
+FlutterEngine GetStubEngine();
+
+} // namespace flutter::testing
@@ -0,0 +1,78 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "surfaceless_egl.h"
+
+namespace flutter::testing {
+
+EGLDisplay GetSurfacelessDisplay() {
+  static const EGLDisplay display = [] {
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+    if (get_platform_display == nullptr) {
+      return EGL_NO_DISPLAY;
+    }
+
+    EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr) != EGL_TRUE) {
+      display = EGL_NO_DISPLAY;
+    }
+
+    return display;
+  }();
+
+  return display;
+}
+
+PbufferContext::PbufferContext(const EGLConfigPolicy &policy, EGLint width, EGLint height) {
+  display_ = GetSurfacelessDisplay();
+
+  if (display_ == EGL_NO_DISPLAY) {
+    return;
+  }
+
+  EGLConfigPolicy pbuffer_policy = policy;
+  pbuffer_policy.surface_type    = EGL_PBUFFER_BIT;
+
+  config_ = ChooseEGLConfig(display_, pbuffer_policy);
+
+  if (config_ == nullptr) {
+    return;
+  }
+
+  const EGLint surface_attribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+
+  surface_ = eglCreatePbufferSurface(display_, config_, surface_attribs);
+
+  if (surface_ == EGL_NO_SURFACE) {
+    return;
+  }
+
+  const EGLContext context = eglCreateContext(display_, config_, EGL_NO_CONTEXT, context_attribs);
+
+  if (context != EGL_NO_CONTEXT && eglMakeCurrent(display_, surface_, surface_, context) != EGL_TRUE) {
+    eglDestroyContext(display_, context);
+    return;
+  }
+
+  context_ = context;
+}
+
+PbufferContext::~PbufferContext() {
+  if (context_ != EGL_NO_CONTEXT) {
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display_, context_);
+  }
+
+  if (surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, surface_);
+  }
+}
+
+} // namespace flutter::testing
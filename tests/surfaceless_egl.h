@@ -0,0 +1,45 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+
+#include "egl_utils.h"
+
+namespace flutter::testing {
+
+// Display of Mesa's surfaceless platform (no window system needed), initialized once.
+// Returns EGL_NO_DISPLAY if it is not available.
+EGLDisplay GetSurfacelessDisplay();
+
+// ES2 context current on a pbuffer of the config ChooseEGLConfig() picks for the policy.
+class PbufferContext {
+public:
+  PbufferContext(const EGLConfigPolicy &policy, EGLint width, EGLint height);
+
+  ~PbufferContext();
+
+  bool IsValid() const {
+    return context_ != EGL_NO_CONTEXT;
+  }
+
+  EGLDisplay display() const {
+    return display_;
+  }
+
+  EGLConfig config() const {
+    return config_;
+  }
+
+private:
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  EGLConfig config_   = nullptr;
+  EGLSurface surface_ = EGL_NO_SURFACE;
+  EGLContext context_ = EGL_NO_CONTEXT;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PbufferContext)
+};
+
+} // namespace flutter::testing
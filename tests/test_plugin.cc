@@ -0,0 +1,35 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Native plugin of the plugin host tests: handles "test/slow" in 20ms and counts the messages.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "plugin_api.h"
+
+static const FlutterWaylandPluginHostApi *api;
+static std::atomic<int> handled = 0;
+
+extern "C" {
+
+__attribute__((visibility("default"))) int test_plugin_handled() {
+  return handled;
+}
+
+__attribute__((visibility("default"))) bool flutter_wayland_plugin_init(const FlutterWaylandPluginHostApi *host_api) {
+  api = host_api;
+
+  return api->set_message_handler(
+      api->host, "test/slow",
+      [](void *, const char *, const uint8_t *message, size_t message_size, FlutterWaylandResponder *responder) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        handled++;
+        api->respond(responder, message, message_size);
+      },
+      nullptr);
+}
+
+} // extern "C"
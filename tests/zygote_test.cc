@@ -0,0 +1,66 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "compositor_harness.h"
+
+namespace flutter::testing {
+
+static const char kStartup[] = "INFO: startup: ";
+
+static double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+// Launch-to-first-frame of a cold exec (from the process start) against a child of a pre-warmed
+// zygote (from the launch request), as logged by the launcher itself. On the stub engine the zygote
+// only saves the exec and the dynamic linking of the launcher, so the gain is reported, not asserted.
+TEST(ZygoteTest, LaunchToFirstFrame) {
+  constexpr int kRuns = 5;
+
+  std::vector<double> cold_ms;
+  std::vector<double> zygote_ms;
+
+  for (int i = 0; i < kRuns; i++) {
+    for (const bool zygote : {false, true}) {
+      const auto run = RunCompositor({
+          .script = "frames 10\n"
+                    "quit\n",
+          .zygote = zygote,
+          .env    = {{"FLUTTER_ENGINE_STUB_FRAMES", "60"}},
+      });
+
+      ASSERT_EQ(run.status, 0) << run.output;
+      ASSERT_FALSE(run.timed_out) << run.output;
+
+      const double first_frame_ms = run.Stat(kStartup, "time to first presented frame:");
+      ASSERT_FALSE(std::isnan(first_frame_ms)) << run.output;
+
+      if (zygote) {
+        EXPECT_TRUE(run.Contains("zygote: launched")) << run.output;
+        zygote_ms.push_back(first_frame_ms);
+      } else {
+        cold_ms.push_back(first_frame_ms);
+      }
+    }
+  }
+
+  const double cold   = Median(cold_ms);
+  const double warmed = Median(zygote_ms);
+
+  printf("launch to first frame (median of %d): cold exec %.3fms, zygote %.3fms\n", kRuns, cold, warmed);
+
+  RecordProperty("cold_exec_ms", std::to_string(cold));
+  RecordProperty("zygote_ms", std::to_string(warmed));
+}
+
+} // namespace flutter::testing
@@ -0,0 +1,634 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Stub libflutter_engine.so for measuring the embedder overhead in isolation: no Dart, no Skia.
+//
+// It implements the part of the embedder API used by flutter-launcher-wayland and plays the role
+// of the engine threads with a scripted workload:
+//  - the UI thread requests a vsync for every frame and "builds" it (busy loop),
+//  - the raster thread "rasterizes" it (busy loop), clears the onscreen surface and presents it,
+//  - a ticker thread posts platform tasks and platform messages at the configured rates.
+//
+// Every FLUTTER_ENGINE_STUB_REPORT_FRAMES frames the CPU time, context switches and heap allocations
+// of the whole process (so mostly of the embedder) are reported per frame on stderr.
+//
+// Configuration (environment variables):
+//   FLUTTER_ENGINE_STUB_FRAMES=<int>         frames to produce before the process exits (default: 0, run forever)
+//   FLUTTER_ENGINE_STUB_BUILD_US=<int>       UI thread work per frame (default: 2000)
+//   FLUTTER_ENGINE_STUB_RASTER_US=<int>      raster thread work per frame (default: 4000)
+//   FLUTTER_ENGINE_STUB_TASK_HZ=<int>        platform tasks posted per second (default: 120)
+//   FLUTTER_ENGINE_STUB_TASK_US=<int>        platform thread work per task (default: 0), e.g. to measure the input latency
+//                                            under a platform task load
+//   FLUTTER_ENGINE_STUB_MESSAGE_HZ=<int>     platform messages sent to the embedder per second (default: 10)
+//   FLUTTER_ENGINE_STUB_REPORT_FRAMES=<int>  report interval (default: 300)
+
+#include <flutter_embedder.h>
+
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#define STUBTAG "engine-stub: "
+
+// Heap allocations of the whole process. The stub library comes before libc in the lookup
+// scope of the launcher, so its malloc() interposes the libc one.
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+static std::atomic<uint64_t> allocations = 0;
+static thread_local bool stub_allocation = false; // the stub's own ones are not accounted
+
+extern "C" void *malloc(size_t size) noexcept {
+  if (!stub_allocation) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size) noexcept {
+  if (!stub_allocation) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept {
+  if (!stub_allocation) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  return __libc_realloc(ptr, size);
+}
+
+struct ScopedStubAllocation {
+  ScopedStubAllocation()
+      : previous(stub_allocation) {
+    stub_allocation = true;
+  }
+  ~ScopedStubAllocation() {
+    stub_allocation = previous;
+  }
+  const bool previous;
+};
+#else
+static std::atomic<uint64_t> allocations = 0;
+
+struct ScopedStubAllocation {};
+#endif
+
+static uint64_t GetEnvInt(const char *name, uint64_t default_value) {
+  const char *value = getenv(name);
+  return value ? strtoull(value, nullptr, 10) : default_value;
+}
+
+static void BusyWait(uint64_t us) {
+  const uint64_t end_ns = FlutterEngineGetCurrentTime() + us * 1'000;
+  while (FlutterEngineGetCurrentTime() < end_ns) {
+  }
+}
+
+struct _FlutterPlatformMessageResponseHandle {
+  FlutterDataCallback callback = nullptr; // nullptr for the messages sent by the stub
+  void *user_data              = nullptr;
+};
+
+struct _FlutterEngine {
+  // Platform tasks carry everything they need in FlutterTask::task, so posting them does not allocate:
+  // a target time for ticks and messages (shifted left by 2) or a PendingReply pointer.
+  enum TaskKind : uint64_t { kTick = 0, kMessage = 1, kReply = 2, kKindMask = 3 };
+
+  struct PendingReply {
+    FlutterDataCallback callback;
+    void *user_data;
+  };
+
+  FlutterOpenGLRendererConfig open_gl;
+  FlutterPlatformMessageCallback platform_message_callback = nullptr;
+  VsyncCallback vsync_callback                             = nullptr;
+  FlutterTaskRunnerDescription platform_runner             = {};
+  void *user_data                                          = nullptr;
+
+  struct {
+    uint64_t frames;
+    uint64_t build_us;
+    uint64_t raster_us;
+    uint64_t task_hz;
+    uint64_t task_us;
+    uint64_t message_hz;
+    uint64_t report_frames;
+  } config;
+
+  std::atomic<bool> running = false;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool has_metrics       = false;
+  intptr_t pending_baton = 0; // waiting for FlutterEngineOnVsync
+  bool vsync_arrived     = false;
+  bool frame_built       = false; // waiting for the raster thread
+
+  std::thread ui_thread;
+  std::thread raster_thread;
+  std::thread ticker_thread;
+
+  std::unique_ptr<uint8_t[]> message_copy; // of the last platform message from the embedder
+
+  struct {
+    std::atomic<uint64_t> frames         = 0;
+    std::atomic<uint64_t> vsync_wait_ns  = 0;
+    std::atomic<uint64_t> tasks          = 0;
+    std::atomic<uint64_t> task_late_ns   = 0;
+    std::atomic<uint64_t> task_late_max  = 0;
+    std::atomic<uint64_t> messages_in    = 0; // from the embedder
+    std::atomic<uint64_t> messages_out   = 0;
+    std::atomic<uint64_t> replies_in     = 0; // from the embedder
+    std::atomic<uint64_t> replies_out    = 0;
+    std::atomic<uint64_t> pointer_events = 0;
+    std::atomic<uint64_t> pointer_timed  = 0; // with a timestamp of this clock
+    std::atomic<uint64_t> pointer_lat_us = 0; // event timestamp -> received, summed
+    std::atomic<uint64_t> pointer_max_us = 0;
+    std::atomic<uint64_t> key_events     = 0; // flutter/keyevent messages
+    std::atomic<uint64_t> key_first_ns   = 0;
+    std::atomic<uint64_t> key_last_ns    = 0;
+    std::atomic<uint64_t> metrics_events = 0; // window metrics
+    std::atomic<uint64_t> metrics_early  = 0; // window metrics before the first frame got presented
+  } stats;
+
+  struct Sample {
+    uint64_t time_ns;
+    struct rusage usage;
+    uint64_t frames;
+    uint64_t allocations;
+    uint64_t vsync_wait_ns;
+  } last_report;
+
+  void PostPlatformTask(uint64_t task, uint64_t target_time_ns) {
+    platform_runner.post_task_callback(FlutterTask{.runner = reinterpret_cast<FlutterTaskRunner>(this), .task = task}, target_time_ns, platform_runner.user_data);
+  }
+
+  static Sample TakeSample(const _FlutterEngine *engine) {
+    Sample sample;
+    sample.time_ns = FlutterEngineGetCurrentTime();
+    getrusage(RUSAGE_SELF, &sample.usage);
+    sample.frames        = engine->stats.frames.load();
+    sample.allocations   = allocations.load();
+    sample.vsync_wait_ns = engine->stats.vsync_wait_ns.load();
+    return sample;
+  }
+
+  void Report() {
+    const Sample now = TakeSample(this);
+    const double frames = static_cast<double>(now.frames - last_report.frames);
+
+    if (frames == 0) {
+      return;
+    }
+
+    auto us = [](const struct timeval &a, const struct timeval &b) { return (a.tv_sec - b.tv_sec) * 1e6 + (a.tv_usec - b.tv_usec); };
+
+    const double user_us = us(now.usage.ru_utime, last_report.usage.ru_utime);
+    const double sys_us  = us(now.usage.ru_stime, last_report.usage.ru_stime);
+    const uint64_t tasks = stats.tasks.exchange(0);
+    const uint64_t late  = stats.task_late_ns.exchange(0);
+
+    fprintf(stderr,
+            STUBTAG "frames: %ju fps: %.1f cpu/frame: %.0fus (user: %.0fus sys: %.0fus, stub busy loops: %juus) "
+                    "ctxsw/frame: %.2f (involuntary: %.2f) allocs/frame: %.1f vsync wait: %.0fus "
+                    "tasks: %ju late avg: %.0fus max: %.0fus messages in/out: %ju/%ju replies in/out: %ju/%ju pointer events: %ju key events: %ju key span: %.1fms "
+                    "pointer latency avg: %.0fus (max: %.0fus) window metrics: %ju startup window metrics: %ju\n",
+            static_cast<uintmax_t>(now.frames), frames * 1e9 / (now.time_ns - last_report.time_ns), (user_us + sys_us) / frames, user_us / frames, sys_us / frames,
+            static_cast<uintmax_t>(config.build_us + config.raster_us), (now.usage.ru_nvcsw - last_report.usage.ru_nvcsw) / frames, (now.usage.ru_nivcsw - last_report.usage.ru_nivcsw) / frames,
+            (now.allocations - last_report.allocations) / frames, (now.vsync_wait_ns - last_report.vsync_wait_ns) / frames / 1e3, static_cast<uintmax_t>(tasks), tasks ? late / 1e3 / tasks : 0.,
+            stats.task_late_max.exchange(0) / 1e3, static_cast<uintmax_t>(stats.messages_in.load()), static_cast<uintmax_t>(stats.messages_out.load()), static_cast<uintmax_t>(stats.replies_in.load()), static_cast<uintmax_t>(stats.replies_out.load()),
+            static_cast<uintmax_t>(stats.pointer_events.load()), static_cast<uintmax_t>(stats.key_events.load()), (stats.key_last_ns.load() - stats.key_first_ns.load()) / 1e6,
+            stats.pointer_timed ? static_cast<double>(stats.pointer_lat_us.load()) / stats.pointer_timed : 0., static_cast<double>(stats.pointer_max_us.load()), static_cast<uintmax_t>(stats.metrics_events.load()), static_cast<uintmax_t>(stats.metrics_early.load()));
+
+    last_report = now;
+  }
+
+  void UIThread() {
+    for (uint64_t frame = 0; running && (config.frames == 0 || frame < config.frames); frame++) {
+      const intptr_t baton = static_cast<intptr_t>(frame + 1);
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !running || has_metrics; });
+        pending_baton = baton;
+        vsync_arrived = false;
+      }
+
+      const uint64_t requested_ns = FlutterEngineGetCurrentTime();
+      vsync_callback(user_data, baton);
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !running || vsync_arrived; });
+      }
+
+      stats.vsync_wait_ns += FlutterEngineGetCurrentTime() - requested_ns;
+
+      BusyWait(config.build_us);
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !running || !frame_built; });
+        frame_built = true;
+      }
+      cv.notify_all();
+    }
+
+    if (running && config.frames != 0) {
+      // Let the last frame be presented.
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [this] { return !running || !frame_built; });
+
+      Report();
+      fprintf(stderr, STUBTAG "%ju frames done\n", static_cast<uintmax_t>(config.frames));
+      _exit(0);
+    }
+  }
+
+  void RasterThread() {
+    if (!open_gl.make_current(user_data)) {
+      fprintf(stderr, STUBTAG "make_current failed\n");
+      return;
+    }
+
+    auto clear_color = reinterpret_cast<void (*)(float, float, float, float)>(open_gl.gl_proc_resolver(user_data, "glClearColor"));
+    auto clear       = reinterpret_cast<void (*)(uint32_t)>(open_gl.gl_proc_resolver(user_data, "glClear"));
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !running || frame_built; });
+
+        if (!running) {
+          break;
+        }
+      }
+
+      BusyWait(config.raster_us);
+
+      const uint64_t frame = stats.frames + 1;
+
+      if (clear_color && clear) {
+        clear_color((frame % 64) / 63.f, 0.f, 0.f, 1.f);
+        clear(0x00004000 /* GL_COLOR_BUFFER_BIT */);
+      }
+
+      open_gl.present(user_data);
+
+      stats.frames++;
+
+      if (frame % config.report_frames == 0) {
+        Report();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        frame_built = false;
+      }
+      cv.notify_all();
+    }
+
+    open_gl.clear_current(user_data);
+  }
+
+  void TickerThread() {
+    const uint64_t hz        = std::max(config.task_hz, config.message_hz);
+    const uint64_t period_ns = 1'000'000'000 / hz;
+    uint64_t next_ns         = FlutterEngineGetCurrentTime();
+
+    for (uint64_t tick = 0; running; tick++) {
+      next_ns += period_ns;
+
+      const struct timespec ts = {.tv_sec = static_cast<time_t>(next_ns / 1'000'000'000), .tv_nsec = static_cast<long>(next_ns % 1'000'000'000)};
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+      const uint64_t now_ns = FlutterEngineGetCurrentTime();
+
+      // Both rates are spread evenly over the ticks of the faster one.
+      if (config.task_hz && (tick * config.task_hz) / hz != ((tick + 1) * config.task_hz) / hz) {
+        PostPlatformTask(now_ns << 2 | kTick, now_ns);
+      }
+
+      if (config.message_hz && (tick * config.message_hz) / hz != ((tick + 1) * config.message_hz) / hz) {
+        PostPlatformTask(now_ns << 2 | kMessage, now_ns);
+      }
+    }
+  }
+
+  // Platform thread.
+  void RunTask(uint64_t task) {
+    switch (task & kKindMask) {
+    case kTick:
+    case kMessage: {
+      const uint64_t late_ns = FlutterEngineGetCurrentTime() - (task >> 2);
+
+      stats.tasks++;
+      stats.task_late_ns += late_ns;
+
+      uint64_t max = stats.task_late_max;
+      while (late_ns > max && !stats.task_late_max.compare_exchange_weak(max, late_ns)) {
+      }
+
+      if ((task & kKindMask) == kTick) {
+        BusyWait(config.task_us);
+      }
+
+      if ((task & kKindMask) == kMessage) {
+        static const uint8_t payload[16] = {};
+
+        FlutterPlatformMessageResponseHandle *handle;
+        {
+          ScopedStubAllocation scope;
+          handle = new FlutterPlatformMessageResponseHandle();
+        }
+
+        const FlutterPlatformMessage message = {
+            .struct_size     = sizeof(FlutterPlatformMessage),
+            .channel         = "flutter_engine_stub/ping",
+            .message         = payload,
+            .message_size    = sizeof(payload),
+            .response_handle = handle,
+        };
+
+        stats.messages_out++;
+        platform_message_callback(&message, user_data);
+      }
+      break;
+    }
+    case kReply: {
+      auto *const reply = reinterpret_cast<PendingReply *>(task & ~kKindMask);
+
+      stats.replies_out++;
+      reply->callback(nullptr, 0, reply->user_data);
+
+      ScopedStubAllocation scope;
+      delete reply;
+      break;
+    }
+    }
+  }
+};
+
+extern "C" {
+
+uint64_t FlutterEngineGetCurrentTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+bool FlutterEngineRunsAOTCompiledDartCode(void) {
+  return false;
+}
+
+FlutterEngineResult FlutterEngineInitialize(size_t version, const FlutterRendererConfig *config, const FlutterProjectArgs *args, void *user_data, FlutterEngine *engine_out) {
+  if (config == nullptr || config->type != kOpenGL || args == nullptr || engine_out == nullptr || args->vsync_callback == nullptr || args->custom_task_runners == nullptr ||
+      args->custom_task_runners->platform_task_runner == nullptr) {
+    fprintf(stderr, STUBTAG "only the OpenGL renderer with a vsync callback and a custom platform task runner is supported\n");
+    return kInvalidArguments;
+  }
+
+  ScopedStubAllocation scope;
+
+  auto *const engine = new _FlutterEngine();
+
+  engine->open_gl                   = config->open_gl;
+  engine->platform_message_callback = args->platform_message_callback;
+  engine->vsync_callback            = args->vsync_callback;
+  engine->platform_runner           = *args->custom_task_runners->platform_task_runner;
+  engine->user_data                 = user_data;
+
+  engine->config.frames        = GetEnvInt("FLUTTER_ENGINE_STUB_FRAMES", 0);
+  engine->config.build_us      = GetEnvInt("FLUTTER_ENGINE_STUB_BUILD_US", 2000);
+  engine->config.raster_us     = GetEnvInt("FLUTTER_ENGINE_STUB_RASTER_US", 4000);
+  engine->config.task_hz       = GetEnvInt("FLUTTER_ENGINE_STUB_TASK_HZ", 120);
+  engine->config.task_us       = GetEnvInt("FLUTTER_ENGINE_STUB_TASK_US", 0);
+  engine->config.message_hz    = GetEnvInt("FLUTTER_ENGINE_STUB_MESSAGE_HZ", 10);
+  engine->config.report_frames = std::max<uint64_t>(GetEnvInt("FLUTTER_ENGINE_STUB_REPORT_FRAMES", 300), 1);
+
+  *engine_out = engine;
+
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineRunInitialized(FlutterEngine engine) {
+  ScopedStubAllocation scope;
+
+  fprintf(stderr, STUBTAG "frames: %ju build: %juus raster: %juus tasks: %juHz x %juus messages: %juHz\n", static_cast<uintmax_t>(engine->config.frames), static_cast<uintmax_t>(engine->config.build_us),
+          static_cast<uintmax_t>(engine->config.raster_us), static_cast<uintmax_t>(engine->config.task_hz), static_cast<uintmax_t>(engine->config.task_us), static_cast<uintmax_t>(engine->config.message_hz));
+
+  engine->last_report = _FlutterEngine::TakeSample(engine);
+  engine->running     = true;
+
+  engine->ui_thread     = std::thread(&_FlutterEngine::UIThread, engine);
+  engine->raster_thread = std::thread(&_FlutterEngine::RasterThread, engine);
+
+  if (engine->config.task_hz || engine->config.message_hz) {
+    engine->ticker_thread = std::thread(&_FlutterEngine::TickerThread, engine);
+  }
+
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineRun(size_t version, const FlutterRendererConfig *config, const FlutterProjectArgs *args, void *user_data, FlutterEngine *engine_out) {
+  const auto result = FlutterEngineInitialize(version, config, args, user_data, engine_out);
+  return result == kSuccess ? FlutterEngineRunInitialized(*engine_out) : result;
+}
+
+FlutterEngineResult FlutterEngineShutdown(FlutterEngine engine) {
+  if (engine == nullptr) {
+    return kInvalidArguments;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(engine->mutex);
+    engine->running = false;
+  }
+  engine->cv.notify_all();
+
+  for (auto *thread : {&engine->ui_thread, &engine->raster_thread, &engine->ticker_thread}) {
+    if (thread->joinable()) {
+      thread->join();
+    }
+  }
+
+  engine->Report();
+
+  ScopedStubAllocation scope;
+  delete engine;
+
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineDeinitialize(FlutterEngine engine) {
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineSendWindowMetricsEvent(FlutterEngine engine, const FlutterWindowMetricsEvent *event) {
+  engine->stats.metrics_events++;
+
+  // Each one relayouts the first frame with the real engine.
+  if (engine->stats.frames == 0) {
+    engine->stats.metrics_early++;
+  }
+
+  // Like the real engine, nothing is drawn until the size is known.
+  if (event->width > 0 && event->height > 0) {
+    {
+      std::lock_guard<std::mutex> lock(engine->mutex);
+      engine->has_metrics = true;
+    }
+    engine->cv.notify_all();
+  }
+
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineSendPointerEvent(FlutterEngine engine, const FlutterPointerEvent *events, size_t events_count) {
+  engine->stats.pointer_events += events_count;
+
+  // The timestamps are the Wayland ones, truncated milliseconds of CLOCK_MONOTONIC: the latency reads up to 1ms high.
+  const uint64_t now_us = FlutterEngineGetCurrentTime() / 1'000;
+
+  for (size_t i = 0; i < events_count; i++) {
+    const uint64_t latency_us = now_us - events[i].timestamp;
+
+    if (latency_us < 10'000'000) {
+      engine->stats.pointer_timed++;
+      engine->stats.pointer_lat_us += latency_us;
+
+      uint64_t max = engine->stats.pointer_max_us;
+      while (latency_us > max && !engine->stats.pointer_max_us.compare_exchange_weak(max, latency_us)) {
+      }
+    }
+  }
+
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineSendPlatformMessage(FlutterEngine engine, const FlutterPlatformMessage *message) {
+  engine->stats.messages_in++;
+
+  // The engine owns a copy of the message once the call returns (and copies it once more into the
+  // Dart heap, which is not modelled).
+  {
+    ScopedStubAllocation scope;
+    engine->message_copy.reset(new uint8_t[message->message_size]);
+  }
+
+  if (message->message_size > 0) {
+    memcpy(engine->message_copy.get(), message->message, message->message_size);
+  }
+
+  // The time from the first to the last one tells the input throughput.
+  if (strcmp(message->channel, "flutter/keyevent") == 0) {
+    const uint64_t now_ns = FlutterEngineGetCurrentTime();
+
+    if (engine->stats.key_events++ == 0) {
+      engine->stats.key_first_ns = now_ns;
+    }
+    engine->stats.key_last_ns = now_ns;
+  }
+
+  // The framework would reply on the platform thread; an empty reply means not implemented.
+  if (message->response_handle != nullptr) {
+    _FlutterEngine::PendingReply *reply;
+    {
+      ScopedStubAllocation scope;
+      reply = new _FlutterEngine::PendingReply{message->response_handle->callback, message->response_handle->user_data};
+    }
+    engine->PostPlatformTask(reinterpret_cast<uint64_t>(reply) | _FlutterEngine::kReply, FlutterEngineGetCurrentTime());
+  }
+
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterPlatformMessageCreateResponseHandle(FlutterEngine engine, FlutterDataCallback data_callback, void *user_data, FlutterPlatformMessageResponseHandle **response_out) {
+  ScopedStubAllocation scope;
+  *response_out = new FlutterPlatformMessageResponseHandle{data_callback, user_data};
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterPlatformMessageReleaseResponseHandle(FlutterEngine engine, FlutterPlatformMessageResponseHandle *response) {
+  ScopedStubAllocation scope;
+  delete response;
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineSendPlatformMessageResponse(FlutterEngine engine, const FlutterPlatformMessageResponseHandle *handle, const uint8_t *data, size_t data_length) {
+  engine->stats.replies_in++;
+
+  ScopedStubAllocation scope;
+  delete handle;
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineRegisterExternalTexture(FlutterEngine engine, int64_t texture_identifier) {
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineUnregisterExternalTexture(FlutterEngine engine, int64_t texture_identifier) {
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineMarkExternalTextureFrameAvailable(FlutterEngine engine, int64_t texture_identifier) {
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineOnVsync(FlutterEngine engine, intptr_t baton, uint64_t frame_start_time_nanos, uint64_t frame_target_time_nanos) {
+  {
+    std::lock_guard<std::mutex> lock(engine->mutex);
+
+    if (baton != engine->pending_baton) {
+      fprintf(stderr, STUBTAG "unexpected baton: %jd (pending: %jd)\n", static_cast<intmax_t>(baton), static_cast<intmax_t>(engine->pending_baton));
+      return kInvalidArguments;
+    }
+
+    engine->pending_baton = 0;
+    engine->vsync_arrived = true;
+  }
+  engine->cv.notify_all();
+
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineRunTask(FlutterEngine engine, const FlutterTask *task) {
+  engine->RunTask(task->task);
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineUpdateLocales(FlutterEngine engine, const FlutterLocale **locales, size_t locales_count) {
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineNotifyLowMemoryWarning(FlutterEngine engine) {
+  fprintf(stderr, STUBTAG "low memory warning\n");
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEnginePostDartObject(FlutterEngine engine, FlutterEngineDartPort port, const FlutterEngineDartObject *object) {
+  return kSuccess;
+}
+
+FlutterEngineResult FlutterEngineScheduleFrame(FlutterEngine engine) {
+  return kSuccess;
+}
+
+} // extern "C"
@@ -0,0 +1,1401 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Minimal scriptable Wayland compositor for running flutter-launcher-wayland in CI, deterministically
+// and without any GPU: nothing is ever drawn, the shm buffers are released as soon as they are committed
+// (use LIBGL_ALWAYS_SOFTWARE=1 to make Mesa render into wl_shm buffers).
+//
+// Globals: wl_compositor, wl_shm, xdg_wm_base (toplevels only) or with -l wl_shell instead (toplevels only,
+// for testing the legacy shell path of the client), wl_seat (keyboard, pointer, touch), wl_output,
+// wp_presentation and wp_viewporter.
+//
+// Vblanks happen on an ideal grid of the CLOCK_MONOTONIC clock (origin + seq * refresh period), and the
+// presentation feedback reports exactly these timestamps. A commit is presented at the first vblank
+// following it, unless it gets superseded by another commit before that (or a discard is scripted).
+//
+// Usage: flutter-wayland-test-compositor [-s <socket>] [-m <width>x<height>@<refresh mHz>] [-S <script>] [-l] [-- <client> [<args>...]]
+//
+// The client, if given, is started with WAYLAND_DISPLAY pointing to the compositor, which exits together
+// with it. The script is started once the first toplevel gets its first buffer, one command per line:
+//
+//   wait <ms>                        pause the script
+//   frames <n>                       wait until <n> more frames are presented
+//   configure <width> <height>       configure the toplevel (0 0: let the client choose, ignored with wl_shell)
+//   mode <w> <h> <mHz> [<scale>]     change the output mode (and the vblank period), and the scale
+//   discard <n>                      discard the next <n> frames instead of presenting them
+//   repeat <rate> <delay>            keyboard repeat info
+//   key <code> press|release         linux/input-event-codes.h key code
+//   tap <code>                       press and release
+//   burst <n> <code>                 <n> taps back to back (input throughput)
+//   pointer <x> <y>                  pointer motion, surface local coordinates
+//   button left|right|middle|<code> press|release
+//   touch down <id> <x> <y> | touch motion <id> <x> <y> | touch up <id>
+//   expect-size <width> <height>     fail unless the last committed buffer has this size
+//   expect-destination <w> <h>       fail unless the committed viewport destination has this size
+//   close                            ask the toplevel to close (xdg_wm_base only)
+//   quit                             exit (terminating the client)
+//
+// On exit the frame statistics are printed, among them the composition cost of the presented frames: the
+// output pixels that would have to be blended, and the ones covered by the opaque region of the surface,
+// which can be copied as they are. The exit status is 1 if an expectation failed, otherwise the
+// exit status of the client (0 without a client).
+
+#include <wayland-server.h>
+
+#include <wayland-presentation-time-server-protocol.h>
+#include <wayland-viewporter-server-protocol.h>
+#include <wayland-xdg-shell-server-protocol.h>
+
+#include <xkbcommon/xkbcommon.h>
+
+#include <getopt.h>
+#include <linux/input-event-codes.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define TCTAG "test-compositor: "
+
+static uint64_t NowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+static uint32_t NowMs() {
+  return static_cast<uint32_t>(NowNs() / 1'000'000);
+}
+
+static void DestroyResource(wl_client *client, wl_resource *resource) {
+  wl_resource_destroy(resource);
+}
+
+// Destroy handler of the resources kept on a wl_list.
+static void UnlinkResource(wl_resource *resource) {
+  wl_list_remove(wl_resource_get_link(resource));
+}
+
+// The wl_region.add and wl_region.subtract requests, in order.
+struct RegionOp {
+  bool add;
+  int32_t x, y, width, height;
+};
+
+using Region = std::vector<RegionOp>;
+
+// Of the region within (0, 0, width, height).
+static uint64_t RegionArea(const Region &region, int32_t width, int32_t height) {
+  std::vector<int64_t> xs = {0, width};
+  std::vector<int64_t> ys = {0, height};
+
+  for (const auto &op : region) {
+    xs.push_back(std::clamp<int64_t>(op.x, 0, width));
+    xs.push_back(std::clamp<int64_t>(int64_t{op.x} + op.width, 0, width));
+    ys.push_back(std::clamp<int64_t>(op.y, 0, height));
+    ys.push_back(std::clamp<int64_t>(int64_t{op.y} + op.height, 0, height));
+  }
+
+  std::sort(xs.begin(), xs.end());
+  xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+  std::sort(ys.begin(), ys.end());
+  ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+  // Every cell between the rectangle edges is either inside of a rectangle or outside of it.
+  uint64_t area = 0;
+
+  for (size_t i = 0; i + 1 < xs.size(); i++) {
+    for (size_t j = 0; j + 1 < ys.size(); j++) {
+      bool inside = false;
+
+      for (const auto &op : region) {
+        if (op.x <= xs[i] && xs[i + 1] <= int64_t{op.x} + op.width && op.y <= ys[j] && ys[j + 1] <= int64_t{op.y} + op.height) {
+          inside = op.add;
+        }
+      }
+
+      if (inside) {
+        area += (xs[i + 1] - xs[i]) * (ys[j + 1] - ys[j]);
+      }
+    }
+  }
+
+  return area;
+}
+
+struct Surface {
+  explicit Surface(wl_resource *resource)
+      : resource(resource) {
+    wl_list_init(&pending_frames);
+    wl_list_init(&pending_feedbacks);
+    wl_list_init(&frames);
+    wl_list_init(&feedbacks);
+    wl_list_init(&buffer_destroy.link);
+    buffer_destroy.notify = [](wl_listener *listener, void *data) {
+      Surface *const surface = wl_container_of(listener, surface, buffer_destroy);
+      surface->pending_buffer = nullptr;
+      wl_list_remove(&listener->link);
+      wl_list_init(&listener->link);
+    };
+  }
+
+  wl_resource *const resource;
+
+  bool buffer_attached        = false;
+  wl_resource *pending_buffer = nullptr;
+  wl_listener buffer_destroy;
+
+  wl_list pending_frames;    // of the next commit
+  wl_list pending_feedbacks; // of the next commit
+  wl_list frames;            // committed, waiting for the next vblank
+  wl_list feedbacks;         // committed, waiting for the next vblank
+
+  bool committed     = false; // since the last vblank
+  uint64_t commit_ns = 0;
+  bool mapped        = false; // has got a buffer
+  int32_t width      = 0;     // of the last committed shm buffer
+  int32_t height     = 0;
+
+  int32_t pending_buffer_scale = 1; // of the next commit
+  int32_t buffer_scale         = 1;
+
+  Region pending_opaque; // of the next commit, surface local coordinates
+  Region opaque;
+
+  wl_resource *viewport          = nullptr;
+  int32_t pending_destination[2] = {-1, -1}; // of the next commit, -1 -1 if unset
+  int32_t destination[2]         = {-1, -1};
+
+  wl_resource *xdg_surface  = nullptr;
+  wl_resource *xdg_toplevel = nullptr;
+  bool configured           = false;
+
+  wl_resource *shell_surface = nullptr;
+  bool shell_toplevel        = false; // wl_shell_surface.set_toplevel
+
+  bool IsToplevel() const {
+    return xdg_toplevel != nullptr || shell_toplevel;
+  }
+
+  // In surface local coordinates.
+  int32_t Width() const {
+    return destination[0] > 0 ? destination[0] : width / buffer_scale;
+  }
+
+  int32_t Height() const {
+    return destination[1] > 0 ? destination[1] : height / buffer_scale;
+  }
+};
+
+static struct Compositor {
+  wl_display *display = nullptr;
+  wl_event_loop *loop = nullptr;
+
+  struct {
+    int32_t width       = 1920;
+    int32_t height      = 1080;
+    int32_t refresh_mhz = 60000;
+    int32_t scale       = 1;
+
+    uint64_t period_ns() const {
+      return 1'000'000'000'000 / refresh_mhz;
+    }
+  } mode;
+
+  int32_t configure_width  = 0;
+  int32_t configure_height = 0;
+
+  bool wl_shell = false; // -l: wl_shell instead of xdg_wm_base
+
+  wl_list outputs;
+  wl_list keyboards;
+  wl_list pointers;
+  wl_list touches;
+
+  Surface *focus = nullptr; // the first mapped toplevel gets all the input
+
+  struct {
+    xkb_context *context = nullptr;
+    xkb_keymap *keymap   = nullptr;
+    xkb_state *state     = nullptr;
+    int fd               = -1;
+    uint32_t size        = 0;
+    int32_t repeat_rate  = 25;
+    int32_t repeat_delay = 400;
+  } xkb;
+
+  struct {
+    int fd           = -1;
+    uint64_t next_ns = 0;
+    uint64_t seq     = 0;
+  } vblank;
+
+  struct {
+    std::vector<std::vector<std::string>> commands;
+    size_t pc              = 0;
+    bool started           = false;
+    bool waiting           = false;
+    uint64_t wait_frames   = 0; // presented frames to wait for
+    wl_event_source *timer = nullptr;
+    uint32_t discard       = 0;
+  } script;
+
+  struct {
+    uint64_t vblanks      = 0;
+    uint64_t idle_vblanks = 0; // without a new commit, after the first one
+    uint64_t commits      = 0;
+    uint64_t presented    = 0;
+    uint64_t discarded    = 0;
+    uint64_t superseded   = 0;
+    uint64_t latency_ns   = 0; // commit -> present
+    uint64_t latency_max  = 0;
+    uint64_t input_events = 0;
+    uint64_t failures     = 0;
+
+    uint64_t blended_px = 0; // of the presented frames, in output pixels
+    uint64_t opaque_px  = 0;
+  } stats;
+
+  pid_t client_pid  = -1;
+  int client_status = 0;
+} compositor;
+
+static void SendFeedbacks(wl_list *feedbacks, bool presented, uint64_t time_ns = 0, uint64_t seq = 0) {
+  wl_resource *feedback, *tmp;
+
+  wl_resource_for_each_safe(feedback, tmp, feedbacks) {
+    if (presented) {
+      const uint64_t sec = time_ns / 1'000'000'000;
+      wp_presentation_feedback_send_presented(feedback, sec >> 32, sec & 0xffffffff, time_ns % 1'000'000'000, compositor.mode.period_ns(), seq >> 32, seq & 0xffffffff,
+                                              WP_PRESENTATION_FEEDBACK_KIND_VSYNC | WP_PRESENTATION_FEEDBACK_KIND_HW_CLOCK | WP_PRESENTATION_FEEDBACK_KIND_HW_COMPLETION);
+    } else {
+      wp_presentation_feedback_send_discarded(feedback);
+    }
+    wl_resource_destroy(feedback);
+  }
+}
+
+static void SendFrameCallbacks(wl_list *frames, uint32_t time_ms) {
+  wl_resource *callback, *tmp;
+
+  wl_resource_for_each_safe(callback, tmp, frames) {
+    wl_callback_send_done(callback, time_ms);
+    wl_resource_destroy(callback);
+  }
+}
+
+// Input {
+
+static bool HasFocus(wl_resource *resource) {
+  return compositor.focus != nullptr && wl_resource_get_client(resource) == wl_resource_get_client(compositor.focus->resource);
+}
+
+static void SendKeyboardEnter(wl_resource *keyboard) {
+  wl_array keys;
+  wl_array_init(&keys);
+  wl_keyboard_send_enter(keyboard, wl_display_next_serial(compositor.display), compositor.focus->resource, &keys);
+  wl_array_release(&keys);
+}
+
+static void SendPointerEnter(wl_resource *pointer) {
+  wl_pointer_send_enter(pointer, wl_display_next_serial(compositor.display), compositor.focus->resource, 0, 0);
+
+  if (wl_resource_get_version(pointer) >= WL_POINTER_FRAME_SINCE_VERSION) {
+    wl_pointer_send_frame(pointer);
+  }
+}
+
+static void SendKey(uint32_t key, uint32_t state) {
+  const uint32_t serial = wl_display_next_serial(compositor.display);
+  const uint32_t time   = NowMs();
+
+  const auto changed = xkb_state_update_key(compositor.xkb.state, key + 8, state == WL_KEYBOARD_KEY_STATE_PRESSED ? XKB_KEY_DOWN : XKB_KEY_UP);
+
+  wl_resource *keyboard;
+
+  wl_resource_for_each(keyboard, &compositor.keyboards) {
+    if (!HasFocus(keyboard)) {
+      continue;
+    }
+
+    wl_keyboard_send_key(keyboard, serial, time, key, state);
+
+    if (changed & XKB_STATE_MODS_EFFECTIVE) {
+      wl_keyboard_send_modifiers(keyboard, serial, xkb_state_serialize_mods(compositor.xkb.state, XKB_STATE_MODS_DEPRESSED), xkb_state_serialize_mods(compositor.xkb.state, XKB_STATE_MODS_LATCHED),
+                                 xkb_state_serialize_mods(compositor.xkb.state, XKB_STATE_MODS_LOCKED), xkb_state_serialize_layout(compositor.xkb.state, XKB_STATE_LAYOUT_EFFECTIVE));
+    }
+  }
+
+  compositor.stats.input_events++;
+}
+
+static void SendPointerMotion(double x, double y) {
+  wl_resource *pointer;
+
+  wl_resource_for_each(pointer, &compositor.pointers) {
+    if (HasFocus(pointer)) {
+      wl_pointer_send_motion(pointer, NowMs(), wl_fixed_from_double(x), wl_fixed_from_double(y));
+
+      if (wl_resource_get_version(pointer) >= WL_POINTER_FRAME_SINCE_VERSION) {
+        wl_pointer_send_frame(pointer);
+      }
+    }
+  }
+
+  compositor.stats.input_events++;
+}
+
+static void SendPointerButton(uint32_t button, uint32_t state) {
+  const uint32_t serial = wl_display_next_serial(compositor.display);
+  wl_resource *pointer;
+
+  wl_resource_for_each(pointer, &compositor.pointers) {
+    if (HasFocus(pointer)) {
+      wl_pointer_send_button(pointer, serial, NowMs(), button, state);
+
+      if (wl_resource_get_version(pointer) >= WL_POINTER_FRAME_SINCE_VERSION) {
+        wl_pointer_send_frame(pointer);
+      }
+    }
+  }
+
+  compositor.stats.input_events++;
+}
+
+static void SendTouch(const std::string &action, int32_t id, double x, double y) {
+  const uint32_t serial = wl_display_next_serial(compositor.display);
+  wl_resource *touch;
+
+  wl_resource_for_each(touch, &compositor.touches) {
+    if (!HasFocus(touch)) {
+      continue;
+    }
+
+    if (action == "down") {
+      wl_touch_send_down(touch, serial, NowMs(), compositor.focus->resource, id, wl_fixed_from_double(x), wl_fixed_from_double(y));
+    } else if (action == "motion") {
+      wl_touch_send_motion(touch, NowMs(), id, wl_fixed_from_double(x), wl_fixed_from_double(y));
+    } else {
+      wl_touch_send_up(touch, serial, NowMs(), id);
+    }
+
+    wl_touch_send_frame(touch);
+  }
+
+  compositor.stats.input_events++;
+}
+
+// }
+
+// Script {
+
+static void RunScript();
+
+static void SendConfigure(Surface *surface) {
+  // A wl_shell client has no size to choose.
+  if (surface->shell_surface != nullptr) {
+    if (compositor.configure_width > 0 && compositor.configure_height > 0) {
+      wl_shell_surface_send_configure(surface->shell_surface, WL_SHELL_SURFACE_RESIZE_NONE, compositor.configure_width, compositor.configure_height);
+    }
+    return;
+  }
+
+  wl_array states;
+  wl_array_init(&states);
+  *static_cast<uint32_t *>(wl_array_add(&states, sizeof(uint32_t))) = XDG_TOPLEVEL_STATE_ACTIVATED;
+
+  xdg_toplevel_send_configure(surface->xdg_toplevel, compositor.configure_width, compositor.configure_height, &states);
+  xdg_surface_send_configure(surface->xdg_surface, wl_display_next_serial(compositor.display));
+
+  wl_array_release(&states);
+}
+
+static void SendOutputMode(wl_resource *output) {
+  const auto &mode = compositor.mode;
+
+  // 96 dpi
+  wl_output_send_geometry(output, 0, 0, mode.width * 254 / 960, mode.height * 254 / 960, WL_OUTPUT_SUBPIXEL_UNKNOWN, "flutter-wayland", "test-compositor", WL_OUTPUT_TRANSFORM_NORMAL);
+  wl_output_send_mode(output, WL_OUTPUT_MODE_CURRENT | WL_OUTPUT_MODE_PREFERRED, mode.width, mode.height, mode.refresh_mhz);
+
+  if (wl_resource_get_version(output) >= WL_OUTPUT_SCALE_SINCE_VERSION) {
+    wl_output_send_scale(output, mode.scale);
+  }
+
+  if (wl_resource_get_version(output) >= WL_OUTPUT_DONE_SINCE_VERSION) {
+    wl_output_send_done(output);
+  }
+}
+
+static uint32_t ParseButton(const std::string &name) {
+  if (name == "left") {
+    return BTN_LEFT;
+  } else if (name == "right") {
+    return BTN_RIGHT;
+  } else if (name == "middle") {
+    return BTN_MIDDLE;
+  }
+
+  return std::stoul(name);
+}
+
+static void Fail(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+static void Fail(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, TCTAG "FAILED: ");
+  vfprintf(stderr, format, args);
+  va_end(args);
+
+  compositor.stats.failures++;
+}
+
+// Returns false if the script has to wait.
+static bool RunCommand(const std::vector<std::string> &command) {
+  const std::string &name = command[0];
+
+  auto arg = [&command](size_t i) -> long {
+    return i < command.size() ? std::stol(command[i]) : 0;
+  };
+
+  if (name == "wait") {
+    wl_event_source_timer_update(compositor.script.timer, std::max(arg(1), 1L));
+    return false;
+  } else if (name == "frames") {
+    compositor.script.wait_frames = arg(1);
+    return compositor.script.wait_frames == 0;
+  } else if (name == "configure") {
+    compositor.configure_width  = arg(1);
+    compositor.configure_height = arg(2);
+
+    if (compositor.focus != nullptr) {
+      SendConfigure(compositor.focus);
+    }
+  } else if (name == "mode") {
+    compositor.mode.width       = arg(1);
+    compositor.mode.height      = arg(2);
+    compositor.mode.refresh_mhz = std::max(arg(3), 1000L);
+    compositor.mode.scale       = std::max(arg(4), 1L);
+
+    wl_resource *output;
+    wl_resource_for_each(output, &compositor.outputs) {
+      SendOutputMode(output);
+    }
+  } else if (name == "discard") {
+    compositor.script.discard = arg(1);
+  } else if (name == "repeat") {
+    compositor.xkb.repeat_rate  = arg(1);
+    compositor.xkb.repeat_delay = arg(2);
+
+    wl_resource *keyboard;
+    wl_resource_for_each(keyboard, &compositor.keyboards) {
+      if (wl_resource_get_version(keyboard) >= WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION) {
+        wl_keyboard_send_repeat_info(keyboard, compositor.xkb.repeat_rate, compositor.xkb.repeat_delay);
+      }
+    }
+  } else if (name == "key") {
+    SendKey(arg(1), command.size() > 2 && command[2] == "release" ? WL_KEYBOARD_KEY_STATE_RELEASED : WL_KEYBOARD_KEY_STATE_PRESSED);
+  } else if (name == "tap") {
+    SendKey(arg(1), WL_KEYBOARD_KEY_STATE_PRESSED);
+    SendKey(arg(1), WL_KEYBOARD_KEY_STATE_RELEASED);
+  } else if (name == "burst") {
+    for (long i = 0; i < arg(1); i++) {
+      SendKey(arg(2), WL_KEYBOARD_KEY_STATE_PRESSED);
+      SendKey(arg(2), WL_KEYBOARD_KEY_STATE_RELEASED);
+
+      // Into the socket, the connection buffer of a client is small.
+      wl_display_flush_clients(compositor.display);
+    }
+  } else if (name == "pointer") {
+    SendPointerMotion(arg(1), arg(2));
+  } else if (name == "button" && command.size() > 1) {
+    SendPointerButton(ParseButton(command[1]), command.size() > 2 && command[2] == "release" ? WL_POINTER_BUTTON_STATE_RELEASED : WL_POINTER_BUTTON_STATE_PRESSED);
+  } else if (name == "touch" && command.size() > 2) {
+    SendTouch(command[1], arg(2), arg(3), arg(4));
+  } else if (name == "expect-size") {
+    const Surface *const surface = compositor.focus;
+
+    if (surface == nullptr || surface->width != arg(1) || surface->height != arg(2)) {
+      Fail("expected a %ldx%ld buffer, got %dx%d\n", arg(1), arg(2), surface ? surface->width : 0, surface ? surface->height : 0);
+    }
+  } else if (name == "expect-destination") {
+    const Surface *const surface = compositor.focus;
+
+    if (surface == nullptr || surface->destination[0] != arg(1) || surface->destination[1] != arg(2)) {
+      Fail("expected a %ldx%ld viewport destination, got %dx%d\n", arg(1), arg(2), surface ? surface->destination[0] : 0, surface ? surface->destination[1] : 0);
+    }
+  } else if (name == "close") {
+    if (compositor.focus != nullptr && compositor.focus->xdg_toplevel != nullptr) {
+      xdg_toplevel_send_close(compositor.focus->xdg_toplevel);
+    }
+  } else if (name == "quit") {
+    wl_display_terminate(compositor.display);
+    return false;
+  } else {
+    Fail("unknown script command: %s\n", name.c_str());
+  }
+
+  return true;
+}
+
+static void RunScript() {
+  auto &script = compositor.script;
+
+  script.waiting = false;
+
+  while (script.pc < script.commands.size()) {
+    const auto &command = script.commands[script.pc++];
+
+    try {
+      if (!RunCommand(command)) {
+        script.waiting = true;
+        break;
+      }
+    } catch (const std::exception &e) {
+      Fail("invalid arguments of: %s\n", command[0].c_str());
+    }
+  }
+
+  wl_display_flush_clients(compositor.display);
+}
+
+static bool LoadScript(const char *path) {
+  std::ifstream file(path);
+
+  if (!file) {
+    fprintf(stderr, TCTAG "could not read the script: %s\n", path);
+    return false;
+  }
+
+  std::string line;
+
+  while (std::getline(file, line)) {
+    std::istringstream ss(line.substr(0, line.find('#')));
+    std::vector<std::string> command;
+    std::string word;
+
+    while (ss >> word) {
+      command.push_back(word);
+    }
+
+    if (!command.empty()) {
+      compositor.script.commands.push_back(command);
+    }
+  }
+
+  return true;
+}
+
+// }
+
+// Vblank {
+
+static void ArmVblank() {
+  const struct itimerspec its = {
+      .it_interval = {},
+      .it_value    = {.tv_sec = static_cast<time_t>(compositor.vblank.next_ns / 1'000'000'000), .tv_nsec = static_cast<long>(compositor.vblank.next_ns % 1'000'000'000)},
+  };
+
+  timerfd_settime(compositor.vblank.fd, TFD_TIMER_ABSTIME, &its, nullptr);
+}
+
+static int OnVblank(int fd, uint32_t mask, void *data) {
+  uint64_t expirations;
+
+  if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+    return 0;
+  }
+
+  const uint64_t now_ns    = NowNs();
+  const uint64_t period_ns = compositor.mode.period_ns();
+  const uint64_t vblank_ns = compositor.vblank.next_ns;
+  const uint64_t seq       = compositor.vblank.seq;
+
+  // Vblanks missed by the compositor itself are skipped, the grid stays the same.
+  do {
+    compositor.vblank.next_ns += period_ns;
+    compositor.vblank.seq++;
+  } while (compositor.vblank.next_ns <= now_ns);
+
+  compositor.stats.vblanks++;
+
+  Surface *const surface = compositor.focus;
+
+  if (surface != nullptr) {
+    if (surface->committed) {
+      surface->committed = false;
+
+      const bool discard = compositor.script.discard > 0;
+
+      if (discard) {
+        compositor.script.discard--;
+        compositor.stats.discarded++;
+      } else {
+        const uint64_t latency_ns = vblank_ns - std::min(vblank_ns, surface->commit_ns);
+
+        compositor.stats.presented++;
+        compositor.stats.latency_ns += latency_ns;
+        compositor.stats.latency_max = std::max(compositor.stats.latency_max, latency_ns);
+
+        const uint64_t output_px_per_surface_px = static_cast<uint64_t>(compositor.mode.scale) * compositor.mode.scale;
+        const uint64_t area                     = static_cast<uint64_t>(std::max(surface->Width(), 0)) * std::max(surface->Height(), 0);
+        const uint64_t opaque_area              = std::min(area, RegionArea(surface->opaque, surface->Width(), surface->Height()));
+
+        compositor.stats.opaque_px += opaque_area * output_px_per_surface_px;
+        compositor.stats.blended_px += (area - opaque_area) * output_px_per_surface_px;
+      }
+
+      SendFeedbacks(&surface->feedbacks, !discard, vblank_ns, seq);
+
+      if (!discard && compositor.script.wait_frames > 0 && --compositor.script.wait_frames == 0 && compositor.script.waiting) {
+        RunScript();
+      }
+    } else if (compositor.stats.commits > 0) {
+      compositor.stats.idle_vblanks++;
+    }
+
+    SendFrameCallbacks(&surface->frames, vblank_ns / 1'000'000);
+  }
+
+  ArmVblank();
+
+  wl_display_flush_clients(compositor.display);
+
+  return 0;
+}
+
+// }
+
+// wl_compositor, wl_surface, wl_region {
+
+static void MapSurface(Surface *surface) {
+  surface->mapped = true;
+
+  if (compositor.focus != nullptr) {
+    return;
+  }
+
+  compositor.focus = surface;
+
+  wl_resource *resource;
+
+  wl_resource_for_each(resource, &compositor.keyboards) {
+    if (HasFocus(resource)) {
+      SendKeyboardEnter(resource);
+    }
+  }
+
+  wl_resource_for_each(resource, &compositor.pointers) {
+    if (HasFocus(resource)) {
+      SendPointerEnter(resource);
+    }
+  }
+
+  if (!compositor.script.started) {
+    compositor.script.started = true;
+    RunScript();
+  }
+}
+
+static const struct wl_surface_interface kSurfaceImplementation = {
+    .destroy = DestroyResource,
+    .attach =
+        [](wl_client *client, wl_resource *resource, wl_resource *buffer, int32_t x, int32_t y) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource));
+
+          wl_list_remove(&surface->buffer_destroy.link);
+          wl_list_init(&surface->buffer_destroy.link);
+
+          surface->buffer_attached = true;
+          surface->pending_buffer  = buffer;
+
+          if (buffer != nullptr) {
+            wl_resource_add_destroy_listener(buffer, &surface->buffer_destroy);
+          }
+        },
+    .damage = [](wl_client *client, wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height) {},
+    .frame =
+        [](wl_client *client, wl_resource *resource, uint32_t id) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource));
+          wl_resource *const callback = wl_resource_create(client, &wl_callback_interface, 1, id);
+
+          if (callback == nullptr) {
+            wl_client_post_no_memory(client);
+            return;
+          }
+
+          wl_resource_set_implementation(callback, nullptr, nullptr, UnlinkResource);
+          wl_list_insert(surface->pending_frames.prev, wl_resource_get_link(callback));
+        },
+    .set_opaque_region =
+        [](wl_client *client, wl_resource *resource, wl_resource *region) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource));
+
+          // The region object can be destroyed right away, its current state is what counts.
+          surface->pending_opaque = region ? *static_cast<Region *>(wl_resource_get_user_data(region)) : Region();
+        },
+    .set_input_region  = [](wl_client *client, wl_resource *resource, wl_resource *region) {},
+    .commit =
+        [](wl_client *client, wl_resource *resource) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource));
+
+          // The initial commit of a toplevel gets configured.
+          if (surface->xdg_toplevel != nullptr && !surface->configured) {
+            surface->configured = true;
+            SendConfigure(surface);
+            return;
+          }
+
+          bool map = false;
+
+          if (surface->buffer_attached) {
+            surface->buffer_attached = false;
+
+            if (surface->pending_buffer != nullptr) {
+              map = !surface->mapped && surface->IsToplevel();
+
+              if (wl_shm_buffer *const shm = wl_shm_buffer_get(surface->pending_buffer)) {
+                surface->width  = wl_shm_buffer_get_width(shm);
+                surface->height = wl_shm_buffer_get_height(shm);
+              }
+
+              // Nothing is ever drawn, the client can reuse the buffer right away.
+              wl_buffer_send_release(surface->pending_buffer);
+
+              wl_list_remove(&surface->buffer_destroy.link);
+              wl_list_init(&surface->buffer_destroy.link);
+              surface->pending_buffer = nullptr;
+            }
+          }
+
+          // A commit which did not make it to the screen before the next one is discarded.
+          if (surface->committed) {
+            compositor.stats.superseded++;
+            SendFeedbacks(&surface->feedbacks, false);
+          }
+
+          surface->destination[0] = surface->pending_destination[0];
+          surface->destination[1] = surface->pending_destination[1];
+          surface->buffer_scale   = surface->pending_buffer_scale;
+          surface->opaque         = surface->pending_opaque;
+
+          wl_list_insert_list(surface->frames.prev, &surface->pending_frames);
+          wl_list_init(&surface->pending_frames);
+          wl_list_insert_list(&surface->feedbacks, &surface->pending_feedbacks);
+          wl_list_init(&surface->pending_feedbacks);
+
+          surface->committed = true;
+          surface->commit_ns = NowNs();
+          compositor.stats.commits++;
+
+          if (map) {
+            MapSurface(surface);
+          }
+        },
+    .set_buffer_transform = [](wl_client *client, wl_resource *resource, int32_t transform) {},
+    .set_buffer_scale =
+        [](wl_client *client, wl_resource *resource, int32_t scale) {
+          if (scale < 1) {
+            wl_resource_post_error(resource, WL_SURFACE_ERROR_INVALID_SCALE, "invalid scale %d", scale);
+            return;
+          }
+
+          static_cast<Surface *>(wl_resource_get_user_data(resource))->pending_buffer_scale = scale;
+        },
+    .damage_buffer        = [](wl_client *client, wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height) {},
+};
+
+static void DestroySurface(wl_resource *resource) {
+  Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource));
+
+  SendFeedbacks(&surface->pending_feedbacks, false);
+  SendFeedbacks(&surface->feedbacks, false);
+
+  wl_resource *callback, *tmp;
+
+  wl_resource_for_each_safe(callback, tmp, &surface->pending_frames) {
+    wl_resource_destroy(callback);
+  }
+
+  wl_resource_for_each_safe(callback, tmp, &surface->frames) {
+    wl_resource_destroy(callback);
+  }
+
+  wl_list_remove(&surface->buffer_destroy.link);
+
+  // The role objects may outlive the surface.
+  if (surface->xdg_surface != nullptr) {
+    wl_resource_set_user_data(surface->xdg_surface, nullptr);
+  }
+
+  if (surface->xdg_toplevel != nullptr) {
+    wl_resource_set_user_data(surface->xdg_toplevel, nullptr);
+  }
+
+  if (surface->shell_surface != nullptr) {
+    wl_resource_set_user_data(surface->shell_surface, nullptr);
+  }
+
+  if (surface->viewport != nullptr) {
+    wl_resource_set_user_data(surface->viewport, nullptr);
+  }
+
+  if (compositor.focus == surface) {
+    compositor.focus = nullptr;
+  }
+
+  delete surface;
+}
+
+static const struct wl_region_interface kRegionImplementation = {
+    .destroy  = DestroyResource,
+    .add =
+        [](wl_client *client, wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height) {
+          static_cast<Region *>(wl_resource_get_user_data(resource))->push_back({true, x, y, width, height});
+        },
+    .subtract =
+        [](wl_client *client, wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height) {
+          static_cast<Region *>(wl_resource_get_user_data(resource))->push_back({false, x, y, width, height});
+        },
+};
+
+static const struct wl_compositor_interface kCompositorImplementation = {
+    .create_surface =
+        [](wl_client *client, wl_resource *resource, uint32_t id) {
+          wl_resource *const surface = wl_resource_create(client, &wl_surface_interface, wl_resource_get_version(resource), id);
+
+          if (surface == nullptr) {
+            wl_client_post_no_memory(client);
+            return;
+          }
+
+          wl_resource_set_implementation(surface, &kSurfaceImplementation, new Surface(surface), DestroySurface);
+        },
+    .create_region =
+        [](wl_client *client, wl_resource *resource, uint32_t id) {
+          wl_resource *const region = wl_resource_create(client, &wl_region_interface, 1, id);
+
+          if (region == nullptr) {
+            wl_client_post_no_memory(client);
+            return;
+          }
+
+          wl_resource_set_implementation(region, &kRegionImplementation, new Region(), [](wl_resource *resource) { delete static_cast<Region *>(wl_resource_get_user_data(resource)); });
+        },
+};
+
+// }
+
+// xdg_wm_base, xdg_surface, xdg_toplevel {
+
+static const struct xdg_toplevel_interface kXdgToplevelImplementation = {
+    .destroy          = DestroyResource,
+    .set_parent       = [](wl_client *client, wl_resource *resource, wl_resource *parent) {},
+    .set_title        = [](wl_client *client, wl_resource *resource, const char *title) {},
+    .set_app_id       = [](wl_client *client, wl_resource *resource, const char *app_id) {},
+    .show_window_menu = [](wl_client *client, wl_resource *resource, wl_resource *seat, uint32_t serial, int32_t x, int32_t y) {},
+    .move             = [](wl_client *client, wl_resource *resource, wl_resource *seat, uint32_t serial) {},
+    .resize           = [](wl_client *client, wl_resource *resource, wl_resource *seat, uint32_t serial, uint32_t edges) {},
+    .set_max_size     = [](wl_client *client, wl_resource *resource, int32_t width, int32_t height) {},
+    .set_min_size     = [](wl_client *client, wl_resource *resource, int32_t width, int32_t height) {},
+    .set_maximized    = [](wl_client *client, wl_resource *resource) {},
+    .unset_maximized  = [](wl_client *client, wl_resource *resource) {},
+    .set_fullscreen   = [](wl_client *client, wl_resource *resource, wl_resource *output) {},
+    .unset_fullscreen = [](wl_client *client, wl_resource *resource) {},
+    .set_minimized    = [](wl_client *client, wl_resource *resource) {},
+};
+
+static const struct xdg_surface_interface kXdgSurfaceImplementation = {
+    .destroy = DestroyResource,
+    .get_toplevel =
+        [](wl_client *client, wl_resource *resource, uint32_t id) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource));
+
+          if (surface == nullptr) {
+            wl_resource_post_error(resource, XDG_WM_BASE_ERROR_DEFUNCT_SURFACES, "the surface is gone");
+            return;
+          }
+
+          wl_resource *const toplevel = wl_resource_create(client, &xdg_toplevel_interface, wl_resource_get_version(resource), id);
+
+          if (toplevel == nullptr) {
+            wl_client_post_no_memory(client);
+            return;
+          }
+
+          wl_resource_set_implementation(toplevel, &kXdgToplevelImplementation, surface, [](wl_resource *toplevel) {
+            Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(toplevel));
+            // The surface might be gone already.
+            if (surface != nullptr) {
+              surface->xdg_toplevel = nullptr;
+            }
+          });
+
+          surface->xdg_toplevel = toplevel;
+        },
+    .get_popup =
+        [](wl_client *client, wl_resource *resource, uint32_t id, wl_resource *parent, wl_resource *positioner) {
+          wl_resource_post_error(resource, WL_DISPLAY_ERROR_IMPLEMENTATION, "popups are not supported");
+        },
+    .set_window_geometry = [](wl_client *client, wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height) {},
+    .ack_configure       = [](wl_client *client, wl_resource *resource, uint32_t serial) {},
+};
+
+static const struct xdg_wm_base_interface kXdgWmBaseImplementation = {
+    .destroy = DestroyResource,
+    .create_positioner =
+        [](wl_client *client, wl_resource *resource, uint32_t id) {
+          wl_resource_post_error(resource, WL_DISPLAY_ERROR_IMPLEMENTATION, "popups are not supported");
+        },
+    .get_xdg_surface =
+        [](wl_client *client, wl_resource *resource, uint32_t id, wl_resource *surface_resource) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(surface_resource));
+          wl_resource *const xdg_surface = wl_resource_create(client, &xdg_surface_interface, wl_resource_get_version(resource), id);
+
+          if (xdg_surface == nullptr) {
+            wl_client_post_no_memory(client);
+            return;
+          }
+
+          wl_resource_set_implementation(xdg_surface, &kXdgSurfaceImplementation, surface, [](wl_resource *xdg_surface) {
+            Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(xdg_surface));
+            if (surface != nullptr) {
+              surface->xdg_surface = nullptr;
+            }
+          });
+
+          surface->xdg_surface = xdg_surface;
+        },
+    .pong = [](wl_client *client, wl_resource *resource, uint32_t serial) {},
+};
+
+// }
+
+// wl_shell, wl_shell_surface {
+
+static const struct wl_shell_surface_interface kShellSurfaceImplementation = {
+    .pong   = [](wl_client *client, wl_resource *resource, uint32_t serial) {},
+    .move   = [](wl_client *client, wl_resource *resource, wl_resource *seat, uint32_t serial) {},
+    .resize = [](wl_client *client, wl_resource *resource, wl_resource *seat, uint32_t serial, uint32_t edges) {},
+    .set_toplevel =
+        [](wl_client *client, wl_resource *resource) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource));
+
+          if (surface != nullptr) {
+            surface->shell_toplevel = true;
+          }
+        },
+    .set_transient  = [](wl_client *client, wl_resource *resource, wl_resource *parent, int32_t x, int32_t y, uint32_t flags) {},
+    .set_fullscreen = [](wl_client *client, wl_resource *resource, uint32_t method, uint32_t framerate, wl_resource *output) {},
+    .set_popup =
+        [](wl_client *client, wl_resource *resource, wl_resource *seat, uint32_t serial, wl_resource *parent, int32_t x, int32_t y, uint32_t flags) {
+          wl_resource_post_error(resource, WL_DISPLAY_ERROR_IMPLEMENTATION, "popups are not supported");
+        },
+    .set_maximized = [](wl_client *client, wl_resource *resource, wl_resource *output) {},
+    .set_title     = [](wl_client *client, wl_resource *resource, const char *title) {},
+    .set_class     = [](wl_client *client, wl_resource *resource, const char *class_) {},
+};
+
+static const struct wl_shell_interface kShellImplementation = {
+    .get_shell_surface =
+        [](wl_client *client, wl_resource *resource, uint32_t id, wl_resource *surface_resource) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(surface_resource));
+
+          if (surface->shell_surface != nullptr || surface->xdg_surface != nullptr) {
+            wl_resource_post_error(resource, WL_SHELL_ERROR_ROLE, "the surface already has a role");
+            return;
+          }
+
+          wl_resource *const shell_surface = wl_resource_create(client, &wl_shell_surface_interface, wl_resource_get_version(resource), id);
+
+          if (shell_surface == nullptr) {
+            wl_client_post_no_memory(client);
+            return;
+          }
+
+          wl_resource_set_implementation(shell_surface, &kShellSurfaceImplementation, surface, [](wl_resource *shell_surface) {
+            Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(shell_surface));
+            if (surface != nullptr) {
+              surface->shell_surface  = nullptr;
+              surface->shell_toplevel = false;
+            }
+          });
+
+          surface->shell_surface = shell_surface;
+        },
+};
+
+// }
+
+// wl_seat, wl_keyboard, wl_pointer, wl_touch {
+
+static const struct wl_keyboard_interface kKeyboardImplementation = {
+    .release = DestroyResource,
+};
+
+static const struct wl_pointer_interface kPointerImplementation = {
+    .set_cursor = [](wl_client *client, wl_resource *resource, uint32_t serial, wl_resource *surface, int32_t hotspot_x, int32_t hotspot_y) {},
+    .release    = DestroyResource,
+};
+
+static const struct wl_touch_interface kTouchImplementation = {
+    .release = DestroyResource,
+};
+
+template <typename Implementation> static wl_resource *CreateInputDevice(wl_client *client, wl_resource *seat, const wl_interface *interface, const Implementation *implementation, uint32_t id, wl_list *list) {
+  wl_resource *const device = wl_resource_create(client, interface, wl_resource_get_version(seat), id);
+
+  if (device == nullptr) {
+    wl_client_post_no_memory(client);
+    return nullptr;
+  }
+
+  wl_resource_set_implementation(device, implementation, nullptr, UnlinkResource);
+  wl_list_insert(list->prev, wl_resource_get_link(device));
+
+  return device;
+}
+
+static const struct wl_seat_interface kSeatImplementation = {
+    .get_pointer =
+        [](wl_client *client, wl_resource *resource, uint32_t id) {
+          wl_resource *const pointer = CreateInputDevice(client, resource, &wl_pointer_interface, &kPointerImplementation, id, &compositor.pointers);
+
+          if (pointer != nullptr && HasFocus(pointer)) {
+            SendPointerEnter(pointer);
+          }
+        },
+    .get_keyboard =
+        [](wl_client *client, wl_resource *resource, uint32_t id) {
+          wl_resource *const keyboard = CreateInputDevice(client, resource, &wl_keyboard_interface, &kKeyboardImplementation, id, &compositor.keyboards);
+
+          if (keyboard == nullptr) {
+            return;
+          }
+
+          wl_keyboard_send_keymap(keyboard, WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, compositor.xkb.fd, compositor.xkb.size);
+
+          if (wl_resource_get_version(keyboard) >= WL_KEYBOARD_REPEAT_INFO_SINCE_VERSION) {
+            wl_keyboard_send_repeat_info(keyboard, compositor.xkb.repeat_rate, compositor.xkb.repeat_delay);
+          }
+
+          if (HasFocus(keyboard)) {
+            SendKeyboardEnter(keyboard);
+          }
+        },
+    .get_touch =
+        [](wl_client *client, wl_resource *resource, uint32_t id) {
+          CreateInputDevice(client, resource, &wl_touch_interface, &kTouchImplementation, id, &compositor.touches);
+        },
+    .release = DestroyResource,
+};
+
+// }
+
+// wp_presentation, wp_viewporter {
+
+static const struct wp_presentation_interface kPresentationImplementation = {
+    .destroy = DestroyResource,
+    .feedback =
+        [](wl_client *client, wl_resource *resource, wl_resource *surface_resource, uint32_t id) {
+          Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(surface_resource));
+          wl_resource *const feedback = wl_resource_create(client, &wp_presentation_feedback_interface, 1, id);
+
+          if (feedback == nullptr) {
+            wl_client_post_no_memory(client);
+            return;
+          }
+
+          wl_resource_set_implementation(feedback, nullptr, nullptr, UnlinkResource);
+          wl_list_insert(surface->pending_feedbacks.prev, wl_resource_get_link(feedback));
+        },
+};
+
+static const struct wp_viewport_interface kViewportImplementation = {
+    .destroy         = DestroyResource,
+    .set_source      = [](wl_client *client, wl_resource *resource, wl_fixed_t x, wl_fixed_t y, wl_fixed_t width, wl_fixed_t height) {},
+    .set_destination =
+        [](wl_client *client, wl_resource *resource, int32_t width, int32_t height) {
+          if (Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource))) {
+            surface->pending_destination[0] = width;
+            surface->pending_destination[1] = height;
+          }
+        },
+};
+
+static const struct wp_viewporter_interface kViewporterImplementation = {
+    .destroy = DestroyResource,
+    .get_viewport =
+        [](wl_client *client, wl_resource *resource, uint32_t id, wl_resource *surface_resource) {
+          Surface *const surface      = static_cast<Surface *>(wl_resource_get_user_data(surface_resource));
+          wl_resource *const viewport = wl_resource_create(client, &wp_viewport_interface, 1, id);
+
+          if (viewport == nullptr) {
+            wl_client_post_no_memory(client);
+            return;
+          }
+
+          // The surface keeps its destination once the viewport is gone, which is good enough here.
+          wl_resource_set_implementation(viewport, &kViewportImplementation, surface, [](wl_resource *resource) {
+            if (Surface *const surface = static_cast<Surface *>(wl_resource_get_user_data(resource))) {
+              surface->viewport = nullptr;
+            }
+          });
+          surface->viewport = viewport;
+        },
+};
+
+// }
+
+template <typename Implementation> static void BindGlobal(wl_client *client, const wl_interface *interface, const Implementation *implementation, uint32_t version, uint32_t id, wl_list *list = nullptr) {
+  wl_resource *const resource = wl_resource_create(client, interface, version, id);
+
+  if (resource == nullptr) {
+    wl_client_post_no_memory(client);
+    return;
+  }
+
+  wl_resource_set_implementation(resource, implementation, nullptr, list ? UnlinkResource : nullptr);
+
+  if (list != nullptr) {
+    wl_list_insert(list->prev, wl_resource_get_link(resource));
+  }
+}
+
+static const struct wl_output_interface kOutputImplementation = {
+    .release = DestroyResource,
+};
+
+static bool CreateGlobals() {
+  wl_display *const display = compositor.display;
+
+  // Clients prefer xdg_wm_base, so the legacy shell is the only one when enabled.
+  const bool shell_created =
+      compositor.wl_shell
+          ? wl_global_create(display, &wl_shell_interface, 1, nullptr, [](wl_client *client, void *data, uint32_t version, uint32_t id) { BindGlobal(client, &wl_shell_interface, &kShellImplementation, version, id); })
+          : wl_global_create(display, &xdg_wm_base_interface, 1, nullptr, [](wl_client *client, void *data, uint32_t version, uint32_t id) { BindGlobal(client, &xdg_wm_base_interface, &kXdgWmBaseImplementation, version, id); });
+
+  const bool created =
+      shell_created &&
+      wl_global_create(display, &wl_compositor_interface, 4, nullptr, [](wl_client *client, void *data, uint32_t version, uint32_t id) { BindGlobal(client, &wl_compositor_interface, &kCompositorImplementation, version, id); }) &&
+      wl_global_create(display, &wp_viewporter_interface, 1, nullptr, [](wl_client *client, void *data, uint32_t version, uint32_t id) { BindGlobal(client, &wp_viewporter_interface, &kViewporterImplementation, version, id); }) &&
+      wl_global_create(display, &wp_presentation_interface, 1, nullptr,
+                       [](wl_client *client, void *data, uint32_t version, uint32_t id) {
+                         wl_resource *const presentation = wl_resource_create(client, &wp_presentation_interface, version, id);
+
+                         if (presentation == nullptr) {
+                           wl_client_post_no_memory(client);
+                           return;
+                         }
+
+                         wl_resource_set_implementation(presentation, &kPresentationImplementation, nullptr, nullptr);
+                         wp_presentation_send_clock_id(presentation, CLOCK_MONOTONIC);
+                       }) &&
+      wl_global_create(display, &wl_output_interface, 3, nullptr,
+                       [](wl_client *client, void *data, uint32_t version, uint32_t id) {
+                         BindGlobal(client, &wl_output_interface, &kOutputImplementation, version, id, &compositor.outputs);
+                         SendOutputMode(wl_resource_from_link(compositor.outputs.prev));
+                       }) &&
+      wl_global_create(display, &wl_seat_interface, 5, nullptr, [](wl_client *client, void *data, uint32_t version, uint32_t id) {
+        wl_resource *const seat = wl_resource_create(client, &wl_seat_interface, version, id);
+
+        if (seat == nullptr) {
+          wl_client_post_no_memory(client);
+          return;
+        }
+
+        wl_resource_set_implementation(seat, &kSeatImplementation, nullptr, nullptr);
+        wl_seat_send_capabilities(seat, WL_SEAT_CAPABILITY_POINTER | WL_SEAT_CAPABILITY_KEYBOARD | WL_SEAT_CAPABILITY_TOUCH);
+
+        if (version >= WL_SEAT_NAME_SINCE_VERSION) {
+          wl_seat_send_name(seat, "seat0");
+        }
+      });
+
+  return created && wl_display_init_shm(display) == 0;
+}
+
+static bool CreateKeymap() {
+  auto &xkb = compositor.xkb;
+
+  xkb.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+  xkb.keymap  = xkb.context ? xkb_keymap_new_from_names(xkb.context, nullptr, XKB_KEYMAP_COMPILE_NO_FLAGS) : nullptr;
+
+  if (xkb.keymap == nullptr) {
+    fprintf(stderr, TCTAG "could not compile the default keymap\n");
+    return false;
+  }
+
+  xkb.state = xkb_state_new(xkb.keymap);
+
+  char *const keymap = xkb_keymap_get_as_string(xkb.keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+  xkb.size           = strlen(keymap) + 1;
+  xkb.fd             = memfd_create("keymap", MFD_CLOEXEC);
+
+  const bool written = xkb.fd != -1 && write(xkb.fd, keymap, xkb.size) == static_cast<ssize_t>(xkb.size);
+  free(keymap);
+
+  if (!written) {
+    fprintf(stderr, TCTAG "could not store the keymap (errno: %d)\n", errno);
+    return false;
+  }
+
+  return true;
+}
+
+static int OnSignal(int signal_number, void *data) {
+  if (signal_number == SIGCHLD) {
+    int status;
+
+    if (compositor.client_pid == -1 || waitpid(compositor.client_pid, &status, WNOHANG) != compositor.client_pid) {
+      return 0;
+    }
+
+    compositor.client_pid    = -1;
+    compositor.client_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+    fprintf(stderr, TCTAG "client exited with status %d\n", compositor.client_status);
+  }
+
+  wl_display_terminate(compositor.display);
+
+  return 0;
+}
+
+static pid_t SpawnClient(char **argv, const char *socket) {
+  const pid_t pid = fork();
+
+  if (pid == 0) {
+    // The signals handled by the compositor are blocked (see wl_event_loop_add_signal()).
+    sigset_t all;
+    sigfillset(&all);
+    sigprocmask(SIG_UNBLOCK, &all, nullptr);
+
+    setenv("WAYLAND_DISPLAY", socket, 1);
+    execvp(argv[0], argv);
+
+    fprintf(stderr, TCTAG "could not execute %s (errno: %d)\n", argv[0], errno);
+    _exit(127);
+  }
+
+  return pid;
+}
+
+static void PrintStats() {
+  const auto &stats = compositor.stats;
+
+  fprintf(stderr,
+          TCTAG "vblanks: %ju idle: %ju commits: %ju presented: %ju discarded: %ju superseded: %ju "
+                "commit-to-present avg: %.0fus max: %.0fus input events: %ju failures: %ju blended px/frame: %.0f opaque px/frame: %.0f\n",
+          static_cast<uintmax_t>(stats.vblanks), static_cast<uintmax_t>(stats.idle_vblanks), static_cast<uintmax_t>(stats.commits), static_cast<uintmax_t>(stats.presented), static_cast<uintmax_t>(stats.discarded),
+          static_cast<uintmax_t>(stats.superseded), stats.presented ? stats.latency_ns / 1e3 / stats.presented : 0., stats.latency_max / 1e3, static_cast<uintmax_t>(stats.input_events), static_cast<uintmax_t>(stats.failures),
+          stats.presented ? static_cast<double>(stats.blended_px) / stats.presented : 0., stats.presented ? static_cast<double>(stats.opaque_px) / stats.presented : 0.);
+}
+
+int main(int argc, char **argv) {
+  const char *socket = nullptr;
+  const char *script = nullptr;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "+s:m:S:l")) != -1) {
+    switch (opt) {
+    case 's':
+      socket = optarg;
+      break;
+    case 'm':
+      if (sscanf(optarg, "%dx%d@%d", &compositor.mode.width, &compositor.mode.height, &compositor.mode.refresh_mhz) != 3 || compositor.mode.refresh_mhz < 1000) {
+        fprintf(stderr, TCTAG "invalid mode: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'S':
+      script = optarg;
+      break;
+    case 'l':
+      compositor.wl_shell = true;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-s <socket>] [-m <width>x<height>@<refresh mHz>] [-S <script>] [-l] [-- <client> [<args>...]]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (script != nullptr && !LoadScript(script)) {
+    return EXIT_FAILURE;
+  }
+
+  wl_list_init(&compositor.outputs);
+  wl_list_init(&compositor.keyboards);
+  wl_list_init(&compositor.pointers);
+  wl_list_init(&compositor.touches);
+
+  compositor.display = wl_display_create();
+  compositor.loop    = wl_display_get_event_loop(compositor.display);
+
+  if (!CreateKeymap() || !CreateGlobals()) {
+    return EXIT_FAILURE;
+  }
+
+  if (socket == nullptr) {
+    socket = wl_display_add_socket_auto(compositor.display);
+  } else if (wl_display_add_socket(compositor.display, socket) != 0) {
+    socket = nullptr;
+  }
+
+  if (socket == nullptr) {
+    fprintf(stderr, TCTAG "could not create the socket (errno: %d)\n", errno);
+    return EXIT_FAILURE;
+  }
+
+  compositor.vblank.fd      = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  compositor.vblank.next_ns = NowNs() + compositor.mode.period_ns();
+  wl_event_loop_add_fd(compositor.loop, compositor.vblank.fd, WL_EVENT_READABLE, OnVblank, nullptr);
+  ArmVblank();
+
+  compositor.script.timer = wl_event_loop_add_timer(compositor.loop, [](void *data) -> int { RunScript(); return 0; }, nullptr);
+
+  wl_event_loop_add_signal(compositor.loop, SIGINT, OnSignal, nullptr);
+  wl_event_loop_add_signal(compositor.loop, SIGTERM, OnSignal, nullptr);
+  wl_event_loop_add_signal(compositor.loop, SIGCHLD, OnSignal, nullptr);
+
+  fprintf(stderr, TCTAG "listening on %s, %dx%d@%.3fHz\n", socket, compositor.mode.width, compositor.mode.height, compositor.mode.refresh_mhz / 1e3);
+
+  if (optind < argc) {
+    compositor.client_pid = SpawnClient(&argv[optind], socket);
+
+    if (compositor.client_pid == -1) {
+      fprintf(stderr, TCTAG "could not start the client (errno: %d)\n", errno);
+      return EXIT_FAILURE;
+    }
+  }
+
+  wl_display_run(compositor.display);
+
+  if (compositor.client_pid != -1) {
+    int status;
+    kill(compositor.client_pid, SIGTERM);
+    waitpid(compositor.client_pid, &status, 0);
+  }
+
+  PrintStats();
+
+  wl_display_destroy_clients(compositor.display);
+  wl_display_destroy(compositor.display);
+
+  return compositor.stats.failures > 0 ? 1 : compositor.client_status;
+}